@@ -11,6 +11,12 @@
  */
 
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <unordered_set>
 
 #include <filter_plugin.h>
 #include <filter.h>
@@ -18,6 +24,24 @@
 
 #include <Python.h>
 
+#include <python35_interpreter.h>
+#include <python35_proxy.h>
+#include <python35_buffers.h>
+#include <python35_columnar.h>
+#include <python35_workers.h>
+#include <python35_parallel.h>
+#include <python35_writeback.h>
+#include <python35_keycache.h>
+#include <python35_context.h>
+#include <python35_stream.h>
+#include <python35_latency.h>
+#include <python35_profiler.h>
+#include <python35_gc.h>
+#include <python35_budget.h>
+#include <python35_assets.h>
+#include <python35_scriptcache.h>
+#include <python35_state.h>
+
 // Relative path to FLEDGE_DATA
 #define PYTHON_FILTERS_PATH "/scripts"
 
@@ -44,10 +68,59 @@ class Python35Filter : public FledgeFilter
 			m_encode_names = true;
 			m_logger = Logger::getLogger();
 			m_failedScript = false;
+			m_execCount = 0;
+			m_isolated = false;
+			m_lazyReadings = false;
+			m_bufferViews = false;
+			m_columnarBatches = false;
+			m_streaming = false;
+			m_accumulate = false;
+			m_accumulateCount = 0;
+			m_accumulateBytes = 0;
+			m_accumulateLatency = 0;
+			m_accumulated = NULL;
+			m_accumulatedBytes = 0;
+			m_flushTaken = 0;
+			m_flushServed = 0;
+			m_flushThread = NULL;
+			m_flushRunning = false;
+			m_async = false;
+			m_queueSize = 0;
+			m_rejectWhenFull = false;
+			m_worker = NULL;
+			m_workerBusy = false;
+			m_draining = false;
+			m_queuePeak = 0;
+			m_queueBlocked = 0;
+			m_queueRejected = 0;
+			m_trackerMissing = false;
+			m_trackedCalls = 0;
+			m_profileDuration = 0;
+			m_profileCalls = 0;
+			m_assets = std::make_shared<PythonAssetFilter>();
+			m_projection = std::make_shared<const std::vector<std::string> >();
+			m_state = std::make_shared<PythonFilterState>(&m_interpreter,
+								      (PyObject *)NULL,
+								      (PyObject *)NULL,
+								      m_encode_names,
+								      isEnabled(),
+								      false,
+								      false,
+								      false,
+								      false,
+								      std::shared_ptr<const PythonTransforms>(),
+								      m_assets,
+								      m_projection,
+								      false);
 		};
 
 		void	init();
 		void	ingest(READINGSET *);
+		void	processBatch(READINGSET *);
+		ReadingSet*
+			filterBatch(READINGSET *,
+				    const PythonFilterStatePtr& script,
+				    bool retry = true);
 		void	shutdown();
 		// Set the additional path for Python3.5 Fledge scripts
 		void	setFiltersPath(const std::string& dataDir)
@@ -63,12 +136,76 @@ class Python35Filter : public FledgeFilter
 		bool	reconfigure(const std::string& newConfig);
 		void	lock() { m_configMutex.lock(); };
 		void	unlock() { m_configMutex.unlock(); };
+		// The state of the script used by the readings, read without locking
+		PythonFilterStatePtr
+			getState() const { return std::atomic_load(&m_state); };
+		void	publishState();
+		void	createTypes();
 		void	logErrorMessage();
+		void	trackAssets(const std::vector<Reading *>& readings);
+		unsigned long
+			getTrackedCalls();
+		void	passOn(ReadingSet* readingSet);
+		void	configureLatency(ConfigCategory& config);
+		void	configureProfiler(ConfigCategory& config);
+		void	configureGC(ConfigCategory& config);
+		void	configureBudget(ConfigCategory& config);
+		ReadingSet*
+			filterInterrupted(std::vector<Reading *>& readings,
+					  const PythonFilterStatePtr& script,
+					  bool retry,
+					  bool changed);
+		void	logInterrupted(const char *outcome);
+		void	configureAssets(ConfigCategory& config);
+		void	configureTransforms(ConfigCategory& config);
+		ReadingSet*
+			filterSelected(READINGSET *readingSet,
+				       const PythonFilterStatePtr& script);
+		void	configureDatapoints(ConfigCategory& config);
+		std::vector<std::string>
+			getScriptNames(const char *attribute);
 		// Filtering methods for Reading objects
 		PyObject*
-			createReadingsList(const std::vector<Reading *>& readings);
+			createReadingsList(const std::vector<Reading *>& readings,
+					   const PythonFilterState& script,
+					   PythonContext& context);
 		std::vector<Reading *>*
-			getFilteredReadings(PyObject* filteredData);
+			getFilteredReadings(PyObject* filteredData,
+					    PythonContext& context);
+		void	releaseReadingsList(PyObject* readingsList,
+					    PythonContext& context);
+		bool	checkColumnar();
+		ReadingSet*
+			filterColumnar(ReadingSet* readingSet,
+				       const PythonFilterState& state,
+				       PythonContext& context);
+		ReadingSet*
+			filterStream(ReadingSet* readingSet,
+				     const PythonFilterState& state,
+				     PythonContext& context);
+		// Script run in worker processes
+		void	configureWorkers(ConfigCategory& config);
+		ReadingSet*
+			filterWorkers(ReadingSet* readingSet);
+		// Script run on chunks of a batch in parallel interpreters
+		void	configureParallel(ConfigCategory& config);
+		// Accumulation of readings across ingest calls
+		void	configureAccumulation(ConfigCategory& config);
+		bool	accumulate(ReadingSet* readingSet);
+		void	flushAccumulated();
+		void	stopAccumulation();
+		void	flushTimer();
+		// Asynchronous processing on a worker thread
+		void	configureAsync(ConfigCategory& config);
+		bool	enqueue(ReadingSet* readingSet);
+		void	asyncWorker();
+		void	waitAsyncIdle();
+		void	stopAsync();
+		void	reportQueue();
+		size_t	getQueueDepth();
+		size_t	getQueuePeak();
+		unsigned long
+			getQueueRejected();
 
 	private:
 		// Python 3.5 loaded filter module handle
@@ -77,18 +214,126 @@ class Python35Filter : public FledgeFilter
 		PyObject*	m_pFunc;
 		// Python 3.5  script name
 		std::string	m_pythonScript;
+		// Python 3.5 filter method name
+		std::string	m_filterMethod;
 		// Python interpreter has been started by this plugin
 		bool		m_init;
 
 		void		fixQuoting(std::string& str);
 		// Scripts path
 		std::string	m_filtersPath;
-		// Configuration lock
+		// Configuration lock, not taken by the processing of the readings
 		std::mutex	m_configMutex;
+		// Snapshot of the script state published by the configuration
+		PythonFilterStatePtr
+				m_state;
 		// Encode and decode attribute names for compatibility
 		bool		m_encode_names;
-		bool		m_failedScript;
-		int		m_execCount;
+		// Set by the configuration, the calls read the published state
+		std::atomic<bool>
+				m_failedScript;
+		std::atomic<int>
+				m_execCount;
 		Logger		*m_logger;
+		// Assets registered with the asset tracker
+		std::unordered_set<std::string>
+				m_trackedAssets;
+		std::mutex	m_trackedMutex;
+		// Calls of the asset tracker since the filter started
+		unsigned long	m_trackedCalls;
+		// The missing asset tracker has been reported
+		std::atomic<bool>
+				m_trackerMissing;
+		// Isolated interpreter requested by configuration
+		bool		m_isolated;
+		// Interpreter the script runs in
+		PythonInterpreter
+				m_interpreter;
+		// Pass lazy reading objects to the script, as configured,
+		// the calls of the script take it from their snapshot
+		bool		m_lazyReadings;
+		PythonReadingProxy
+				m_readingProxy;
+		// Pass arrays, data buffers and images as views of the datapoints, as configured,
+		// the calls of the script take it from their snapshot
+		bool		m_bufferViews;
+		// Names cache, input readings passed on by the script, buffer
+		// views and columns, one set per call of the script in progress
+		PythonContextPool
+				m_contexts;
+		// Compiled code of the script, keyed by its content
+		PythonScriptCache
+				m_scriptCache;
+		// The script is a generator function
+		bool		m_streaming;
+		PythonReadingStream
+				m_readingStream;
+		// Pass columnar batches to the script, as configured,
+		// the calls of the script take it from their snapshot
+		bool		m_columnarBatches;
+		// Worker processes running the script, if any
+		PythonWorkerPool
+				m_workers;
+		// Interpreters running a stateless script on chunks of a batch
+		PythonParallel	m_parallel;
+		// Assets whose readings are passed to the script
+		std::shared_ptr<PythonAssetFilter>
+				m_assets;
+		// Datapoints converted for the script, empty for all
+		std::shared_ptr<const std::vector<std::string> >
+				m_projection;
+		// Transforms applied without Python, NULL if none
+		std::shared_ptr<const PythonTransforms>
+				m_transforms;
+		// Time spent in each stage of processBatch()
+		PythonLatency	m_latency;
+		// Sampling profiler of the script and its last configuration
+		PythonProfiler	m_profiler;
+		unsigned long	m_profileDuration;
+		unsigned long	m_profileCalls;
+		// When the garbage collector of the interpreter runs
+		PythonGC	m_gc;
+		// Time limit of each call of the script
+		PythonBudget	m_budget;
+
+		void		flush(std::unique_lock<std::mutex>& guard);
+		// Accumulation limits, 0 for no limit
+		bool		m_accumulate;
+		size_t		m_accumulateCount;
+		size_t		m_accumulateBytes;
+		unsigned long	m_accumulateLatency;
+		// Readings held until a limit is reached
+		ReadingSet	*m_accumulated;
+		size_t		m_accumulatedBytes;
+		std::chrono::steady_clock::time_point
+				m_accumulatedSince;
+		std::mutex	m_accumulateMutex;
+		std::condition_variable
+				m_accumulateCV;
+		// Order of the flushes, the next flush taken and the one processed
+		uint64_t	m_flushTaken;
+		uint64_t	m_flushServed;
+		// Latency timer
+		std::thread	*m_flushThread;
+		bool		m_flushRunning;
+		// Readings waiting for the worker thread
+		bool		m_async;
+		size_t		m_queueSize;
+		bool		m_rejectWhenFull;
+		std::deque<ReadingSet *>
+				m_queue;
+		std::mutex	m_queueMutex;
+		std::condition_variable
+				m_queueCV;
+		std::condition_variable
+				m_queueSpaceCV;
+		std::thread	*m_worker;
+		bool		m_workerBusy;
+		// The worker is processing the queue before it stops
+		bool		m_draining;
+		// Queue metrics
+		size_t		m_queuePeak;
+		unsigned long	m_queueBlocked;
+		unsigned long	m_queueRejected;
 };
 #endif
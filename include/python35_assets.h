@@ -0,0 +1,63 @@
+#ifndef _PYTHON35_ASSETS_H
+#define _PYTHON35_ASSETS_H
+/*
+ * Fledge "Python 3.5" filter asset selection.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <reading.h>
+#include <reading_set.h>
+
+/**
+ * PythonAssetFilter class
+ *
+ * Selects the readings passed to the script by asset name, so that
+ * the readings of other assets are passed on without ever being
+ * converted to Python objects.
+ *
+ * Patterns are asset names that may contain the wildcards of
+ * fnmatch(3), e.g. "pump*". The result of the match of each asset
+ * name is cached, the number of cached names is bounded.
+ */
+class PythonAssetFilter
+{
+	public:
+		PythonAssetFilter() {};
+		~PythonAssetFilter() {};
+
+		void		setPatterns(const std::vector<std::string>& patterns);
+		bool		isEnabled();
+		ReadingSet	*split(ReadingSet *readingSet,
+				       std::vector<Reading *>& bypassed,
+				       std::vector<bool>& selected);
+		static ReadingSet
+				*merge(ReadingSet *results,
+				       std::vector<Reading *>& bypassed,
+				       const std::vector<bool>& selected);
+		static std::vector<std::string>
+				parse(const std::string& patterns);
+
+	private:
+		bool		matches(const std::string& asset);
+
+	private:
+		std::mutex	m_mutex;
+		// Asset names without wildcards
+		std::unordered_set<std::string>
+				m_names;
+		// Patterns with wildcards
+		std::vector<std::string>
+				m_patterns;
+		// Result of the match of each asset name
+		std::unordered_map<std::string, bool>
+				m_cache;
+};
+#endif
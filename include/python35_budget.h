@@ -0,0 +1,121 @@
+#ifndef _PYTHON35_BUDGET_H
+#define _PYTHON35_BUDGET_H
+/*
+ * Fledge "Python 3.5" filter execution time budget of the script.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <logger.h>
+
+#include <Python.h>
+
+#include <python35_interpreter.h>
+
+/**
+ * PythonBudget class
+ *
+ * Limits the time a call of the script may take to process a set of
+ * readings, so that a script that loops or blocks does not stall the
+ * service.
+ *
+ * Each call is registered with its deadline. A watchdog thread wakes
+ * up at the earliest deadline and raises a ScriptTimeout exception in
+ * the thread running the call, which Python handles at the next bytecode
+ * it executes. ScriptTimeout derives from BaseException, so that the
+ * "except Exception" clauses of the script do not catch it, and is
+ * raised again periodically until the call returns.
+ *
+ * A call blocked in C code, such as a socket read without a timeout,
+ * is only interrupted once that code returns to Python.
+ *
+ * The number of calls that exceeded the budget and the slowest call
+ * are measured and reported.
+ *
+ * begin() and end() must be called with the interpreter lock held,
+ * configure() and stop() without it.
+ */
+class PythonBudget
+{
+	public:
+		/**
+		 * What the filter does with the readings of an interrupted call
+		 */
+		enum Policy {
+			PASS_THROUGH,	// Pass on the readings unfiltered
+			DROP,		// Pass on no readings
+			RETRY		// Run the script on each half of the readings
+		};
+
+		typedef std::chrono::steady_clock::time_point
+				TimePoint;
+
+		PythonBudget();
+		~PythonBudget();
+
+		void		configure(PythonInterpreter *interpreter,
+					  unsigned long milliseconds,
+					  Policy policy);
+		void		stop();
+		bool		isEnabled() const { return m_budget.load(std::memory_order_relaxed) != 0; };
+		unsigned long	getBudget() const { return m_budget.load(std::memory_order_relaxed); };
+		Policy		getPolicy() const { return m_policy.load(std::memory_order_relaxed); };
+		uint64_t	begin();
+		bool		end(uint64_t call);
+		uint64_t	getTimeouts() const { return m_timeoutsTotal.load(); };
+		void		report(Logger *logger, const std::string& name);
+
+	private:
+		/**
+		 * A call of the script in progress
+		 */
+		typedef struct {
+			// Python identifier of the thread running the call
+			unsigned long	thread;
+			TimePoint	start;
+			// When the exception is next raised
+			TimePoint	due;
+			bool		interrupted;
+		} Call;
+
+		void		startWatchdog();
+		void		stopWatchdog();
+		void		watchdog();
+		bool		isDue(TimePoint now, TimePoint& next);
+
+	private:
+		std::atomic<unsigned long>
+				m_budget;
+		std::atomic<Policy>
+				m_policy;
+		PythonInterpreter
+				*m_interpreter;
+		// The ScriptTimeout exception type
+		PyObject	*m_exception;
+		std::map<uint64_t, Call>
+				m_calls;
+		uint64_t	m_nextCall;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
+		std::thread	*m_thread;
+		bool		m_running;
+		// Measurements since the last report
+		std::atomic<uint64_t>
+				m_timeouts;
+		std::atomic<uint64_t>
+				m_slowest;
+		std::atomic<uint64_t>
+				m_timeoutsTotal;
+};
+#endif
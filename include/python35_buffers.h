@@ -0,0 +1,72 @@
+#ifndef _PYTHON35_BUFFERS_H
+#define _PYTHON35_BUFFERS_H
+/*
+ * Fledge "Python 3.5" filter buffer views of datapoints.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <reading.h>
+
+#include <Python.h>
+
+/**
+ * PythonBuffers class
+ *
+ * Passes the float arrays, two dimensional float arrays, data buffers
+ * and images of readings to the script as writable memoryview objects
+ * that point to the storage of the C++ datapoints, rather than as
+ * lists with a Python object per element. A two dimensional array is
+ * a list of memoryviews, one per row.
+ *
+ * The views are only valid during the call of the script, release()
+ * must be called before the readings are deleted. A datapoint whose
+ * buffer the script still uses, e.g. through a NumPy array created
+ * from a view, is then replaced by a copy in its reading and kept
+ * until the script no longer uses it.
+ *
+ * Objects that support the buffer protocol, other than bytes which
+ * are strings, are converted back to datapoints with a copy of their
+ * content, whether or not they are views created by the filter.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonBuffers
+{
+	public:
+		PythonBuffers() : m_exporterType(NULL) {};
+		~PythonBuffers() {};
+
+		bool		init();
+		void		clear();
+		bool		isInitialised() const { return m_exporterType != NULL; };
+		// Views were passed to the script since the last release
+		bool		hasViews() const { return !m_views.empty(); };
+		static bool	isBuffer(const DatapointValue& value);
+		PyObject	*create(Reading *reading, Datapoint *datapoint);
+		void		release(std::vector<Datapoint *>& removed);
+		static bool	isView(PyObject *value, Datapoint *datapoint);
+		static Reading	*toReading(PyObject *dict);
+
+	private:
+		PyObject	*createView(Reading *reading,
+					    Datapoint *datapoint,
+					    Py_ssize_t row);
+		static bool	isBufferValue(PyObject *value);
+		static Datapoint
+				*toDatapoint(const std::string& name, PyObject *value);
+
+	private:
+		// The type of the objects that export the datapoint buffers
+		PyObject	*m_exporterType;
+		// Views and exporters created since the last release
+		std::vector<PyObject *>
+				m_views;
+		std::vector<PyObject *>
+				m_exporters;
+};
+#endif
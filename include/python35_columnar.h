@@ -0,0 +1,77 @@
+#ifndef _PYTHON35_COLUMNAR_H
+#define _PYTHON35_COLUMNAR_H
+/*
+ * Fledge "Python 3.5" filter columnar batches.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <reading.h>
+
+#include <Python.h>
+
+/**
+ * PythonColumnar class
+ *
+ * Converts the readings of one asset into a single columnar batch
+ * for the filter script:
+ *
+ *	{
+ *		'asset_code' : 'name',
+ *		'timestamp'  : numpy.ndarray (float64, seconds since the epoch),
+ *		'reading'    : { datapoint name : numpy.ndarray, ... }
+ *	}
+ *
+ * A column is created for each integer or floating point datapoint
+ * present in all the readings of the batch, as an int64 or float64
+ * array. Other datapoints are not passed to the script and are left
+ * unchanged in the readings.
+ *
+ * The batch returned by the script is written back into the same
+ * readings, each returned column must have one value per reading.
+ *
+ * NumPy is imported by init(), no NumPy headers are needed to build.
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonColumnar
+{
+	public:
+		PythonColumnar() : m_empty(NULL), m_asarray(NULL), m_ascontiguousarray(NULL) {};
+		~PythonColumnar() {};
+
+		static bool	isAvailable();
+		bool		init();
+		void		clear();
+		PyObject	*createBatch(const std::vector<Reading *>& readings, bool encodeNames);
+		void		applyBatch(PyObject *batch, const std::vector<Reading *>& readings);
+
+	private:
+		/**
+		 * A numeric datapoint present in all the readings of a batch
+		 */
+		typedef struct {
+			std::string			name;
+			bool				isFloat;
+			// Position in the first reading
+			size_t				index;
+			// The datapoint in each reading
+			std::vector<Datapoint *>	points;
+		} Column;
+
+		void		findColumns(const std::vector<Reading *>& readings);
+		PyObject	*createArray(size_t count, bool isFloat, Py_buffer *view);
+		PyObject	*toArray(PyObject *value, size_t count, bool& isFloat);
+
+	private:
+		// Columns of the current batch
+		std::vector<Column>	m_columns;
+		// numpy functions
+		PyObject		*m_empty;
+		PyObject		*m_asarray;
+		PyObject		*m_ascontiguousarray;
+};
+#endif
@@ -0,0 +1,90 @@
+#ifndef _PYTHON35_CONTEXT_H
+#define _PYTHON35_CONTEXT_H
+/*
+ * Fledge "Python 3.5" filter conversion contexts.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <python35_keycache.h>
+#include <python35_writeback.h>
+#include <python35_buffers.h>
+#include <python35_columnar.h>
+
+/**
+ * PythonContext class
+ *
+ * The objects that convert one batch of readings to Python and back:
+ * the names cache, the copies of the dicts passed to the script, the
+ * views of the buffers and the columns of a columnar batch.
+ *
+ * A context is used by one call of the script at a time, so that calls
+ * made at the same time by different pipeline threads share no mutable
+ * state. This matters when the script releases the interpreter lock,
+ * for example while it sleeps, and with free-threaded Python builds
+ * where the calls run in parallel.
+ */
+class PythonContext
+{
+	public:
+		PythonContext() : m_generation(0) {};
+		~PythonContext() {};
+
+		PythonKeyCache	&getKeyCache() { return m_keyCache; };
+		PythonWriteBack	&getWriteBack() { return m_writeBack; };
+		PythonBuffers	&getBuffers() { return m_buffers; };
+		PythonColumnar	&getColumnar() { return m_columnar; };
+
+	private:
+		friend class PythonContextPool;
+
+		PythonKeyCache	m_keyCache;
+		PythonWriteBack	m_writeBack;
+		PythonBuffers	m_buffers;
+		PythonColumnar	m_columnar;
+		// Generation of the pool the names cache belongs to
+		unsigned long	m_generation;
+		// The projection the names cache was created for
+		std::shared_ptr<const std::vector<std::string> >
+				m_projection;
+};
+
+/**
+ * PythonContextPool class
+ *
+ * The contexts of a filter, one per call of the script in progress.
+ * Contexts are kept once released, so that the names they have cached
+ * are reused by the following calls.
+ *
+ * A change of script starts a new generation, each context clears its
+ * names cache the next time it is acquired, as it does when it is
+ * acquired for another datapoint projection.
+ */
+class PythonContextPool
+{
+	public:
+		PythonContextPool() : m_generation(0) {};
+		~PythonContextPool();
+
+		PythonContext	*acquire(const std::shared_ptr<const std::vector<std::string> >& projection);
+		void		release(PythonContext *context);
+		void		invalidate();
+		size_t		size();
+		void		clear();
+
+	private:
+		// All the contexts and the contexts not in use
+		std::vector<PythonContext *>
+				m_contexts;
+		std::vector<PythonContext *>
+				m_idle;
+		unsigned long	m_generation;
+		std::mutex	m_mutex;
+};
+#endif
@@ -0,0 +1,106 @@
+#ifndef _PYTHON35_GC_H
+#define _PYTHON35_GC_H
+/*
+ * Fledge "Python 3.5" filter control of the Python garbage collector.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <logger.h>
+
+#include <Python.h>
+
+/**
+ * PythonGC class
+ *
+ * Controls when the cyclic garbage collector of the interpreter of the
+ * filter runs, so that collections do not interrupt the script while it
+ * processes a set of readings.
+ *
+ * Automatic collection is turned off while the script processes a set
+ * of readings and restored to its previous state afterwards, so that the
+ * other filters and plugins sharing the interpreter are not affected.
+ * The filters of an interpreter share the count of the sets of readings
+ * in progress, the last one to end restores the collection. The filter
+ * asks after each set of readings whether a collection is due, either
+ * because the counts of the generations have reached the thresholds
+ * Python would collect at or because the collection interval has
+ * elapsed. The collection is run once the readings have been passed on.
+ *
+ * The objects that exist once the script is configured, its module,
+ * functions and the state set by set_filter_config, may be frozen so that
+ * collections do not scan them. As freezing applies to all the objects of
+ * the interpreter, it is only done in an isolated interpreter.
+ *
+ * The time and the number of the collections of the interpreter are
+ * measured with a gc.callbacks function while reporting is enabled.
+ *
+ * All methods but isPending() and report() must be called with the
+ * interpreter lock held.
+ */
+class PythonGC
+{
+	public:
+		/**
+		 * When collections are run
+		 */
+		enum Mode {
+			AUTOMATIC,	// When Python decides
+			BETWEEN_BATCHES,// Between sets of readings, at the Python thresholds
+			SCHEDULED	// Between sets of readings, at a fixed interval
+		};
+
+		PythonGC();
+		~PythonGC() {};
+
+		bool		configure(Mode mode,
+					  unsigned long interval,
+					  bool freeze,
+					  bool monitor,
+					  bool isolated);
+		bool		beginBatch();
+		void		endBatch(bool suspended);
+		bool		isPending() const { return m_pending.load(std::memory_order_relaxed) >= 0; };
+		void		collect();
+		void		clear();
+		void		report(Logger *logger, const std::string& name);
+
+	private:
+		static PyObject	*callback(PyObject *self, PyObject *args);
+		void		event(PyObject *phase, PyObject *info);
+		bool		call(const char *method);
+		int		dueGeneration();
+
+	private:
+		PyObject	*m_gc;
+		PyObject	*m_callback;
+		Mode		m_mode;
+		std::chrono::steady_clock::duration
+				m_interval;
+		// Objects frozen by the filter
+		bool		m_frozen;
+		// Generation to collect once the readings are passed on, -1 for none
+		std::atomic<int>
+				m_pending;
+		std::atomic<int64_t>
+				m_lastCollection;
+		// Start of the collection in progress
+		std::chrono::steady_clock::time_point
+				m_started;
+		// Measurements since the last report
+		std::atomic<uint64_t>
+				m_collections[3];
+		std::atomic<uint64_t>
+				m_collected;
+		std::atomic<uint64_t>
+				m_pauseTotal;
+		std::atomic<uint64_t>
+				m_pauseMax;
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef _PYTHON35_INTERPRETER_H
+#define _PYTHON35_INTERPRETER_H
+/*
+ * Fledge "Python 3.5" filter interpreter handling.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+
+#include <Python.h>
+
+// Per-interpreter GIL (PEP 684) is available from Python 3.12
+#if PY_VERSION_HEX >= 0x030C0000
+#define PYTHON35_ISOLATED_INTERPRETER 1
+#endif
+
+// Python built without the GIL (PEP 703), from Python 3.13
+#ifdef Py_GIL_DISABLED
+#define PYTHON35_FREE_THREADED 1
+#endif
+
+/**
+ * PythonInterpreter class
+ *
+ * The interpreter a filter instance runs its Python script in.
+ *
+ * By default all the python35 filters in a service share the main
+ * interpreter and therefore the process wide GIL.
+ * With Python 3.12 or later a filter may instead own a sub-interpreter
+ * with its own GIL, so that filters in different pipelines no longer
+ * wait on each other.
+ *
+ * All calls into Python made by the filter must be wrapped
+ * by acquire() and release(), whichever the mode in use.
+ *
+ * A thread that calls into a sub-interpreter is given a thread state
+ * of that interpreter the first time and keeps it until the thread
+ * exits or the interpreter is destroyed, so that the threading.local
+ * values of the script are kept from one call to the next. release()
+ * still creates and deletes a placeholder thread state on each call:
+ * deleting the last thread state attached is the only way the Python
+ * API offers to stop the PyGILState functions of the thread from
+ * finding a thread state of the sub-interpreter, and a placeholder
+ * that was kept would be found instead.
+ *
+ * With a free-threaded Python build acquire() attaches the calling
+ * thread to the interpreter without taking a global lock, so that the
+ * calls made by different pipeline threads run in parallel.
+ */
+class PythonInterpreter
+{
+	public:
+		/**
+		 * State returned by acquire() that must be
+		 * passed back to release() on the same thread
+		 */
+		typedef struct {
+			// Shared interpreter GIL state
+			PyGILState_STATE	gilState;
+			// Thread state of the calling thread detached
+			// while a sub-interpreter is in use
+			PyThreadState		*savedState;
+		} LockState;
+
+		PythonInterpreter() : m_threadState(NULL), m_id(0) {};
+		~PythonInterpreter() {};
+
+		bool		create();
+		void		destroy();
+		LockState	acquire();
+		void		release(LockState& state);
+		// True if the filter runs in its own sub-interpreter
+		bool		isIsolated() const { return m_threadState != NULL; };
+		static bool	isolationSupported();
+		static bool	isFreeThreaded();
+
+	private:
+		// Initial thread state of the owned sub-interpreter,
+		// NULL when the shared interpreter is in use
+		PyThreadState	*m_threadState;
+		// Identifier of the sub-interpreter in the thread states of the threads
+		uint64_t	m_id;
+};
+#endif
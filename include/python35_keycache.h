@@ -0,0 +1,87 @@
+#ifndef _PYTHON35_KEYCACHE_H
+#define _PYTHON35_KEYCACHE_H
+/*
+ * Fledge "Python 3.5" filter key object cache.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <reading.h>
+#include <python35_buffers.h>
+
+#include <Python.h>
+
+/**
+ * PythonKeyCache class
+ *
+ * Converts readings to the dicts passed to the filter script, as
+ * PythonReading::toPython(true, encodeNames) does, but builds the dict
+ * directly and reuses the Python objects of the dict keys, datapoint
+ * names and asset names from one call of the filter to the next.
+ *
+ * The cached objects are immutable and hashed when they are created,
+ * str objects are interned. The number of cached names is bounded,
+ * names beyond the limit are created for each reading.
+ *
+ * A projection may restrict the datapoints converted to the names the
+ * script uses, the other datapoints stay in the C++ reading. Arrays,
+ * data buffers and images may be passed as views of the datapoints.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonKeyCache
+{
+	public:
+		PythonKeyCache() : m_encodeNames(true),
+				   m_readingKey(NULL),
+				   m_assetKey(NULL),
+				   m_idKey(NULL),
+				   m_timestampKey(NULL),
+				   m_userTimestampKey(NULL) {};
+		~PythonKeyCache() {};
+
+		void		setEncodeNames(bool encodeNames);
+		void		clear();
+		PyObject	*toPython(Reading *reading,
+					  bool projected = false,
+					  PythonBuffers *buffers = NULL);
+		void		setProjection(const std::vector<std::string>& names);
+		bool		isProjected() const { return !m_projection.empty(); };
+		std::vector<std::string>
+				getProjection() const
+				{
+					return std::vector<std::string>(m_projection.begin(), m_projection.end());
+				};
+		void		copyHidden(Reading *from, Reading *to) const;
+
+	private:
+		bool		createKeys();
+		PyObject	*find(std::unordered_map<std::string, PyObject *>& cache,
+				      const std::string& name,
+				      bool bytes);
+
+	private:
+		bool		m_encodeNames;
+		// Keys of the reading dict
+		PyObject	*m_readingKey;
+		PyObject	*m_assetKey;
+		PyObject	*m_idKey;
+		PyObject	*m_timestampKey;
+		PyObject	*m_userTimestampKey;
+		// Datapoint names, bytes or str objects
+		std::unordered_map<std::string, PyObject *>
+				m_names;
+		// Asset names, str objects
+		std::unordered_map<std::string, PyObject *>
+				m_assets;
+		// Names of the datapoints converted, empty for all
+		std::unordered_set<std::string>
+				m_projection;
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef _PYTHON35_LATENCY_H
+#define _PYTHON35_LATENCY_H
+/*
+ * Fledge "Python 3.5" filter latency histograms.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <logger.h>
+
+// Exact values below 2^LATENCY_SUB_BITS ns, then 2^LATENCY_SUB_BITS buckets per power of 2
+#define LATENCY_SUB_BITS	4
+#define LATENCY_SUB_BUCKETS	(1 << LATENCY_SUB_BITS)
+// Values up to 2^LATENCY_MAX_BITS ns, about 18 minutes
+#define LATENCY_MAX_BITS	40
+#define LATENCY_BUCKETS		((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/**
+ * PythonLatency class
+ *
+ * Histograms of the time spent in each stage of the processing of a
+ * set of readings. The buckets have a constant relative width, as in
+ * HDR histograms, so that percentiles are within about 6% of the
+ * recorded values whatever their magnitude. The maximum is exact.
+ *
+ * Recording is lock free and may be done from any thread. The
+ * percentiles of each stage are logged, and the histograms reset,
+ * once per reporting interval.
+ */
+class PythonLatency
+{
+	public:
+		/**
+		 * The stages of the processing of a set of readings
+		 */
+		enum Stage {
+			TRANSFORMS,	// The transforms applied without Python
+			GIL,		// Waiting for the interpreter lock
+			CONVERSION,	// Creating the objects passed to the script
+			SCRIPT,		// The call of the script
+			RESULTS,	// Converting the objects returned by the script
+			ASSET_TRACKING,	// Registering the assets
+			DOWNSTREAM,	// The next filter in the pipeline
+			STAGES
+		};
+
+		typedef std::chrono::steady_clock::time_point
+				TimePoint;
+
+		PythonLatency();
+		~PythonLatency() {};
+
+		void		setInterval(unsigned long seconds);
+		bool		isEnabled() const { return m_interval.load(std::memory_order_relaxed) != 0; };
+		/**
+		 * Return the start time of a stage, the epoch if disabled
+		 */
+		TimePoint	start() const
+				{
+					return isEnabled() ? std::chrono::steady_clock::now() : TimePoint();
+				};
+		void		record(Stage stage, const TimePoint& start);
+		bool		report(Logger *logger, const std::string& name, bool force = false);
+		static std::string
+				format(uint64_t value);
+		static size_t	bucket(uint64_t value);
+		static uint64_t	bucketValue(size_t index);
+		static uint64_t	percentile(const uint64_t *counts, uint64_t total, double fraction);
+
+	private:
+		std::atomic<unsigned long>
+				m_interval;
+		std::atomic<uint64_t>
+				m_counts[STAGES][LATENCY_BUCKETS];
+		std::atomic<uint64_t>
+				m_max[STAGES];
+		std::mutex	m_reportMutex;
+		TimePoint	m_lastReport;
+};
+#endif
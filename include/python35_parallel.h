@@ -0,0 +1,118 @@
+#ifndef _PYTHON35_PARALLEL_H
+#define _PYTHON35_PARALLEL_H
+/*
+ * Fledge "Python 3.5" filter parallel interpreters.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <reading.h>
+#include <reading_set.h>
+#include <logger.h>
+#include <python35_interpreter.h>
+#include <python35_keycache.h>
+#include <python35_writeback.h>
+#include <python35_scriptcache.h>
+
+#include <Python.h>
+
+/**
+ * PythonParallel class
+ *
+ * A set of sub-interpreters, each with its own GIL, that run the
+ * filter script on chunks of a large batch of readings at the same
+ * time. Each interpreter, or lane, loads its own copy of the script
+ * module and is passed the filter configuration.
+ *
+ * Each lane has a thread of its own, started with the lane, that runs
+ * the script in its interpreter. A batch is split in one contiguous
+ * chunk per idle lane, the chunks are handed to the threads of the
+ * lanes and the results are appended in chunk order so that the order
+ * of the readings is preserved. Concurrent batches use different lanes,
+ * a batch that finds no idle lane is not split.
+ *
+ * This is only correct for scripts that keep no state from one reading
+ * to the next, the filter enables the lanes for scripts that declare it.
+ * Requires Python 3.12 or later, and that the extension modules the
+ * script imports support sub-interpreters.
+ */
+class PythonParallel
+{
+	public:
+		PythonParallel();
+		~PythonParallel();
+
+		bool		start(const std::string& name,
+				      int count,
+				      size_t minReadings,
+				      const std::string& scriptPath,
+				      const std::string& module,
+				      const std::string& method,
+				      const std::string& config,
+				      bool encodeNames,
+				      const std::vector<std::string>& projection);
+		void		stop();
+		bool		isRunning();
+		ReadingSet	*process(ReadingSet *readingSet);
+
+	private:
+		/**
+		 * A sub-interpreter and the script loaded in it
+		 */
+		typedef struct {
+			PythonInterpreter	interpreter;
+			PyObject		*module;
+			PyObject		*func;
+			PythonScriptCache	scriptCache;
+			PythonKeyCache		keyCache;
+			// Runs the script on the chunks of the lane
+			std::thread		*thread;
+			// Used by a batch
+			bool			busy;
+			// The chunk to process, NULL once it is processed
+			ReadingSet		*chunk;
+			// The readings returned by the script, NULL on failure
+			std::vector<Reading *>	*result;
+			// The thread is to exit
+			bool			exit;
+		} Lane;
+
+		bool		startLane(Lane *lane);
+		void		stopLane(Lane *lane);
+		void		runLane(Lane *lane);
+		std::vector<Reading *>
+				*run(Lane *lane, ReadingSet *chunk);
+		std::vector<Reading *>
+				*getReadings(Lane *lane,
+					     PythonWriteBack& writeBack,
+					     PyObject *result);
+		void		logError();
+
+	private:
+		std::vector<Lane *>	m_lanes;
+		std::string		m_name;
+		// Batches with fewer readings are not split
+		size_t			m_minReadings;
+		std::string		m_scriptPath;
+		std::string		m_module;
+		std::string		m_method;
+		std::string		m_config;
+		bool			m_encodeNames;
+		std::vector<std::string>
+					m_projection;
+		// Protects the states of the lanes, not held while they run the script
+		std::mutex		m_mutex;
+		// Signals the chunks given to the lanes and the chunks they have processed
+		std::condition_variable	m_cv;
+		// New batches may be split between the lanes
+		bool			m_running;
+		Logger			*m_logger;
+};
+#endif
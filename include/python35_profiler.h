@@ -0,0 +1,107 @@
+#ifndef _PYTHON35_PROFILER_H
+#define _PYTHON35_PROFILER_H
+/*
+ * Fledge "Python 3.5" filter script profiler.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <logger.h>
+#include <python35_interpreter.h>
+
+#include <Python.h>
+
+/**
+ * PythonProfiler class
+ *
+ * A sampling profiler of the filter script, run for a bounded window.
+ *
+ * A thread of the profiler takes the interpreter lock at a fixed
+ * interval and, if the script is running, records the Python stack
+ * of each thread that runs it. The script is therefore interrupted
+ * at most once per interval whatever the number of calls it makes.
+ *
+ * At the end of the window the functions and lines with the most
+ * samples are written to a report file and the profiler stops.
+ */
+class PythonProfiler
+{
+	public:
+		PythonProfiler();
+		~PythonProfiler();
+
+		bool		start(PythonInterpreter *interpreter,
+				      const std::string& name,
+				      const std::string& reportPath,
+				      unsigned long duration,
+				      unsigned long calls);
+		void		stop();
+		void		enter();
+		void		leave();
+
+	private:
+		/**
+		 * Samples of a function or line
+		 */
+		typedef struct {
+			unsigned long	cumulative;
+			unsigned long	self;
+		} Count;
+
+		typedef std::unordered_map<std::string, Count>
+				Counts;
+
+		void		called();
+		void		sampler();
+		void		sample();
+		void		sample(PyThreadState *target);
+		void		writeReport();
+		static void	writeTop(FILE *fp, const char *title,
+					 const Counts& counts,
+					 unsigned long samples);
+
+	private:
+		PythonInterpreter
+				*m_interpreter;
+		std::string	m_name;
+		std::string	m_reportPath;
+		std::thread	*m_thread;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
+		// Profiling window in progress
+		std::atomic<bool>
+				m_active;
+		// End the window early
+		bool		m_stop;
+		bool		m_done;
+		unsigned long	m_maxCalls;
+		std::chrono::steady_clock::time_point
+				m_start;
+		std::chrono::steady_clock::time_point
+				m_end;
+		// Thread states of the calls of the script in progress,
+		// only used with the interpreter lock held
+		std::unordered_multiset<PyThreadState *>
+				m_targets;
+		std::atomic<unsigned long>
+				m_calls;
+		// Samples taken while the script was running
+		unsigned long	m_samples;
+		// Samples with no Python frame, e.g. in the conversion of the readings
+		unsigned long	m_native;
+		Counts		m_functions;
+		Counts		m_lines;
+		Logger		*m_logger;
+};
+#endif
@@ -0,0 +1,58 @@
+#ifndef _PYTHON35_PROXY_H
+#define _PYTHON35_PROXY_H
+/*
+ * Fledge "Python 3.5" filter lazy reading objects.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <vector>
+#include <reading.h>
+#include <python35_buffers.h>
+
+#include <Python.h>
+
+/**
+ * PythonReadingProxy class
+ *
+ * Native Python types that give the filter script access to
+ * Fledge readings without converting them to dicts up front.
+ *
+ * A reading proxy supports the same mapping access as the dict
+ * built by PythonReading::toPython(), e.g. elem['asset_code'] and
+ * elem['reading'][key], however a datapoint is only converted to a
+ * Python object the first time the script accesses it.
+ *
+ * Proxies point to the C++ readings of the batch being filtered,
+ * detach() must be called for each of them before those readings
+ * are deleted.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonReadingProxy
+{
+	public:
+		PythonReadingProxy() : m_readingType(NULL), m_datapointsType(NULL) {};
+		~PythonReadingProxy() {};
+
+		bool		init();
+		void		clear();
+		PyObject	*create(Reading *reading,
+					bool encodeNames,
+					PythonBuffers *buffers = NULL);
+		bool		isInitialised() const { return m_readingType != NULL; };
+		bool		isProxy(PyObject *object) const;
+		Reading		*toReading(PyObject *proxy,
+					   std::vector<Datapoint *> *removed = NULL);
+		static Reading	*getReading(PyObject *proxy);
+		static bool	detach(PyObject *proxy, bool shared, Py_ssize_t callerRefs);
+
+	private:
+		// The reading type: 'asset_code', 'reading' ...
+		PyObject	*m_readingType;
+		// The type of the 'reading' item: datapoint name and value
+		PyObject	*m_datapointsType;
+};
+#endif
@@ -0,0 +1,76 @@
+#ifndef _PYTHON35_SCRIPTCACHE_H
+#define _PYTHON35_SCRIPTCACHE_H
+/*
+ * Fledge "Python 3.5" filter script compilation cache.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+#include <string>
+#include <logger.h>
+
+#include <Python.h>
+
+/**
+ * PythonScriptCache class
+ *
+ * Loads the filter script as a module, keyed by a hash of the content
+ * of the script rather than by its modification time, which changes
+ * each time the script file is written with the configuration.
+ *
+ * The code object of the script is kept in memory and persisted in
+ * the __pycache__ directory of the scripts path, so that the script is
+ * compiled only once for a given content, across restarts. A module
+ * loaded from the same content is not executed again, its state is
+ * kept. A changed content is executed in a new module object, so that
+ * the calls of the script still running with the previous module do
+ * not see its globals replaced.
+ *
+ * If the script file can not be read the module is imported by Python.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonScriptCache
+{
+	public:
+		PythonScriptCache();
+		~PythonScriptCache() {};
+
+		PyObject	*load(const std::string& directory,
+				      const std::string& name,
+				      PyObject *module);
+		bool		isUnchanged(const std::string& directory,
+					    const std::string& name);
+		void		clear();
+
+	private:
+		PyObject	*compile(const std::string& directory,
+					 const std::string& name,
+					 const std::string& source,
+					 uint64_t hash);
+		static PyObject	*detachModule(const std::string& name);
+		static void	restoreModule(const std::string& name,
+					      PyObject *previous,
+					      PyObject *loaded);
+		static bool	readFile(const std::string& path, std::string& content);
+		static uint64_t	contentHash(const std::string& content);
+		static std::string
+				cacheName(const std::string& name, uint64_t hash);
+		void		writeCache(const std::string& directory,
+					   const std::string& name,
+					   uint64_t hash,
+					   PyObject *code);
+
+	private:
+		// Code object of the last compiled content
+		PyObject	*m_code;
+		uint64_t	m_codeHash;
+		// Script and content of the last executed module
+		std::string	m_loadedName;
+		uint64_t	m_loadedHash;
+		Logger		*m_logger;
+};
+#endif
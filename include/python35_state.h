@@ -0,0 +1,104 @@
+#ifndef _PYTHON35_STATE_H
+#define _PYTHON35_STATE_H
+/*
+ * Fledge "Python 3.5" filter script state.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <python35_interpreter.h>
+#include <python35_transforms.h>
+#include <python35_assets.h>
+
+#include <Python.h>
+
+/**
+ * PythonFilterState class
+ *
+ * An immutable snapshot of the state the processing of the readings
+ * depends on: the module and function of the script, whether it failed
+ * to load, whether the datapoint names are encoded, whether the filter
+ * is enabled, the form in which the readings are passed to the script,
+ * the transforms applied without Python, and the assets and datapoints
+ * selected for the script.
+ *
+ * The filter publishes a new snapshot once a configuration has been
+ * applied, the readings being processed keep the snapshot they started
+ * with. Snapshots are shared and released by reference counting, so
+ * that the readings never wait for a reconfiguration to read them.
+ *
+ * A snapshot is created with the interpreter lock held and may be
+ * released on any thread, the references to the Python objects are
+ * released with the lock of the interpreter they belong to.
+ */
+class PythonFilterState
+{
+	public:
+		PythonFilterState(PythonInterpreter *interpreter,
+				  PyObject *module,
+				  PyObject *function,
+				  bool encodeNames,
+				  bool enabled,
+				  bool streaming,
+				  bool lazyReadings,
+				  bool bufferViews,
+				  bool columnar,
+				  const std::shared_ptr<const PythonTransforms>& transforms,
+				  const std::shared_ptr<PythonAssetFilter>& assets,
+				  const std::shared_ptr<const std::vector<std::string> >& projection,
+				  bool failed);
+		~PythonFilterState();
+
+		PyObject	*getModule() const { return m_module; };
+		PyObject	*getFunction() const { return m_function; };
+		bool		encodeNames() const { return m_encodeNames; };
+		bool		isEnabled() const { return m_enabled; };
+		// The function of the script is a generator
+		bool		isStreaming() const { return m_streaming; };
+		// The readings are passed as lazy reading objects
+		bool		lazyReadings() const { return m_lazyReadings; };
+		// Arrays, data buffers and images are passed as views
+		bool		bufferViews() const { return m_bufferViews; };
+		// The readings are passed as columnar batches
+		bool		isColumnar() const { return m_columnar; };
+		// The transforms, NULL if there are none
+		const PythonTransforms
+				*getTransforms() const { return m_transforms.get(); };
+		// The assets whose readings are passed to the script, the
+		// filter keeps the results of its matches
+		PythonAssetFilter
+				*getAssets() const { return m_assets.get(); };
+		// The names of the datapoints converted, empty for all
+		const std::shared_ptr<const std::vector<std::string> >&
+				getProjection() const { return m_projection; };
+		// The script failed to load or to configure
+		bool		isFailed() const { return m_failed; };
+
+	private:
+		PythonInterpreter
+				*m_interpreter;
+		PyObject	*m_module;
+		PyObject	*m_function;
+		const bool	m_encodeNames;
+		const bool	m_enabled;
+		const bool	m_streaming;
+		const bool	m_lazyReadings;
+		const bool	m_bufferViews;
+		const bool	m_columnar;
+		const std::shared_ptr<const PythonTransforms>
+				m_transforms;
+		const std::shared_ptr<PythonAssetFilter>
+				m_assets;
+		const std::shared_ptr<const std::vector<std::string> >
+				m_projection;
+		const bool	m_failed;
+};
+
+typedef std::shared_ptr<const PythonFilterState>
+		PythonFilterStatePtr;
+#endif
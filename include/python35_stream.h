@@ -0,0 +1,42 @@
+#ifndef _PYTHON35_STREAM_H
+#define _PYTHON35_STREAM_H
+/*
+ * Fledge "Python 3.5" filter reading streams.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <vector>
+#include <reading.h>
+#include <python35_keycache.h>
+
+#include <Python.h>
+
+/**
+ * PythonReadingStream class
+ *
+ * An iterator over the readings of a batch for scripts written as
+ * generators. Each reading is converted to a dict when the script
+ * asks for it and the C++ reading is deleted at once, so that only
+ * the readings the script is working on exist in both forms.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonReadingStream
+{
+	public:
+		PythonReadingStream() : m_type(NULL) {};
+		~PythonReadingStream() {};
+
+		bool		init();
+		void		clear();
+		PyObject	*create(const std::vector<Reading *>& readings, PythonKeyCache *keyCache);
+		static size_t	detach(PyObject *stream);
+		static bool	isGenerator(PyObject *function);
+
+	private:
+		PyObject	*m_type;
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef _PYTHON35_TRANSFORMS_H
+#define _PYTHON35_TRANSFORMS_H
+/*
+ * Fledge "Python 3.5" filter native transforms.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <vector>
+#include <reading.h>
+#include <reading_set.h>
+#include <logger.h>
+
+/**
+ * PythonTransforms class
+ *
+ * A list of simple transforms of numeric datapoints, declared in the
+ * "transforms" member of the configuration of the script, that are
+ * applied by the filter without calling Python: scale, offset, clamp
+ * and rename. Each transform applies to the datapoints of the assets
+ * whose names match its patterns, wildcards are allowed.
+ *
+ * The readings of the assets a transform names in its "asset" member
+ * are processed by the transforms only and never enter Python. The
+ * transforms without an asset apply to all the readings, the readings
+ * that are not named by any transform are then passed to the script.
+ *
+ * Integer datapoints stay integers if the transform only uses integers.
+ * Arrays of floating point values are processed by loops the compiler
+ * turns into vector instructions.
+ *
+ * The transforms are compiled once per configuration and are not
+ * changed afterwards, they may be used by several threads at once.
+ */
+class PythonTransforms
+{
+	public:
+		~PythonTransforms() {};
+
+		static PythonTransforms
+				*create(const std::string& name,
+					const std::string& configuration);
+		size_t		size() const { return m_transforms.size(); };
+		ReadingSet	*split(ReadingSet *readingSet,
+				       std::vector<Reading *>& native,
+				       std::vector<bool>& toScript) const;
+		void		apply(const std::vector<Reading *>& readings) const;
+
+	private:
+		/**
+		 * A transform, the operations are applied in the order
+		 * scale, offset, minimum, maximum and rename
+		 */
+		typedef struct {
+			std::string	asset;
+			// The asset was given rather than defaulting to all
+			bool		namedAsset;
+			std::string	datapoint;
+			bool		hasScale;
+			double		scale;
+			bool		hasOffset;
+			double		offset;
+			bool		hasMin;
+			double		min;
+			bool		hasMax;
+			double		max;
+			std::string	rename;
+			// All the numbers are integers
+			bool		integral;
+		} Transform;
+
+		PythonTransforms() : m_namedAssets(false) {};
+		bool		matchesAsset(const std::string& asset) const;
+		static bool	matches(const std::string& pattern, const std::string& name);
+		static void	applyValue(const Transform& transform, DatapointValue& value);
+		static void	applyArray(const Transform& transform, std::vector<double>& values);
+
+	private:
+		std::vector<Transform>
+				m_transforms;
+		// A transform names the assets it applies to
+		bool		m_namedAssets;
+};
+#endif
@@ -0,0 +1,44 @@
+#ifndef _PYTHON35_VALUES_H
+#define _PYTHON35_VALUES_H
+/*
+ * Fledge "Python 3.5" filter conversion of datapoint values.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <reading.h>
+
+#include <Python.h>
+
+/**
+ * PythonValues class
+ *
+ * Converts the value of a single datapoint to the object that
+ * PythonReading::toPython() creates for it, without building the dict
+ * of a whole reading.
+ *
+ * Numbers, strings, arrays of numbers and the dicts and lists made of
+ * them are converted directly. Images, data buffers and two dimensional
+ * arrays, whose objects depend on the NumPy support of PythonReading,
+ * are converted by PythonReading from a reading holding the datapoint.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonValues
+{
+	public:
+		static PyObject	*toPython(const std::string& asset,
+					  Datapoint *dp,
+					  bool encodeStrings);
+
+	private:
+		static bool	isDirect(DatapointValue& value);
+		static PyObject	*convert(DatapointValue& value, bool encodeStrings);
+		static PyObject	*convertReading(const std::string& asset,
+						Datapoint *dp,
+						bool encodeStrings);
+};
+#endif
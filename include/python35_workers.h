@@ -0,0 +1,152 @@
+#ifndef _PYTHON35_WORKERS_H
+#define _PYTHON35_WORKERS_H
+/*
+ * Fledge "Python 3.5" filter worker processes.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <reading.h>
+#include <logger.h>
+
+/**
+ * PythonWorkerPool class
+ *
+ * A set of Python processes that run the filter script outside
+ * of the service, so that a CPU bound script can use more than
+ * one core and a crash in a native extension does not take the
+ * service down.
+ *
+ * Each worker has a shared memory segment holding two ring buffers,
+ * one for requests and one for responses. Messages are written in the
+ * binary format of the Python marshal module, which the workers decode
+ * and encode in C, and are prefixed by their length. A byte written to
+ * a socket after each message wakes the other side.
+ *
+ * Images and data buffers are not sent to the workers, they are
+ * copied back to the readings the script returns for the readings it
+ * was passed. The identifiers of the readings are kept.
+ *
+ * A batch of readings is split in one contiguous chunk per idle worker,
+ * the results are appended in chunk order so that the order of the
+ * readings is preserved. Concurrent batches use different workers.
+ * Workers that exit, or that do not respond within the timeout and
+ * are killed, are started again by a supervisor thread, if a worker
+ * can not be started again the others are used. Only the chunks of
+ * a worker that fails are dropped, the results of the other chunks
+ * are kept.
+ */
+class PythonWorkerPool
+{
+	public:
+		/**
+		 * The outcome of process()
+		 */
+		enum Status {
+			PROCESSED,	// The results of the chunks that did not fail
+			FAILED,		// The readings can not be sent to the workers
+			UNAVAILABLE	// No worker is running
+		};
+
+		PythonWorkerPool();
+		~PythonWorkerPool();
+
+		bool		start(const std::string& name,
+				      const std::string& python,
+				      int count,
+				      size_t bufferSize,
+				      unsigned long timeout,
+				      const std::string& scriptPath,
+				      const std::string& module,
+				      const std::string& method,
+				      const std::string& config,
+				      bool encodeNames);
+		void		stop();
+		bool		isRunning();
+		Status		process(const std::vector<Reading *>& readings,
+					std::vector<Reading *>& results);
+
+	private:
+		/**
+		 * Ring buffer header, followed by the data
+		 */
+		typedef struct {
+			// Bytes written and read since the start
+			volatile uint64_t	head;
+			volatile uint64_t	tail;
+			uint8_t			pad[48];
+		} RingHeader;
+
+		/**
+		 * What a worker is doing
+		 */
+		enum State {
+			IDLE,		// Waiting for a batch
+			BUSY,		// Used by a batch
+			RESTART,	// Failed, to be started again
+			DEAD		// Failed to start again
+		};
+
+		typedef struct {
+			State		state;
+			pid_t		pid;
+			std::string	shmName;
+			uint8_t		*shm;
+			// Doorbell socket, a byte is sent after each message
+			int		bell;
+			// Number of times the worker has been started
+			unsigned int	starts;
+		} Worker;
+
+		std::vector<size_t>
+				claim(size_t readings);
+		void		release(const std::vector<size_t>& workers,
+					const std::vector<bool>& failed);
+		void		supervise();
+		bool		spawn(Worker& worker);
+		void		terminate(Worker& worker);
+		bool		send(Worker& worker, const std::string& message);
+		bool		receive(Worker& worker,
+					std::string& message,
+					unsigned long timeout);
+		bool		configureWorker(Worker& worker);
+		RingHeader	*requestRing(Worker& worker) { return (RingHeader *)worker.shm; };
+		RingHeader	*responseRing(Worker& worker)
+				{
+					return (RingHeader *)(worker.shm + sizeof(RingHeader) + m_capacity);
+				};
+		void		ringWrite(RingHeader *ring, uint64_t pos, const void *data, size_t len);
+		void		ringRead(RingHeader *ring, uint64_t pos, void *data, size_t len);
+
+	private:
+		std::vector<Worker>	m_workers;
+		std::string		m_name;
+		// Python executable of the workers
+		std::string		m_python;
+		// Capacity of each ring buffer in bytes
+		size_t			m_capacity;
+		// Time in milliseconds a worker may take to respond, 0 for no limit
+		unsigned long		m_timeout;
+		std::string		m_scriptPath;
+		std::string		m_module;
+		std::string		m_method;
+		std::string		m_config;
+		bool			m_encodeNames;
+		// Protects the states of the workers
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		bool			m_running;
+		// Starts the failed workers again
+		std::thread		*m_supervisor;
+		Logger			*m_logger;
+};
+#endif
@@ -0,0 +1,85 @@
+#ifndef _PYTHON35_WRITEBACK_H
+#define _PYTHON35_WRITEBACK_H
+/*
+ * Fledge "Python 3.5" filter copy-on-write of readings.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <reading.h>
+#include <reading_set.h>
+
+#include <Python.h>
+
+/**
+ * PythonWriteBack class
+ *
+ * Lets the filter pass on the input readings of a batch rather than
+ * new readings when the script returns the objects it was given.
+ *
+ * For each dict passed to the script a shallow copy of its items is
+ * kept. When the script returns that dict the original reading is
+ * updated in place: only the datapoints whose value is no longer the
+ * same Python object, or is a mutable object, are converted back,
+ * the identifier and timestamps of the reading are unchanged.
+ *
+ * Each input reading is reused at most once, if the script returns
+ * the same object twice the other occurrences are new readings.
+ *
+ * All methods must be called with the interpreter lock held.
+ */
+class PythonWriteBack
+{
+	public:
+		PythonWriteBack() {};
+		~PythonWriteBack() {};
+
+		void		track(Reading *reading, PyObject *dict);
+		Reading		*reuse(PyObject *dict);
+		Reading		*getReading(PyObject *dict) const;
+		bool		isReused(Reading *reading) const
+				{
+					return m_reused.count(reading) != 0;
+				};
+		void		setReused(Reading *reading) { m_reused.insert(reading); };
+		std::vector<Datapoint *>
+				*removedDatapoints() { return &m_removed; };
+		void		discard(std::vector<Reading *> *readings);
+		void		release(ReadingSet *readingSet);
+		static void	applyDatapoints(Reading *reading,
+						PyObject *changed,
+						std::vector<Datapoint *> *removed = NULL);
+		static bool	isImmutable(PyObject *value);
+
+	private:
+		/**
+		 * A dict passed to the script and the items it had
+		 */
+		typedef struct {
+			Reading		*reading;
+			PyObject	*dict;
+			PyObject	*items;
+			PyObject	*datapoints;
+		} Snapshot;
+
+		bool		update(Snapshot& snapshot);
+
+	private:
+		std::vector<Snapshot>	m_snapshots;
+		// Index of the snapshot of each dict
+		std::unordered_map<PyObject *, size_t>
+					m_dicts;
+		// Input readings passed on
+		std::unordered_set<Reading *>
+					m_reused;
+		// Datapoints removed from reused readings, still
+		// referenced by lazy reading objects
+		std::vector<Datapoint *>
+					m_removed;
+};
+#endif
@@ -86,6 +86,190 @@ static const char *default_config = QUOTE({
 		"type": "boolean",
 		"displayName": "Encode attribute names",
 		"default": "true"
+		},
+	"isolated_interpreter" : {
+		"description" : "Run the script in its own Python interpreter with its own GIL. Requires Python 3.12 or later and a service restart to change.",
+		"type": "boolean",
+		"displayName": "Isolated interpreter",
+		"default": "false"
+		},
+	"lazy_conversion" : {
+		"description" : "Pass readings to the script as lazy mappings that only convert the datapoints the script accesses, rather than as dicts",
+		"type": "boolean",
+		"displayName": "Lazy reading conversion",
+		"default": "false"
+		},
+	"buffer_views" : {
+		"description" : "Pass float arrays, data buffers and images to the script as memoryview objects that point to the datapoints, rather than as lists",
+		"type": "boolean",
+		"displayName": "Buffer views",
+		"default": "false"
+		},
+	"columnar" : {
+		"description" : "Call the script once per asset with the numeric datapoints of all the readings as NumPy arrays. Requires the numpy Python package.",
+		"type": "boolean",
+		"displayName": "Columnar batches",
+		"default": "false"
+		},
+	"accumulate" : {
+		"description" : "Hold readings across calls to the filter and pass them to the script in larger batches",
+		"type": "boolean",
+		"displayName": "Accumulate readings",
+		"default": "false"
+		},
+	"accumulate_count" : {
+		"description" : "Number of accumulated readings that causes the script to be called, 0 for no limit",
+		"type": "integer",
+		"displayName": "Accumulation count",
+		"default": "100",
+		"minimum": "0",
+		"validity": "accumulate == \"true\""
+		},
+	"accumulate_bytes" : {
+		"description" : "Estimated size in bytes of the accumulated reading data that causes the script to be called, 0 for no limit",
+		"type": "integer",
+		"displayName": "Accumulation size",
+		"default": "0",
+		"minimum": "0",
+		"validity": "accumulate == \"true\""
+		},
+	"accumulate_latency" : {
+		"description" : "Maximum time in milliseconds a reading is held before the script is called, 0 for no limit",
+		"type": "integer",
+		"displayName": "Maximum latency (ms)",
+		"default": "500",
+		"minimum": "0",
+		"validity": "accumulate == \"true\""
+		},
+	"async" : {
+		"description" : "Run the script on a worker thread of the filter so that the service is not blocked while the script runs",
+		"type": "boolean",
+		"displayName": "Asynchronous processing",
+		"default": "false"
+		},
+	"queue_size" : {
+		"description" : "Maximum number of sets of readings waiting for the worker thread, 0 for no limit",
+		"type": "integer",
+		"displayName": "Queue size",
+		"default": "10",
+		"minimum": "0",
+		"validity": "async == \"true\""
+		},
+	"queue_full" : {
+		"description" : "What to do with new readings when the queue is full: wait for space in the queue or discard them",
+		"type": "enumeration",
+		"options": [ "Block", "Reject" ],
+		"displayName": "Full queue policy",
+		"default": "Block",
+		"validity": "async == \"true\""
+		},
+	"worker_processes" : {
+		"description" : "Number of Python processes that run the script outside of the service, 0 to run the script in the service",
+		"type": "integer",
+		"displayName": "Worker processes",
+		"default": "0",
+		"minimum": "0"
+		},
+	"worker_buffer_size" : {
+		"description" : "Size in kilobytes of the shared memory buffers used to pass readings to each worker process",
+		"type": "integer",
+		"displayName": "Worker buffer size (KB)",
+		"default": "4096",
+		"minimum": "64",
+		"validity": "worker_processes != \"0\""
+		},
+	"worker_timeout" : {
+		"description" : "Time in milliseconds a worker process may take to process a set of readings before it is stopped and replaced, its readings being discarded, 0 for no limit",
+		"type": "integer",
+		"displayName": "Worker timeout (ms)",
+		"default": "60000",
+		"minimum": "0",
+		"validity": "worker_processes != \"0\""
+		},
+	"parallel_interpreters" : {
+		"description" : "Number of Python interpreters, each with its own GIL, that run the script on chunks of large batches at the same time, 0 to use a single interpreter. Requires Python 3.12 or later and a script that sets filter_stateless to True",
+		"type": "integer",
+		"displayName": "Parallel interpreters",
+		"default": "0",
+		"minimum": "0"
+		},
+	"parallel_min_readings" : {
+		"description" : "Smallest number of readings in a batch for it to be split between the parallel interpreters",
+		"type": "integer",
+		"displayName": "Parallel batch size",
+		"default": "1000",
+		"minimum": "1",
+		"validity": "parallel_interpreters != \"0\""
+		},
+	"gc_freeze" : {
+		"description" : "Freeze the objects of the script once it is loaded and configured, so that the Python garbage collector does not scan them. Requires an isolated interpreter",
+		"type": "boolean",
+		"displayName": "Freeze script objects",
+		"default": "false"
+		},
+	"gc_mode" : {
+		"description" : "When the Python garbage collector runs: when Python decides, which may be while the script runs, between sets of readings when Python would collect, or between sets of readings at a fixed interval",
+		"type": "enumeration",
+		"options": [ "Automatic", "Between batches", "Scheduled" ],
+		"displayName": "Garbage collection",
+		"default": "Automatic"
+		},
+	"gc_interval" : {
+		"description" : "Interval in seconds between two full collections of the Python garbage collector",
+		"type": "integer",
+		"displayName": "Collection interval",
+		"default": "60",
+		"minimum": "1",
+		"validity": "gc_mode == \"Scheduled\""
+		},
+	"time_budget" : {
+		"description" : "Maximum time in milliseconds the script may take to process a set of readings before it is interrupted, 0 for no limit",
+		"type": "integer",
+		"displayName": "Time budget (ms)",
+		"default": "0",
+		"minimum": "0"
+		},
+	"time_budget_policy" : {
+		"description" : "What is done with the readings of a call of the script interrupted as it exceeded its time budget: pass them on unfiltered, drop them, or run the script again on each half of the readings, dropping a half that exceeds the budget again. The readings are always dropped when the script is given buffer views",
+		"type": "enumeration",
+		"options": [ "Pass through", "Drop", "Retry in smaller sets" ],
+		"displayName": "Time budget exceeded",
+		"default": "Drop",
+		"validity": "time_budget != \"0\""
+		},
+	"latency_report_interval" : {
+		"description" : "Interval in seconds at which the time spent in each stage of the processing of readings is logged, 0 to disable the measurements",
+		"type": "integer",
+		"displayName": "Latency report interval",
+		"default": "0",
+		"minimum": "0"
+		},
+	"profile_duration" : {
+		"description" : "Profile the script for this number of seconds and write a report to the scripts directory, 0 to disable. A change of value starts a new profile",
+		"type": "integer",
+		"displayName": "Profile duration",
+		"default": "0",
+		"minimum": "0"
+		},
+	"profile_calls" : {
+		"description" : "End the profile after this number of calls of the script, 0 for no limit",
+		"type": "integer",
+		"displayName": "Profile calls",
+		"default": "0",
+		"minimum": "0",
+		"validity": "profile_duration != \"0\""
+		},
+	"assets" : {
+		"description" : "Comma separated names of the assets whose readings are passed to the script, * and ? may be used as wildcards. The readings of other assets are passed on unchanged. Leave empty to use the filter_assets attribute of the script, if any, or to pass all the readings",
+		"type": "string",
+		"displayName": "Assets",
+		"default": ""
+		},
+	"datapoints" : {
+		"description" : "Comma separated names of the datapoints the script reads or writes, only these are converted to Python. The other datapoints are passed on unchanged. Leave empty to use the filter_datapoints attribute of the script, if any, or to convert all the datapoints",
+		"type": "string",
+		"displayName": "Datapoints",
+		"default": ""
 		}
 	});
 using namespace std;
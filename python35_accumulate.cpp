@@ -0,0 +1,283 @@
+/*
+ * Fledge "Python 3.5" filter reading accumulation.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdlib.h>
+#include <string>
+#include "python35.h"
+
+#define ACCUMULATE_CONFIG_ITEM_NAME "accumulate"
+#define ACCUMULATE_COUNT_ITEM_NAME "accumulate_count"
+#define ACCUMULATE_BYTES_ITEM_NAME "accumulate_bytes"
+#define ACCUMULATE_LATENCY_ITEM_NAME "accumulate_latency"
+
+// Maximum latency used when no limit is set
+#define ACCUMULATE_DEFAULT_LATENCY	500
+
+using namespace std;
+
+/**
+ * Estimate the memory used by the data of a datapoint value
+ */
+static size_t valueSize(DatapointValue& value)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_STRING:
+			return value.toStringValue().length();
+		case DatapointValue::T_FLOAT_ARRAY:
+			return value.getDpArr() ? value.getDpArr()->size() * sizeof(double) : 0;
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			size_t size = 0;
+			vector<vector<double>*> *rows = value.getDp2DArr();
+			for (size_t i = 0; rows && i < rows->size(); i++)
+			{
+				size += (*rows)[i]->size() * sizeof(double);
+			}
+			return size;
+		}
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+		{
+			size_t size = 0;
+			vector<Datapoint *> *datapoints = value.getDpVec();
+			for (size_t i = 0; datapoints && i < datapoints->size(); i++)
+			{
+				size += (*datapoints)[i]->getName().length() +
+					valueSize((*datapoints)[i]->getData());
+			}
+			return size;
+		}
+		case DatapointValue::T_IMAGE:
+		{
+			DPImage *image = value.getImage();
+			return image ? (size_t)image->getWidth() * image->getHeight() * (image->getDepth() / 8) : 0;
+		}
+		case DatapointValue::T_DATABUFFER:
+		{
+			DataBuffer *buffer = value.getDataBuffer();
+			return buffer ? buffer->getItemSize() * buffer->getItemCount() : 0;
+		}
+		default:
+			return sizeof(double);
+	}
+}
+
+/**
+ * Estimate the memory used by the data of a reading
+ */
+static size_t readingSize(Reading *reading)
+{
+	size_t size = reading->getAssetName().length();
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		size += datapoints[i]->getName().length() + valueSize(datapoints[i]->getData());
+	}
+	return size;
+}
+
+/**
+ * Set the accumulation parameters from the filter configuration
+ *
+ * Readings held with the previous configuration are passed
+ * to the script first.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureAccumulation(ConfigCategory& config)
+{
+	bool accumulate = false;
+	if (config.itemExists(ACCUMULATE_CONFIG_ITEM_NAME))
+	{
+		accumulate = config.getValue(ACCUMULATE_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				config.getValue(ACCUMULATE_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	stopAccumulation();
+
+	lock_guard<mutex> guard(m_accumulateMutex);
+	if (config.itemExists(ACCUMULATE_COUNT_ITEM_NAME))
+	{
+		m_accumulateCount = strtoul(config.getValue(ACCUMULATE_COUNT_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(ACCUMULATE_BYTES_ITEM_NAME))
+	{
+		m_accumulateBytes = strtoul(config.getValue(ACCUMULATE_BYTES_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(ACCUMULATE_LATENCY_ITEM_NAME))
+	{
+		m_accumulateLatency = strtoul(config.getValue(ACCUMULATE_LATENCY_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (accumulate && !m_accumulateCount && !m_accumulateBytes && !m_accumulateLatency)
+	{
+		// The readings would be held until the filter is shut down
+		m_logger->warn("Filter %s accumulates readings with no count, size or latency limit, "
+				"a maximum latency of %d ms is used",
+				m_name.c_str(), ACCUMULATE_DEFAULT_LATENCY);
+		m_accumulateLatency = ACCUMULATE_DEFAULT_LATENCY;
+	}
+
+	m_accumulate = accumulate;
+	if (m_accumulate)
+	{
+		m_flushRunning = true;
+		m_flushThread = new thread(&Python35Filter::flushTimer, this);
+	}
+}
+
+/**
+ * Add readings to the accumulated readings, the script is called
+ * if the count or size limit is reached
+ *
+ * @param readingSet	The readings to add
+ * @return		False if accumulation is disabled,
+ *			the readings must be processed by the caller
+ */
+bool Python35Filter::accumulate(ReadingSet *readingSet)
+{
+	unique_lock<mutex> guard(m_accumulateMutex);
+	if (!m_accumulate)
+	{
+		return false;
+	}
+
+	if (m_accumulateBytes)
+	{
+		const vector<Reading *>& readings = readingSet->getAllReadings();
+		for (size_t i = 0; i < readings.size(); i++)
+		{
+			m_accumulatedBytes += readingSize(readings[i]);
+		}
+	}
+
+	if (!m_accumulated)
+	{
+		m_accumulated = readingSet;
+		m_accumulatedSince = chrono::steady_clock::now();
+		// Start the latency timer
+		m_accumulateCV.notify_all();
+	}
+	else
+	{
+		m_accumulated->append(readingSet);
+		delete readingSet;
+	}
+
+	if ((m_accumulateCount && m_accumulated->getAllReadings().size() >= m_accumulateCount) ||
+	    (m_accumulateBytes && m_accumulatedBytes >= m_accumulateBytes))
+	{
+		flush(guard);
+	}
+	return true;
+}
+
+/**
+ * Pass the accumulated readings to the script
+ *
+ * The readings are taken with the accumulation lock held and
+ * processed without it, so that ingest calls and the timer are not
+ * blocked while the script runs. Each flush waits for the previous
+ * ones to be processed, which keeps the readings in order.
+ *
+ * @param guard	The accumulation lock, held on entry and on return
+ */
+void Python35Filter::flush(unique_lock<mutex>& guard)
+{
+	if (!m_accumulated)
+	{
+		return;
+	}
+	ReadingSet *readingSet = m_accumulated;
+	m_accumulated = NULL;
+	m_accumulatedBytes = 0;
+
+	uint64_t turn = m_flushTaken++;
+	while (m_flushServed != turn)
+	{
+		m_accumulateCV.wait(guard);
+	}
+
+	guard.unlock();
+	processBatch(readingSet);
+	guard.lock();
+
+	m_flushServed++;
+	m_accumulateCV.notify_all();
+}
+
+/**
+ * Pass any accumulated readings to the script now
+ */
+void Python35Filter::flushAccumulated()
+{
+	unique_lock<mutex> guard(m_accumulateMutex);
+	flush(guard);
+}
+
+/**
+ * Stop the latency timer and pass any accumulated readings to the script
+ */
+void Python35Filter::stopAccumulation()
+{
+	thread *flushThread = NULL;
+	{
+		unique_lock<mutex> guard(m_accumulateMutex);
+		// Readings received after accumulation stops must follow those held
+		while (m_accumulated || m_flushServed != m_flushTaken)
+		{
+			if (m_accumulated)
+			{
+				flush(guard);
+			}
+			else
+			{
+				m_accumulateCV.wait(guard);
+			}
+		}
+		m_accumulate = false;
+		m_flushRunning = false;
+		flushThread = m_flushThread;
+		m_flushThread = NULL;
+		m_accumulateCV.notify_all();
+	}
+
+	if (flushThread)
+	{
+		flushThread->join();
+		delete flushThread;
+	}
+}
+
+/**
+ * Latency timer thread: flush the accumulated readings
+ * once the oldest of them has waited for the maximum latency
+ */
+void Python35Filter::flushTimer()
+{
+	unique_lock<mutex> guard(m_accumulateMutex);
+	while (m_flushRunning)
+	{
+		if (!m_accumulated || !m_accumulateLatency)
+		{
+			m_accumulateCV.wait(guard);
+			continue;
+		}
+
+		chrono::steady_clock::time_point deadline = m_accumulatedSince +
+				chrono::milliseconds(m_accumulateLatency);
+		if (chrono::steady_clock::now() >= deadline)
+		{
+			flush(guard);
+		}
+		else
+		{
+			m_accumulateCV.wait_until(guard, deadline);
+		}
+	}
+}
@@ -0,0 +1,222 @@
+/*
+ * Fledge "Python 3.5" filter asset selection.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <fnmatch.h>
+#include <string.h>
+#include <python35_assets.h>
+
+// Maximum number of cached asset names
+#define MAX_CACHED_ASSETS	4096
+
+using namespace std;
+
+/**
+ * Set the patterns of the assets passed to the script,
+ * no patterns passes all the readings to the script
+ *
+ * @param patterns	Asset names, with or without wildcards
+ */
+void PythonAssetFilter::setPatterns(const vector<string>& patterns)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_names.clear();
+	m_patterns.clear();
+	m_cache.clear();
+	for (size_t i = 0; i < patterns.size(); i++)
+	{
+		if (patterns[i].find_first_of("*?[") == string::npos)
+		{
+			m_names.insert(patterns[i]);
+		}
+		else
+		{
+			m_patterns.push_back(patterns[i]);
+		}
+	}
+}
+
+/**
+ * Return true if only some assets are passed to the script
+ */
+bool PythonAssetFilter::isEnabled()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return !m_names.empty() || !m_patterns.empty();
+}
+
+/**
+ * Return true if the readings of an asset are passed to the
+ * script, the lock must be held
+ */
+bool PythonAssetFilter::matches(const string& asset)
+{
+	if (m_names.count(asset))
+	{
+		return true;
+	}
+	if (m_patterns.empty())
+	{
+		return false;
+	}
+
+	unordered_map<string, bool>::const_iterator it = m_cache.find(asset);
+	if (it != m_cache.end())
+	{
+		return it->second;
+	}
+	bool match = false;
+	for (size_t i = 0; i < m_patterns.size() && !match; i++)
+	{
+		match = fnmatch(m_patterns[i].c_str(), asset.c_str(), 0) == 0;
+	}
+	if (m_cache.size() < MAX_CACHED_ASSETS)
+	{
+		m_cache[asset] = match;
+	}
+	return match;
+}
+
+/**
+ * Split a set of readings into the readings passed to the script
+ * and the readings that bypass it
+ *
+ * @param readingSet	The readings, the set is deleted
+ * @param bypassed	Returns the readings not passed to the script
+ * @param selected	Returns whether each reading is passed to the script
+ * @return		The readings passed to the script, NULL if none
+ */
+ReadingSet *PythonAssetFilter::split(ReadingSet *readingSet,
+				     vector<Reading *>& bypassed,
+				     vector<bool>& selected)
+{
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	vector<Reading *> *scriptReadings = new vector<Reading *>();
+	selected.reserve(readings.size());
+	{
+		lock_guard<mutex> guard(m_mutex);
+		const string *previous = NULL;
+		bool match = false;
+		for (vector<Reading *>::const_iterator elem = readings.begin();
+						      elem != readings.end();
+						      ++elem)
+		{
+			const string& assetName = (*elem)->getAssetName();
+			// Readings of the same asset usually follow each other
+			if (!previous || *previous != assetName)
+			{
+				match = matches(assetName);
+				previous = &assetName;
+			}
+			selected.push_back(match);
+			if (match)
+			{
+				scriptReadings->push_back(*elem);
+			}
+			else
+			{
+				bypassed.push_back(*elem);
+			}
+		}
+	}
+
+	// The readings are now owned by the new set and the bypassed vector
+	readingSet->clear();
+	delete readingSet;
+
+	if (scriptReadings->empty())
+	{
+		delete scriptReadings;
+		return NULL;
+	}
+	ReadingSet *result = new ReadingSet(scriptReadings);
+	delete scriptReadings;
+	return result;
+}
+
+/**
+ * Merge the readings returned by the script with the readings
+ * that bypassed it
+ *
+ * If the script returned as many readings as it was passed, each
+ * takes the place of an input reading. Otherwise all the readings
+ * returned by the script take the place of the first reading that
+ * was passed to the script. The bypassed readings keep their order.
+ *
+ * @param results	The readings returned by the script, deleted, may be NULL
+ * @param bypassed	The readings that bypassed the script
+ * @param selected	Whether each input reading was passed to the script
+ * @return		The readings to pass on
+ */
+ReadingSet *PythonAssetFilter::merge(ReadingSet *results,
+				     vector<Reading *>& bypassed,
+				     const vector<bool>& selected)
+{
+	vector<Reading *> none;
+	const vector<Reading *>& scriptReadings = results ? results->getAllReadings() : none;
+	size_t selectedCount = selected.size() - bypassed.size();
+	bool inPlace = scriptReadings.size() == selectedCount;
+
+	vector<Reading *> *merged = new vector<Reading *>();
+	merged->reserve(bypassed.size() + scriptReadings.size());
+	size_t nextBypassed = 0;
+	size_t nextResult = 0;
+	for (size_t i = 0; i < selected.size(); i++)
+	{
+		if (!selected[i])
+		{
+			merged->push_back(bypassed[nextBypassed++]);
+		}
+		else if (inPlace)
+		{
+			merged->push_back(scriptReadings[nextResult++]);
+		}
+		else if (nextResult == 0)
+		{
+			merged->insert(merged->end(), scriptReadings.begin(), scriptReadings.end());
+			nextResult = scriptReadings.size() + 1;
+		}
+	}
+	bypassed.clear();
+
+	if (results)
+	{
+		results->clear();
+		delete results;
+	}
+	ReadingSet *readingSet = new ReadingSet(merged);
+	delete merged;
+	return readingSet;
+}
+
+/**
+ * Parse a comma separated list of asset patterns
+ *
+ * @param patterns	The list
+ * @return		The patterns, without surrounding spaces
+ */
+vector<string> PythonAssetFilter::parse(const string& patterns)
+{
+	vector<string> result;
+	size_t start = 0;
+	while (start <= patterns.length())
+	{
+		size_t end = patterns.find(',', start);
+		if (end == string::npos)
+		{
+			end = patterns.length();
+		}
+		size_t first = patterns.find_first_not_of(" \t", start);
+		size_t last = patterns.find_last_not_of(" \t", end ? end - 1 : 0);
+		if (first != string::npos && first < end && last != string::npos && last >= first)
+		{
+			result.push_back(patterns.substr(first, last - first + 1));
+		}
+		start = end + 1;
+	}
+	return result;
+}
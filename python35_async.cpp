@@ -0,0 +1,233 @@
+/*
+ * Fledge "Python 3.5" filter asynchronous processing.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdlib.h>
+#include <string>
+#include "python35.h"
+
+#define ASYNC_CONFIG_ITEM_NAME "async"
+#define QUEUE_SIZE_ITEM_NAME "queue_size"
+#define QUEUE_FULL_ITEM_NAME "queue_full"
+
+using namespace std;
+
+/**
+ * Set the asynchronous processing parameters from the filter configuration
+ *
+ * If the mode changes the queued readings are processed first.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureAsync(ConfigCategory& config)
+{
+	bool async = false;
+	if (config.itemExists(ASYNC_CONFIG_ITEM_NAME))
+	{
+		async = config.getValue(ASYNC_CONFIG_ITEM_NAME).compare("true") == 0 ||
+			config.getValue(ASYNC_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	if (async != m_async)
+	{
+		stopAsync();
+	}
+
+	lock_guard<mutex> guard(m_queueMutex);
+	if (config.itemExists(QUEUE_SIZE_ITEM_NAME))
+	{
+		m_queueSize = strtoul(config.getValue(QUEUE_SIZE_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(QUEUE_FULL_ITEM_NAME))
+	{
+		m_rejectWhenFull = config.getValue(QUEUE_FULL_ITEM_NAME).compare("Reject") == 0;
+	}
+	// Producers may wait for a smaller queue
+	m_queueSpaceCV.notify_all();
+
+	if (async && !m_worker)
+	{
+		m_async = true;
+		m_worker = new thread(&Python35Filter::asyncWorker, this);
+	}
+}
+
+/**
+ * Queue a set of readings for the worker thread
+ *
+ * If the queue is full the caller waits for the worker, or
+ * the readings are discarded if the policy is to reject them.
+ * While the worker drains the queue before it stops the caller
+ * waits, so that the readings are processed in arrival order.
+ *
+ * @param readingSet	The readings to queue
+ * @return		False if asynchronous processing is disabled,
+ *			the readings must be processed by the caller
+ */
+bool Python35Filter::enqueue(ReadingSet *readingSet)
+{
+	unique_lock<mutex> guard(m_queueMutex);
+	while (true)
+	{
+		if (m_draining)
+		{
+			m_queueSpaceCV.wait(guard);
+			continue;
+		}
+		if (!m_async || !m_queueSize || m_queue.size() < m_queueSize)
+		{
+			break;
+		}
+		if (m_rejectWhenFull)
+		{
+			if (m_queueRejected++ % 100 == 0)
+			{
+				m_logger->warn("Filter %s queue is full, %lu sets of readings have been rejected",
+						m_name.c_str(), m_queueRejected);
+			}
+			delete readingSet;
+			return true;
+		}
+		m_queueBlocked++;
+		m_queueSpaceCV.wait(guard);
+	}
+
+	if (!m_async)
+	{
+		return false;
+	}
+
+	m_queue.push_back(readingSet);
+	if (m_queue.size() > m_queuePeak)
+	{
+		m_queuePeak = m_queue.size();
+	}
+	m_queueCV.notify_one();
+
+	return true;
+}
+
+/**
+ * Worker thread: run the script on the queued readings in arrival order
+ *
+ * The queue is drained before the thread exits.
+ */
+void Python35Filter::asyncWorker()
+{
+	unique_lock<mutex> guard(m_queueMutex);
+	while (true)
+	{
+		while (m_queue.empty() && m_async)
+		{
+			m_queueCV.wait(guard);
+		}
+		if (m_queue.empty())
+		{
+			break;
+		}
+
+		ReadingSet *readingSet = m_queue.front();
+		m_queue.pop_front();
+		m_workerBusy = true;
+		m_queueSpaceCV.notify_all();
+		guard.unlock();
+
+		if (!accumulate(readingSet))
+		{
+			processBatch(readingSet);
+		}
+
+		guard.lock();
+		m_workerBusy = false;
+		m_queueSpaceCV.notify_all();
+	}
+}
+
+/**
+ * Wait until all the queued readings have been processed
+ */
+void Python35Filter::waitAsyncIdle()
+{
+	unique_lock<mutex> guard(m_queueMutex);
+	while (m_worker && (!m_queue.empty() || m_workerBusy))
+	{
+		m_queueSpaceCV.wait(guard);
+	}
+}
+
+/**
+ * Process the queued readings and stop the worker thread
+ */
+void Python35Filter::stopAsync()
+{
+	thread *worker = NULL;
+	{
+		lock_guard<mutex> guard(m_queueMutex);
+		m_async = false;
+		worker = m_worker;
+		m_draining = worker != NULL;
+		m_queueCV.notify_all();
+		m_queueSpaceCV.notify_all();
+	}
+
+	if (!worker)
+	{
+		return;
+	}
+	worker->join();
+	delete worker;
+
+	reportQueue();
+
+	lock_guard<mutex> guard(m_queueMutex);
+	m_worker = NULL;
+	m_draining = false;
+	m_queueSpaceCV.notify_all();
+}
+
+/**
+ * Log the depth of the queue and the sets of readings that
+ * waited for space or were rejected, if the queue is used
+ */
+void Python35Filter::reportQueue()
+{
+	lock_guard<mutex> guard(m_queueMutex);
+	if (!m_worker)
+	{
+		return;
+	}
+	m_logger->info("Filter %s asynchronous queue: depth %lu, maximum depth %lu, "
+			"%lu waits for space, %lu sets of readings rejected",
+			m_name.c_str(), m_queue.size(), m_queuePeak, m_queueBlocked, m_queueRejected);
+}
+
+/**
+ * Return the number of sets of readings waiting for the worker thread
+ */
+size_t Python35Filter::getQueueDepth()
+{
+	lock_guard<mutex> guard(m_queueMutex);
+	return m_queue.size();
+}
+
+/**
+ * Return the maximum number of sets of readings queued at once
+ */
+size_t Python35Filter::getQueuePeak()
+{
+	lock_guard<mutex> guard(m_queueMutex);
+	return m_queuePeak;
+}
+
+/**
+ * Return the number of sets of readings rejected because the queue was full
+ */
+unsigned long Python35Filter::getQueueRejected()
+{
+	lock_guard<mutex> guard(m_queueMutex);
+	return m_queueRejected;
+}
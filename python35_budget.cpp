@@ -0,0 +1,284 @@
+/*
+ * Fledge "Python 3.5" filter execution time budget of the script.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <python35_budget.h>
+#include <python35_latency.h>
+
+// Interval at which the exception is raised again in a call that caught it
+#define BUDGET_REPEAT_MS	100
+
+using namespace std;
+
+PythonBudget::PythonBudget() : m_budget(0),
+			       m_policy(DROP),
+			       m_interpreter(NULL),
+			       m_exception(NULL),
+			       m_nextCall(0),
+			       m_thread(NULL),
+			       m_running(false),
+			       m_timeouts(0),
+			       m_slowest(0),
+			       m_timeoutsTotal(0)
+{
+}
+
+PythonBudget::~PythonBudget()
+{
+	stopWatchdog();
+}
+
+/**
+ * Set the budget of each call of the script and what is done with
+ * the readings of a call that exceeds it
+ *
+ * @param interpreter	The interpreter the script runs in
+ * @param milliseconds	The budget of a call, 0 for no limit
+ * @param policy	What the filter does with the readings of an interrupted call
+ */
+void PythonBudget::configure(PythonInterpreter *interpreter,
+			     unsigned long milliseconds,
+			     Policy policy)
+{
+	m_policy.store(policy);
+	if (milliseconds == m_budget.load() && (m_thread != NULL) == (milliseconds != 0))
+	{
+		return;
+	}
+
+	stopWatchdog();
+	m_interpreter = interpreter;
+	m_budget.store(milliseconds);
+	if (!milliseconds)
+	{
+		return;
+	}
+
+	if (!m_exception)
+	{
+		PythonInterpreter::LockState state = m_interpreter->acquire();
+		m_exception = PyErr_NewExceptionWithDoc((char *)"python35.ScriptTimeout",
+					(char *)"The call of the script exceeded its time budget",
+					PyExc_BaseException,
+					NULL);
+		if (!m_exception)
+		{
+			PyErr_Clear();
+		}
+		m_interpreter->release(state);
+	}
+	if (!m_exception)
+	{
+		Logger::getLogger()->error("Unable to create the exception interrupting the script, "
+				"the time budget is not enforced");
+		m_budget.store(0);
+		return;
+	}
+	startWatchdog();
+}
+
+/**
+ * Stop the watchdog and release the exception type, the filter is shut down
+ */
+void PythonBudget::stop()
+{
+	stopWatchdog();
+	m_budget.store(0);
+	if (m_exception)
+	{
+		PythonInterpreter::LockState state = m_interpreter->acquire();
+		Py_CLEAR(m_exception);
+		m_interpreter->release(state);
+	}
+}
+
+/**
+ * Register a call of the script made by the calling thread
+ *
+ * @return	The identifier of the call to pass to end(), 0 if there is no budget
+ */
+uint64_t PythonBudget::begin()
+{
+	unsigned long budget = m_budget.load(memory_order_relaxed);
+	if (!budget)
+	{
+		return 0;
+	}
+	Call call;
+	call.thread = PyThread_get_thread_ident();
+	call.start = chrono::steady_clock::now();
+	call.due = call.start + chrono::milliseconds(budget);
+	call.interrupted = false;
+
+	lock_guard<mutex> guard(m_mutex);
+	uint64_t id = ++m_nextCall;
+	m_calls[id] = call;
+	m_cv.notify_one();
+	return id;
+}
+
+/**
+ * Unregister a call of the script once it has returned
+ *
+ * An exception raised by the watchdog and not yet handled by
+ * Python is cancelled, so that it does not interrupt the filter.
+ *
+ * @param call	The identifier returned by begin()
+ * @return	True if the call was interrupted
+ */
+bool PythonBudget::end(uint64_t call)
+{
+	if (!call)
+	{
+		return false;
+	}
+	Call ended;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		map<uint64_t, Call>::iterator it = m_calls.find(call);
+		if (it == m_calls.end())
+		{
+			return false;
+		}
+		ended = it->second;
+		m_calls.erase(it);
+	}
+
+	int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - ended.start).count();
+	uint64_t duration = elapsed > 0 ? elapsed : 0;
+	uint64_t slowest = m_slowest.load();
+	while (duration > slowest && !m_slowest.compare_exchange_weak(slowest, duration))
+	{
+	}
+
+	if (ended.interrupted)
+	{
+		PyThreadState_SetAsyncExc(ended.thread, NULL);
+		m_timeouts++;
+		m_timeoutsTotal++;
+	}
+	return ended.interrupted;
+}
+
+/**
+ * Log the number of calls that exceeded the budget and the
+ * slowest call since the last report
+ *
+ * @param logger	The logger
+ * @param name		The name of the filter
+ */
+void PythonBudget::report(Logger *logger, const string& name)
+{
+	uint64_t timeouts = m_timeouts.exchange(0);
+	uint64_t slowest = m_slowest.exchange(0);
+	if (!slowest)
+	{
+		return;
+	}
+	logger->info("Filter %s time budget of %lu ms: %lu calls interrupted (%lu in total), slowest call %s",
+			name.c_str(),
+			getBudget(),
+			(unsigned long)timeouts,
+			(unsigned long)m_timeoutsTotal.load(),
+			PythonLatency::format(slowest).c_str());
+}
+
+/**
+ * Start the thread that interrupts the calls
+ */
+void PythonBudget::startWatchdog()
+{
+	m_running = true;
+	m_thread = new thread(&PythonBudget::watchdog, this);
+}
+
+/**
+ * Stop the thread that interrupts the calls, the calls in
+ * progress are no longer interrupted
+ */
+void PythonBudget::stopWatchdog()
+{
+	if (!m_thread)
+	{
+		return;
+	}
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_running = false;
+		m_cv.notify_all();
+	}
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+}
+
+/**
+ * Return whether a call is due to be interrupted, m_mutex must be held
+ *
+ * @param now	The current time
+ * @param next	Set to the earliest time a call is due, if none is
+ * @return	True if a call is due
+ */
+bool PythonBudget::isDue(TimePoint now, TimePoint& next)
+{
+	next = TimePoint::max();
+	for (map<uint64_t, Call>::iterator it = m_calls.begin(); it != m_calls.end(); ++it)
+	{
+		if (it->second.due <= now)
+		{
+			return true;
+		}
+		next = min(next, it->second.due);
+	}
+	return false;
+}
+
+/**
+ * The watchdog thread, raises the exception in the calls whose
+ * deadline has passed
+ *
+ * The interpreter lock is always taken before m_mutex, as by
+ * the threads calling begin() and end().
+ */
+void PythonBudget::watchdog()
+{
+	unique_lock<mutex> guard(m_mutex);
+	while (m_running)
+	{
+		TimePoint next;
+		if (!isDue(chrono::steady_clock::now(), next))
+		{
+			if (next == TimePoint::max())
+			{
+				m_cv.wait(guard);
+			}
+			else
+			{
+				m_cv.wait_until(guard, next);
+			}
+			continue;
+		}
+
+		guard.unlock();
+		PythonInterpreter::LockState state = m_interpreter->acquire();
+		guard.lock();
+		TimePoint now = chrono::steady_clock::now();
+		for (map<uint64_t, Call>::iterator it = m_calls.begin(); it != m_calls.end(); ++it)
+		{
+			if (it->second.due > now)
+			{
+				continue;
+			}
+			PyThreadState_SetAsyncExc(it->second.thread, m_exception);
+			it->second.interrupted = true;
+			it->second.due = now + chrono::milliseconds(BUDGET_REPEAT_MS);
+		}
+		guard.unlock();
+		m_interpreter->release(state);
+		guard.lock();
+	}
+}
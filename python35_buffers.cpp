@@ -0,0 +1,756 @@
+/*
+ * Fledge "Python 3.5" filter buffer views of datapoints.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <pythonreading.h>
+#include <python35_buffers.h>
+
+// Keys of the reading dict, as set by PythonReading::toPython(true, ...)
+#define READING_KEY	"reading"
+
+using namespace std;
+
+/**
+ * The object that exports the buffer of a datapoint to the
+ * memoryviews passed to the script
+ */
+typedef struct {
+	PyObject_HEAD
+	// The reading and datapoint of the buffer, NULL once released
+	Reading		*reading;
+	Datapoint	*datapoint;
+	// Row of a two dimensional array, -1 for the whole datapoint
+	Py_ssize_t	row;
+	// The datapoint, once it is kept for the script
+	Datapoint	*owned;
+	// The exporter that keeps the datapoint of another row
+	PyObject	*owner;
+	// The buffer, NULL once it may no longer be used
+	void		*data;
+	Py_ssize_t	length;
+	Py_ssize_t	itemsize;
+	const char	*format;
+	int		ndim;
+	Py_ssize_t	shape[3];
+	Py_ssize_t	strides[3];
+	// Number of buffers obtained from the exporter
+	Py_ssize_t	exports;
+} ExporterObject;
+
+// The buffer of an empty array
+static double emptyBuffer[1];
+
+/**
+ * Set the buffer of an exporter, as a C contiguous array
+ */
+static void setBuffer(ExporterObject *self,
+		      void *data,
+		      const char *format,
+		      Py_ssize_t itemsize,
+		      int ndim,
+		      const Py_ssize_t *shape)
+{
+	self->data = data ? data : emptyBuffer;
+	self->format = format;
+	self->itemsize = itemsize;
+	self->ndim = ndim;
+	self->length = itemsize;
+	for (int i = ndim - 1; i >= 0; i--)
+	{
+		self->shape[i] = shape[i];
+		self->strides[i] = self->length;
+		self->length *= shape[i];
+	}
+}
+
+static int exporterGetBuffer(ExporterObject *self, Py_buffer *view, int flags)
+{
+	if (!self->data)
+	{
+		PyErr_SetString(PyExc_BufferError, "The datapoint is no longer available");
+		view->obj = NULL;
+		return -1;
+	}
+	view->obj = (PyObject *)self;
+	Py_INCREF(self);
+	view->buf = self->data;
+	view->len = self->length;
+	view->readonly = 0;
+	view->itemsize = self->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? (char *)self->format : NULL;
+	view->ndim = self->ndim;
+	view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	self->exports++;
+	return 0;
+}
+
+static void exporterReleaseBuffer(ExporterObject *self, Py_buffer *view)
+{
+	self->exports--;
+}
+
+static void exporterDealloc(ExporterObject *self)
+{
+	PyTypeObject *type = Py_TYPE(self);
+	delete self->owned;
+	Py_XDECREF(self->owner);
+	type->tp_free((PyObject *)self);
+	Py_DECREF(type);
+}
+
+/**
+ * Exporters are only created by the filter
+ */
+static PyObject *exporterNew(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	PyErr_Format(PyExc_TypeError, "cannot create '%s' instances", type->tp_name);
+	return NULL;
+}
+
+static PyType_Slot exporterSlots[] = {
+	{Py_tp_dealloc, (void *)exporterDealloc},
+	{Py_tp_new, (void *)exporterNew},
+#if PY_VERSION_HEX >= 0x03090000
+	{Py_bf_getbuffer, (void *)exporterGetBuffer},
+	{Py_bf_releasebuffer, (void *)exporterReleaseBuffer},
+#endif
+	{Py_tp_doc, (void *)"Buffer of a Fledge datapoint"},
+	{0, NULL}
+};
+
+static PyType_Spec exporterSpec = {
+	"python35.DatapointBuffer",
+	sizeof(ExporterObject),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	exporterSlots
+};
+
+/**
+ * Return the type code of a buffer format, 0 if it is not supported
+ */
+static char formatCode(const char *format)
+{
+	if (!format)
+	{
+		return 'B';
+	}
+	if (*format == '@' || *format == '=')
+	{
+		format++;
+	}
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	else if (*format == '<')
+	{
+		format++;
+	}
+#endif
+	return format[0] && !format[1] ? format[0] : 0;
+}
+
+static bool isFloatCode(char code)
+{
+	return code == 'd' || code == 'f';
+}
+
+static bool isIntegerCode(char code)
+{
+	return code && strchr("bBhHiIlLqQ", code) != NULL;
+}
+
+/**
+ * Copy floating point values from a contiguous buffer
+ */
+static void readFloats(const char *data, char code, Py_ssize_t count, vector<double>& values)
+{
+	if (code == 'd')
+	{
+		values.assign((const double *)data, (const double *)data + count);
+		return;
+	}
+	values.resize(count);
+	const float *floats = (const float *)data;
+	for (Py_ssize_t i = 0; i < count; i++)
+	{
+		values[i] = floats[i];
+	}
+}
+
+/**
+ * A buffer obtained from an object, copied if it is not C contiguous
+ */
+class BufferContent
+{
+	public:
+		BufferContent() : m_data(NULL) { m_view.obj = NULL; };
+		~BufferContent()
+		{
+			if (m_view.obj)
+			{
+				PyBuffer_Release(&m_view);
+			}
+		};
+		bool get(PyObject *object)
+		{
+			if (PyObject_GetBuffer(object, &m_view, PyBUF_RECORDS_RO) < 0)
+			{
+				PyErr_Clear();
+				m_view.obj = NULL;
+				return false;
+			}
+			m_data = (const char *)m_view.buf;
+			if (!PyBuffer_IsContiguous(&m_view, 'C'))
+			{
+				m_copy.resize(m_view.len);
+				if (PyBuffer_ToContiguous(&m_copy[0], &m_view, m_view.len, 'C') < 0)
+				{
+					PyErr_Clear();
+					return false;
+				}
+				m_data = m_copy.data();
+			}
+			return true;
+		};
+		const Py_buffer&
+			view() const { return m_view; };
+		const char
+			*data() const { return m_data; };
+
+	private:
+		Py_buffer	m_view;
+		const char	*m_data;
+		string		m_copy;
+};
+
+/**
+ * Return true for an object with an array buffer, bytes are strings
+ */
+static bool isArray(PyObject *value)
+{
+	if (PyBytes_Check(value) || !PyObject_CheckBuffer(value))
+	{
+		return false;
+	}
+	Py_buffer view;
+	if (PyObject_GetBuffer(value, &view, PyBUF_STRIDES) < 0)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	// NumPy scalars have buffers with no dimension
+	bool array = view.ndim >= 1;
+	PyBuffer_Release(&view);
+	return array;
+}
+
+/**
+ * Return the datapoint name of a key of the reading dict
+ */
+static bool keyName(PyObject *key, string& name)
+{
+	if (PyBytes_Check(key))
+	{
+		name.assign(PyBytes_AS_STRING(key), PyBytes_GET_SIZE(key));
+		return true;
+	}
+	Py_ssize_t len;
+	const char *str = PyUnicode_Check(key) ? PyUnicode_AsUTF8AndSize(key, &len) : NULL;
+	if (!str)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	name.assign(str, len);
+	return true;
+}
+
+/**
+ * Create the exporter type in the current interpreter
+ *
+ * @return	True on success
+ */
+bool PythonBuffers::init()
+{
+	if (m_exporterType)
+	{
+		return true;
+	}
+
+	m_exporterType = PyType_FromSpec(&exporterSpec);
+	if (!m_exporterType)
+	{
+		return false;
+	}
+#if PY_VERSION_HEX < 0x03090000
+	PyBufferProcs *procs = &((PyHeapTypeObject *)m_exporterType)->as_buffer;
+	procs->bf_getbuffer = (getbufferproc)exporterGetBuffer;
+	procs->bf_releasebuffer = (releasebufferproc)exporterReleaseBuffer;
+#endif
+	return true;
+}
+
+/**
+ * Release the exporter type
+ */
+void PythonBuffers::clear()
+{
+	Py_CLEAR(m_exporterType);
+}
+
+/**
+ * Return true for the types of datapoints passed as views
+ */
+bool PythonBuffers::isBuffer(const DatapointValue& value)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_FLOAT_ARRAY:
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		case DatapointValue::T_DATABUFFER:
+		case DatapointValue::T_IMAGE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Create the Python value of a datapoint that points to its storage
+ *
+ * @param reading	The reading of the datapoint, must remain valid until release()
+ * @param datapoint	A datapoint for which isBuffer() is true
+ * @return		New reference to a memoryview, or a list of
+ *			memoryviews, NULL with a Python error set on failure
+ */
+PyObject *PythonBuffers::create(Reading *reading, Datapoint *datapoint)
+{
+	DatapointValue& value = datapoint->getData();
+	if (value.getType() != DatapointValue::T_2D_FLOAT_ARRAY)
+	{
+		return createView(reading, datapoint, -1);
+	}
+
+	vector<vector<double> *> *rows = value.getDp2DArr();
+	Py_ssize_t count = rows ? rows->size() : 0;
+	PyObject *list = PyList_New(count);
+	if (!list)
+	{
+		return NULL;
+	}
+	for (Py_ssize_t i = 0; i < count; i++)
+	{
+		PyObject *row = createView(reading, datapoint, i);
+		if (!row)
+		{
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, row);
+	}
+	return list;
+}
+
+/**
+ * Create a memoryview of the buffer of a datapoint, or of a row
+ * of a two dimensional array
+ *
+ * @return	New reference or NULL with a Python error set
+ */
+PyObject *PythonBuffers::createView(Reading *reading, Datapoint *datapoint, Py_ssize_t row)
+{
+	ExporterObject *exporter = (ExporterObject *)
+		PyType_GenericAlloc((PyTypeObject *)m_exporterType, 0);
+	if (!exporter)
+	{
+		return NULL;
+	}
+	exporter->reading = reading;
+	exporter->datapoint = datapoint;
+	exporter->row = row;
+
+	DatapointValue& value = datapoint->getData();
+	Py_ssize_t shape[3];
+	switch (value.getType())
+	{
+		case DatapointValue::T_FLOAT_ARRAY:
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			vector<double> *values = row < 0 ? value.getDpArr() : (*value.getDp2DArr())[row];
+			shape[0] = values ? values->size() : 0;
+			setBuffer(exporter, values ? values->data() : NULL, "d", sizeof(double), 1, shape);
+			break;
+		}
+		case DatapointValue::T_DATABUFFER:
+		{
+			DataBuffer *buffer = value.getDataBuffer();
+			Py_ssize_t itemsize = buffer->getItemSize();
+			const char *format = itemsize == 2 ? "H" : itemsize == 4 ? "I" : itemsize == 8 ? "Q" : "B";
+			shape[0] = buffer->getItemCount();
+			if (itemsize != 1 && *format == 'B')
+			{
+				// Items of other sizes are passed as bytes
+				shape[0] *= itemsize;
+				itemsize = 1;
+			}
+			setBuffer(exporter, buffer->getData(), format, itemsize, 1, shape);
+			break;
+		}
+		case DatapointValue::T_IMAGE:
+		default:
+		{
+			DPImage *image = value.getImage();
+			int depth = image->getDepth();
+			shape[0] = image->getHeight();
+			shape[1] = image->getWidth();
+			shape[2] = 3;
+			if (depth == 8)
+			{
+				setBuffer(exporter, image->getData(), "B", 1, 2, shape);
+			}
+			else if (depth == 16)
+			{
+				setBuffer(exporter, image->getData(), "H", 2, 2, shape);
+			}
+			else if (depth == 24)
+			{
+				setBuffer(exporter, image->getData(), "B", 1, 3, shape);
+			}
+			else
+			{
+				shape[0] = shape[0] * shape[1] * (depth / 8);
+				setBuffer(exporter, image->getData(), "B", 1, 1, shape);
+			}
+			break;
+		}
+	}
+
+	PyObject *view = PyMemoryView_FromObject((PyObject *)exporter);
+	if (!view)
+	{
+		Py_DECREF(exporter);
+		return NULL;
+	}
+	m_exporters.push_back((PyObject *)exporter);
+	Py_INCREF(view);
+	m_views.push_back(view);
+	return view;
+}
+
+/**
+ * Release the views created since the last call, once the
+ * script has returned and before the readings are deleted
+ *
+ * The views can no longer be used by the script. The datapoints
+ * whose buffers are still used by the script are replaced by copies
+ * in their readings, or taken from the removed datapoints.
+ *
+ * @param removed	The datapoints removed from the readings,
+ *			not yet deleted
+ */
+void PythonBuffers::release(vector<Datapoint *>& removed)
+{
+	for (size_t i = 0; i < m_views.size(); i++)
+	{
+		// Fails if the script holds a buffer of the view itself
+		PyObject *ret = PyObject_CallMethod(m_views[i], "release", NULL);
+		if (ret)
+		{
+			Py_DECREF(ret);
+		}
+		else
+		{
+			PyErr_Clear();
+		}
+		Py_DECREF(m_views[i]);
+	}
+	m_views.clear();
+
+	unordered_map<Datapoint *, ExporterObject *> kept;
+	for (size_t i = 0; i < m_exporters.size(); i++)
+	{
+		ExporterObject *exporter = (ExporterObject *)m_exporters[i];
+		if (exporter->exports == 0)
+		{
+			exporter->data = NULL;
+		}
+		else
+		{
+			unordered_map<Datapoint *, ExporterObject *>::const_iterator it =
+				kept.find(exporter->datapoint);
+			if (it != kept.end())
+			{
+				// Another row of the same array
+				exporter->owner = (PyObject *)it->second;
+				Py_INCREF(exporter->owner);
+			}
+			else
+			{
+				vector<Datapoint *>& points = exporter->reading->getReadingData();
+				vector<Datapoint *>::iterator p = find(points.begin(),
+								       points.end(),
+								       exporter->datapoint);
+				if (p != points.end())
+				{
+					// The reading is passed on with a copy
+					*p = new Datapoint(exporter->datapoint->getName(),
+							   exporter->datapoint->getData());
+					exporter->owned = exporter->datapoint;
+				}
+				else
+				{
+					p = find(removed.begin(), removed.end(), exporter->datapoint);
+					if (p != removed.end())
+					{
+						removed.erase(p);
+						exporter->owned = exporter->datapoint;
+					}
+				}
+				kept[exporter->datapoint] = exporter;
+			}
+		}
+		exporter->reading = NULL;
+		exporter->datapoint = NULL;
+		Py_DECREF(exporter);
+	}
+	m_exporters.clear();
+}
+
+/**
+ * Return true if a value is a view of the whole buffer of a datapoint,
+ * which the script may have modified in place
+ */
+bool PythonBuffers::isView(PyObject *value, Datapoint *datapoint)
+{
+	if (!PyMemoryView_Check(value))
+	{
+		return false;
+	}
+	Py_buffer *view = PyMemoryView_GET_BUFFER(value);
+	if (!view->obj || Py_TYPE(view->obj)->tp_dealloc != (destructor)exporterDealloc)
+	{
+		return false;
+	}
+	ExporterObject *exporter = (ExporterObject *)view->obj;
+	return exporter->datapoint == datapoint &&
+		exporter->row < 0 &&
+		view->buf == exporter->data &&
+		view->len == exporter->length;
+}
+
+/**
+ * Return true for the values converted by toDatapoint(): objects
+ * with array buffers and lists of them
+ */
+bool PythonBuffers::isBufferValue(PyObject *value)
+{
+	if (PyList_Check(value) || PyTuple_Check(value))
+	{
+		// The rows of a two dimensional array
+		return PySequence_Fast_GET_SIZE(value) > 0 &&
+			isArray(PySequence_Fast_GET_ITEM(value, 0));
+	}
+	return isArray(value);
+}
+
+/**
+ * Create a datapoint with a copy of the content of a buffer
+ *
+ * Floating point buffers of one or two dimensions are arrays,
+ * integer buffers of one dimension are data buffers, unsigned
+ * 8 bit buffers of shape (height, width) or (height, width, 3)
+ * and 16 bit buffers of shape (height, width) are images.
+ *
+ * @param name		The name of the datapoint
+ * @param value		A value for which isBufferValue() is true
+ * @return		The new datapoint
+ * @throw		runtime_error if the buffer is not supported
+ */
+Datapoint *PythonBuffers::toDatapoint(const string& name, PyObject *value)
+{
+	if (PyList_Check(value) || PyTuple_Check(value))
+	{
+		vector<vector<double> *> *empty = new vector<vector<double> *>();
+		DatapointValue array(empty);
+		Datapoint *datapoint = new Datapoint(name, array);
+		vector<vector<double> *> *rows = datapoint->getData().getDp2DArr();
+		for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(value); i++)
+		{
+			BufferContent content;
+			char code = 0;
+			if (content.get(PySequence_Fast_GET_ITEM(value, i)))
+			{
+				code = formatCode(content.view().format);
+			}
+			if (!isFloatCode(code) || content.view().ndim != 1)
+			{
+				delete datapoint;
+				throw runtime_error("The rows of datapoint " + name +
+						    " must be buffers of floating point values");
+			}
+			rows->push_back(new vector<double>());
+			readFloats(content.data(), code, content.view().shape[0], *rows->back());
+		}
+		return datapoint;
+	}
+
+	BufferContent content;
+	if (!content.get(value))
+	{
+		throw runtime_error("Unable to read the buffer of datapoint " + name);
+	}
+	const Py_buffer& view = content.view();
+	char code = formatCode(view.format);
+	Datapoint *datapoint = NULL;
+	if (isFloatCode(code) && view.ndim == 1)
+	{
+		vector<double> empty;
+		DatapointValue array(empty);
+		datapoint = new Datapoint(name, array);
+		readFloats(content.data(), code, view.shape[0], *datapoint->getData().getDpArr());
+	}
+	else if (isFloatCode(code) && view.ndim == 2)
+	{
+		vector<vector<double> *> *empty = new vector<vector<double> *>();
+		DatapointValue array(empty);
+		datapoint = new Datapoint(name, array);
+		vector<vector<double> *> *rows = datapoint->getData().getDp2DArr();
+		for (Py_ssize_t i = 0; i < view.shape[0]; i++)
+		{
+			rows->push_back(new vector<double>());
+			readFloats(content.data() + i * view.shape[1] * view.itemsize,
+				   code, view.shape[1], *rows->back());
+		}
+	}
+	else if (isIntegerCode(code) && view.ndim == 1)
+	{
+		DataBuffer *buffer = new DataBuffer(view.itemsize, view.shape[0]);
+		memcpy(buffer->getData(), content.data(), view.len);
+		DatapointValue data(buffer);
+		datapoint = new Datapoint(name, data);
+	}
+	else if ((code == 'B' && view.ndim == 2) ||
+		 (code == 'B' && view.ndim == 3 && view.shape[2] == 3) ||
+		 (code == 'H' && view.ndim == 2))
+	{
+		int depth = code == 'H' ? 16 : view.ndim == 3 ? 24 : 8;
+		DPImage *image = new DPImage(view.shape[1], view.shape[0], depth, (void *)content.data());
+		DatapointValue data(image);
+		datapoint = new Datapoint(name, data);
+	}
+	if (!datapoint)
+	{
+		throw runtime_error("The format or shape of the buffer of datapoint " + name +
+				    " is not supported");
+	}
+	return datapoint;
+}
+
+/**
+ * Create a reading from a dict returned by the script
+ *
+ * As new PythonReading(dict), but the datapoints with buffer values
+ * are converted from the content of the buffers.
+ *
+ * @param dict	The reading dict
+ * @return	The new reading
+ * @throw	exception for badly formed readings
+ */
+Reading *PythonBuffers::toReading(PyObject *dict)
+{
+	PyObject *datapoints = PyDict_Check(dict) ? PyDict_GetItemString(dict, READING_KEY) : NULL;
+	bool buffers = false;
+	if (datapoints && PyDict_Check(datapoints))
+	{
+		PyObject *key, *value;
+		Py_ssize_t pos = 0;
+		while (!buffers && PyDict_Next(datapoints, &pos, &key, &value))
+		{
+			buffers = isBufferValue(value);
+		}
+	}
+	if (!buffers)
+	{
+		return new PythonReading(dict);
+	}
+
+	// The buffers are replaced by placeholders in a copy of the dict
+	PyObject *copy = PyDict_Copy(dict);
+	PyObject *values = PyDict_New();
+	PyObject *placeholder = PyLong_FromLong(0);
+	if (!copy || !values || !placeholder)
+	{
+		Py_XDECREF(copy);
+		Py_XDECREF(values);
+		Py_XDECREF(placeholder);
+		throw runtime_error("Unable to allocate the reading");
+	}
+	vector<pair<string, PyObject *> > converted;
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	string name;
+	while (PyDict_Next(datapoints, &pos, &key, &value))
+	{
+		if (isBufferValue(value) && keyName(key, name))
+		{
+			converted.push_back(make_pair(name, value));
+			PyDict_SetItem(values, key, placeholder);
+		}
+		else
+		{
+			PyDict_SetItem(values, key, value);
+		}
+	}
+	PyDict_SetItemString(copy, READING_KEY, values);
+	Py_DECREF(values);
+	Py_DECREF(placeholder);
+
+	Reading *reading;
+	try {
+		reading = new PythonReading(copy);
+	} catch (...) {
+		Py_DECREF(copy);
+		throw;
+	}
+	Py_DECREF(copy);
+
+	for (size_t i = 0; i < converted.size(); i++)
+	{
+		Datapoint *datapoint;
+		try {
+			datapoint = toDatapoint(converted[i].first, converted[i].second);
+		} catch (...) {
+			delete reading;
+			throw;
+		}
+		// Takes the place of the placeholder
+		vector<Datapoint *>& points = reading->getReadingData();
+		size_t j = 0;
+		while (j < points.size() && points[j]->getName() != converted[i].first)
+		{
+			j++;
+		}
+		if (j < points.size())
+		{
+			delete points[j];
+			points[j] = datapoint;
+		}
+		else
+		{
+			reading->addDatapoint(datapoint);
+		}
+	}
+	return reading;
+}
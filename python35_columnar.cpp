@@ -0,0 +1,486 @@
+/*
+ * Fledge "Python 3.5" filter columnar batches.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdint.h>
+#include <stdexcept>
+#include <python35_columnar.h>
+
+#define READING_KEY	"reading"
+#define ASSET_CODE_KEY	"asset_code"
+#define TIMESTAMP_KEY	"timestamp"
+
+using namespace std;
+
+/**
+ * Return true for datapoints that can be part of a column
+ */
+static bool isNumeric(Datapoint *dp, bool& isFloat)
+{
+	DatapointValue::dataTagType type = dp->getData().getType();
+	isFloat = type == DatapointValue::T_FLOAT;
+	return isFloat || type == DatapointValue::T_INTEGER;
+}
+
+/**
+ * Check that numpy can be imported in the current interpreter
+ *
+ * @return	True if numpy is available
+ */
+bool PythonColumnar::isAvailable()
+{
+	PyObject *numpy = PyImport_ImportModule("numpy");
+	if (!numpy)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	Py_DECREF(numpy);
+	return true;
+}
+
+/**
+ * Import numpy in the current interpreter
+ *
+ * @return	True if numpy is available
+ */
+bool PythonColumnar::init()
+{
+	if (m_empty)
+	{
+		return true;
+	}
+
+	PyObject *numpy = PyImport_ImportModule("numpy");
+	if (!numpy)
+	{
+		return false;
+	}
+	m_empty = PyObject_GetAttrString(numpy, "empty");
+	m_asarray = PyObject_GetAttrString(numpy, "asarray");
+	m_ascontiguousarray = PyObject_GetAttrString(numpy, "ascontiguousarray");
+	Py_DECREF(numpy);
+
+	if (!m_empty || !m_asarray || !m_ascontiguousarray)
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Release the numpy references
+ */
+void PythonColumnar::clear()
+{
+	Py_CLEAR(m_empty);
+	Py_CLEAR(m_asarray);
+	Py_CLEAR(m_ascontiguousarray);
+	m_columns.clear();
+}
+
+/**
+ * Find the numeric datapoints present in all the readings
+ *
+ * @param readings	The readings of one asset
+ */
+void PythonColumnar::findColumns(const vector<Reading *>& readings)
+{
+	m_columns.clear();
+	if (readings.empty())
+	{
+		return;
+	}
+
+	size_t count = readings.size();
+	const vector<Datapoint *>& first = readings[0]->getReadingData();
+	for (size_t i = 0; i < first.size(); i++)
+	{
+		Column column;
+		if (isNumeric(first[i], column.isFloat))
+		{
+			column.name = first[i]->getName();
+			column.index = i;
+			column.points.resize(count);
+			column.points[0] = first[i];
+			m_columns.push_back(column);
+		}
+	}
+
+	vector<bool> valid(m_columns.size(), true);
+	for (size_t r = 1; r < count; r++)
+	{
+		const vector<Datapoint *>& datapoints = readings[r]->getReadingData();
+		for (size_t c = 0; c < m_columns.size(); c++)
+		{
+			if (!valid[c])
+			{
+				continue;
+			}
+			Column& column = m_columns[c];
+
+			// Readings of an asset usually have the same datapoints in the same order
+			Datapoint *dp = NULL;
+			if (column.index < datapoints.size() &&
+			    datapoints[column.index]->getName() == column.name)
+			{
+				dp = datapoints[column.index];
+			}
+			else
+			{
+				dp = readings[r]->getDatapoint(column.name);
+			}
+
+			bool isFloat;
+			if (!dp || !isNumeric(dp, isFloat))
+			{
+				valid[c] = false;
+				continue;
+			}
+			// Mixed integer and floating point values give a float64 column
+			column.isFloat = column.isFloat || isFloat;
+			column.points[r] = dp;
+		}
+	}
+
+	vector<Column> columns;
+	for (size_t c = 0; c < m_columns.size(); c++)
+	{
+		if (valid[c])
+		{
+			columns.push_back(m_columns[c]);
+		}
+	}
+	m_columns.swap(columns);
+}
+
+/**
+ * Create an uninitialised one dimensional array
+ *
+ * @param count		Number of elements
+ * @param isFloat	Create a float64 array rather than int64
+ * @param view		Writable buffer of the array, to be released
+ *			by the caller with PyBuffer_Release()
+ * @return		New reference or NULL on error
+ */
+PyObject *PythonColumnar::createArray(size_t count, bool isFloat, Py_buffer *view)
+{
+	PyObject *array = PyObject_CallFunction(m_empty, "ns", (Py_ssize_t)count,
+						isFloat ? "float64" : "int64");
+	if (!array)
+	{
+		return NULL;
+	}
+	if (PyObject_GetBuffer(array, view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0)
+	{
+		Py_DECREF(array);
+		return NULL;
+	}
+	return array;
+}
+
+/**
+ * Create the batch passed to the script for the readings of one asset
+ *
+ * @param readings	The readings, all with the same asset code
+ * @param encodeNames	Use bytes objects for the datapoint names
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonColumnar::createBatch(const vector<Reading *>& readings, bool encodeNames)
+{
+	findColumns(readings);
+
+	size_t count = readings.size();
+	PyObject *batch = PyDict_New();
+	PyObject *columns = PyDict_New();
+	if (!batch || !columns)
+	{
+		Py_XDECREF(batch);
+		Py_XDECREF(columns);
+		return NULL;
+	}
+
+	PyObject *asset = PyUnicode_FromString(count ? readings[0]->getAssetName().c_str() : "");
+	int ret = asset ? PyDict_SetItemString(batch, ASSET_CODE_KEY, asset) : -1;
+	Py_XDECREF(asset);
+	if (ret == 0)
+	{
+		ret = PyDict_SetItemString(batch, READING_KEY, columns);
+	}
+	Py_DECREF(columns);
+	if (ret < 0)
+	{
+		Py_DECREF(batch);
+		return NULL;
+	}
+
+	// Timestamps as seconds since the epoch
+	Py_buffer view;
+	PyObject *array = createArray(count, true, &view);
+	if (!array)
+	{
+		Py_DECREF(batch);
+		return NULL;
+	}
+	double *timestamps = (double *)view.buf;
+	for (size_t i = 0; i < count; i++)
+	{
+		struct timeval tm;
+		readings[i]->getUserTimestamp(&tm);
+		timestamps[i] = tm.tv_sec + tm.tv_usec / 1000000.0;
+	}
+	PyBuffer_Release(&view);
+	ret = PyDict_SetItemString(batch, TIMESTAMP_KEY, array);
+	Py_DECREF(array);
+	if (ret < 0)
+	{
+		Py_DECREF(batch);
+		return NULL;
+	}
+
+	for (vector<Column>::const_iterator it = m_columns.begin();
+						 it != m_columns.end();
+						 ++it)
+	{
+		array = createArray(count, it->isFloat, &view);
+		if (!array)
+		{
+			Py_DECREF(batch);
+			return NULL;
+		}
+		if (it->isFloat)
+		{
+			double *values = (double *)view.buf;
+			for (size_t i = 0; i < count; i++)
+			{
+				values[i] = it->points[i]->getData().toDouble();
+			}
+		}
+		else
+		{
+			int64_t *values = (int64_t *)view.buf;
+			for (size_t i = 0; i < count; i++)
+			{
+				values[i] = it->points[i]->getData().toInt();
+			}
+		}
+		PyBuffer_Release(&view);
+
+		PyObject *key = encodeNames ?
+			PyBytes_FromStringAndSize(it->name.c_str(), it->name.length()) :
+			PyUnicode_FromStringAndSize(it->name.c_str(), it->name.length());
+		ret = key ? PyDict_SetItem(columns, key, array) : -1;
+		Py_XDECREF(key);
+		Py_DECREF(array);
+		if (ret < 0)
+		{
+			Py_DECREF(batch);
+			return NULL;
+		}
+	}
+
+	return batch;
+}
+
+/**
+ * Convert a column returned by the script to a contiguous int64
+ * or float64 array
+ *
+ * @param value		The column returned by the script
+ * @param count		Expected number of values
+ * @param isFloat	Set to true for float64 arrays
+ * @return		New reference or NULL if the column is not valid
+ */
+PyObject *PythonColumnar::toArray(PyObject *value, size_t count, bool& isFloat)
+{
+	PyObject *array = PyObject_CallFunctionObjArgs(m_asarray, value, NULL);
+	if (!array)
+	{
+		PyErr_Clear();
+		return NULL;
+	}
+
+	// Only one dimensional integer, boolean and floating point arrays
+	bool valid = false;
+	PyObject *dtype = PyObject_GetAttrString(array, "dtype");
+	PyObject *kind = dtype ? PyObject_GetAttrString(dtype, "kind") : NULL;
+	PyObject *ndim = PyObject_GetAttrString(array, "ndim");
+	if (kind && PyUnicode_Check(kind) && ndim && PyLong_AsLong(ndim) == 1 &&
+	    PyObject_Length(array) == (Py_ssize_t)count)
+	{
+		isFloat = PyUnicode_CompareWithASCIIString(kind, "f") == 0;
+		valid = isFloat ||
+			PyUnicode_CompareWithASCIIString(kind, "i") == 0 ||
+			PyUnicode_CompareWithASCIIString(kind, "u") == 0 ||
+			PyUnicode_CompareWithASCIIString(kind, "b") == 0;
+	}
+	Py_XDECREF(dtype);
+	Py_XDECREF(kind);
+	Py_XDECREF(ndim);
+
+	PyObject *contiguous = NULL;
+	if (valid)
+	{
+		contiguous = PyObject_CallFunction(m_ascontiguousarray, "Os", array,
+						   isFloat ? "float64" : "int64");
+	}
+	Py_DECREF(array);
+	PyErr_Clear();
+
+	return contiguous;
+}
+
+/**
+ * Write a batch returned by the script back into the readings
+ *
+ * Returned columns update the datapoint of the same name, or add a
+ * new datapoint to each reading. Columns removed by the script are
+ * removed from the readings.
+ *
+ * @param batch		The batch returned by the script
+ * @param readings	The readings passed to createBatch()
+ * @throw		runtime_error if the batch is badly formed, the
+ *			readings are not modified in this case
+ */
+void PythonColumnar::applyBatch(PyObject *batch, const vector<Reading *>& readings)
+{
+	if (!PyDict_Check(batch))
+	{
+		throw runtime_error("The script must return a dict or None for each columnar batch");
+	}
+
+	PyObject *columns = PyDict_GetItemString(batch, READING_KEY);
+	if (!columns || !PyDict_Check(columns))
+	{
+		throw runtime_error("The batch returned by the script has no 'reading' dict");
+	}
+
+	string assetName;
+	PyObject *asset = PyDict_GetItemString(batch, ASSET_CODE_KEY);
+	if (asset)
+	{
+		const char *name = PyUnicode_Check(asset) ? PyUnicode_AsUTF8(asset) : NULL;
+		if (!name)
+		{
+			PyErr_Clear();
+			throw runtime_error("Unable to parse the asset code value. Asset codes should be a string.");
+		}
+		assetName = name;
+	}
+
+	// Convert all the columns before modifying the readings
+	size_t count = readings.size();
+	vector<string> names;
+	vector<bool> isFloat;
+	PyObject *arrays = PyList_New(0);
+	if (!arrays)
+	{
+		PyErr_Clear();
+		throw runtime_error("Unable to allocate the returned columns");
+	}
+
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(columns, &pos, &key, &value))
+	{
+		string name;
+		if (PyBytes_Check(key))
+		{
+			name = string(PyBytes_AS_STRING(key), PyBytes_GET_SIZE(key));
+		}
+		else if (PyUnicode_Check(key) && PyUnicode_AsUTF8(key))
+		{
+			name = PyUnicode_AsUTF8(key);
+		}
+		else
+		{
+			PyErr_Clear();
+			Py_DECREF(arrays);
+			throw runtime_error("Column names must be strings");
+		}
+
+		bool floatArray = false;
+		PyObject *array = toArray(value, count, floatArray);
+		if (!array)
+		{
+			Py_DECREF(arrays);
+			throw runtime_error("Column '" + name + "' must be a one dimensional numeric array of " +
+					    to_string(count) + " values");
+		}
+		PyList_Append(arrays, array);
+		Py_DECREF(array);
+		names.push_back(name);
+		isFloat.push_back(floatArray);
+	}
+
+	// Remove the columns dropped by the script
+	for (vector<Column>::const_iterator it = m_columns.begin();
+						 it != m_columns.end();
+						 ++it)
+	{
+		bool found = false;
+		for (size_t n = 0; n < names.size() && !found; n++)
+		{
+			found = names[n] == it->name;
+		}
+		if (!found)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				delete readings[i]->removeDatapoint(it->name);
+			}
+		}
+	}
+
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		Py_buffer view;
+		if (PyObject_GetBuffer(PyList_GET_ITEM(arrays, n), &view, PyBUF_C_CONTIGUOUS) < 0)
+		{
+			PyErr_Clear();
+			continue;
+		}
+
+		// Known column, the datapoints have been found already
+		const Column *column = NULL;
+		for (size_t c = 0; c < m_columns.size() && !column; c++)
+		{
+			if (m_columns[c].name == names[n])
+			{
+				column = &m_columns[c];
+			}
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			DatapointValue data = isFloat[n] ?
+				DatapointValue(((double *)view.buf)[i]) :
+				DatapointValue((long)((int64_t *)view.buf)[i]);
+
+			Datapoint *dp = column ? column->points[i] : readings[i]->getDatapoint(names[n]);
+			if (dp)
+			{
+				dp->getData() = data;
+			}
+			else
+			{
+				readings[i]->addDatapoint(new Datapoint(names[n], data));
+			}
+		}
+		PyBuffer_Release(&view);
+	}
+	Py_DECREF(arrays);
+
+	if (asset)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			readings[i]->setAssetName(assetName);
+		}
+	}
+}
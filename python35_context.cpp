@@ -0,0 +1,110 @@
+/*
+ * Fledge "Python 3.5" filter conversion contexts.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <python35_context.h>
+
+using namespace std;
+
+/**
+ * The contexts must have been cleared, with the interpreter lock held
+ */
+PythonContextPool::~PythonContextPool()
+{
+	for (size_t i = 0; i < m_contexts.size(); i++)
+	{
+		delete m_contexts[i];
+	}
+}
+
+/**
+ * Return a context for the exclusive use of the caller
+ *
+ * The interpreter lock must be held, the mutex of the pool is not
+ * held while Python objects are released.
+ *
+ * @param projection	The names of the datapoints converted, empty for all
+ * @return		A context to pass back to release()
+ */
+PythonContext *PythonContextPool::acquire(const shared_ptr<const vector<string> >& projection)
+{
+	PythonContext *context;
+	unsigned long generation;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (m_idle.empty())
+		{
+			context = new PythonContext();
+			m_contexts.push_back(context);
+		}
+		else
+		{
+			context = m_idle.back();
+			m_idle.pop_back();
+		}
+		generation = m_generation;
+	}
+
+	if (context->m_generation != generation || context->m_projection != projection)
+	{
+		// Names are created again with the new script or projection
+		context->m_keyCache.clear();
+		context->m_keyCache.setProjection(projection ? *projection : vector<string>());
+		context->m_generation = generation;
+		context->m_projection = projection;
+	}
+	return context;
+}
+
+/**
+ * Return a context once the call of the script is complete
+ *
+ * @param context	The context returned by acquire()
+ */
+void PythonContextPool::release(PythonContext *context)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_idle.push_back(context);
+}
+
+/**
+ * Clear the names cached by the contexts before their next use
+ */
+void PythonContextPool::invalidate()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_generation++;
+}
+
+/**
+ * Return the number of contexts, the largest number
+ * of calls of the script made at the same time
+ */
+size_t PythonContextPool::size()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_contexts.size();
+}
+
+/**
+ * Release the Python objects of all the contexts
+ *
+ * The interpreter lock must be held and no context may be in use.
+ */
+void PythonContextPool::clear()
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (size_t i = 0; i < m_contexts.size(); i++)
+	{
+		m_contexts[i]->m_keyCache.clear();
+		m_contexts[i]->m_buffers.clear();
+		m_contexts[i]->m_columnar.clear();
+		delete m_contexts[i];
+	}
+	m_contexts.clear();
+	m_idle.clear();
+}
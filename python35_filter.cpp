@@ -11,8 +11,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <time.h>
 #include <utils.h>
 #include <string>
+#include <map>
+#include <algorithm>
 #include <iostream>
 #include <pythonreading.h>
 #include <pyruntime.h>
@@ -20,6 +23,31 @@
 #define PYTHON_SCRIPT_METHOD_PREFIX "_script_"
 #define PYTHON_SCRIPT_FILENAME_EXTENSION ".py"
 #define SCRIPT_CONFIG_ITEM_NAME "script"
+#define ISOLATED_CONFIG_ITEM_NAME "isolated_interpreter"
+#define LAZY_CONFIG_ITEM_NAME "lazy_conversion"
+#define BUFFERS_CONFIG_ITEM_NAME "buffer_views"
+#define COLUMNAR_CONFIG_ITEM_NAME "columnar"
+#define WORKERS_CONFIG_ITEM_NAME "worker_processes"
+#define WORKER_BUFFER_CONFIG_ITEM_NAME "worker_buffer_size"
+#define WORKER_TIMEOUT_CONFIG_ITEM_NAME "worker_timeout"
+#define PARALLEL_CONFIG_ITEM_NAME "parallel_interpreters"
+#define PARALLEL_MIN_CONFIG_ITEM_NAME "parallel_min_readings"
+// Script attribute declaring that it keeps no state across readings
+#define SCRIPT_STATELESS_ATTRIBUTE "filter_stateless"
+#define LATENCY_CONFIG_ITEM_NAME "latency_report_interval"
+#define PROFILE_DURATION_ITEM_NAME "profile_duration"
+#define PROFILE_CALLS_ITEM_NAME "profile_calls"
+#define GC_FREEZE_ITEM_NAME "gc_freeze"
+#define GC_MODE_ITEM_NAME "gc_mode"
+#define GC_INTERVAL_ITEM_NAME "gc_interval"
+#define BUDGET_ITEM_NAME "time_budget"
+#define BUDGET_POLICY_ITEM_NAME "time_budget_policy"
+#define ASSETS_CONFIG_ITEM_NAME "assets"
+// Script attribute listing the assets it handles
+#define SCRIPT_ASSETS_ATTRIBUTE "filter_assets"
+#define DATAPOINTS_CONFIG_ITEM_NAME "datapoints"
+// Script attribute listing the datapoints it reads and writes
+#define SCRIPT_DATAPOINTS_ATTRIBUTE "filter_datapoints"
 // Filter configuration method
 #define DEFAULT_FILTER_CONFIG_METHOD "set_filter_config"
 
@@ -27,6 +55,20 @@
 
 using namespace std;
 
+/**
+ * Return a new reference to an item of a list, NULL if there is none
+ */
+static PyObject *listItem(PyObject *list, Py_ssize_t i)
+{
+#if PY_VERSION_HEX >= 0x030D0000
+	return PyList_GetItemRef(list, i);
+#else
+	PyObject *item = PyList_GetItem(list, i);
+	Py_XINCREF(item);
+	return item;
+#endif
+}
+
 /**
  * Python filter initialisation
  */
@@ -42,7 +84,63 @@ void Python35Filter::init()
 
 	m_init = true;
 
-	PyGILState_STATE state = PyGILState_Ensure(); // acquire GIL
+	// Check whether the filter should run in its own interpreter
+	if (this->getConfig().itemExists(ISOLATED_CONFIG_ITEM_NAME))
+	{
+		m_isolated = this->getConfig().getValue(ISOLATED_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				this->getConfig().getValue(ISOLATED_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	// Pass lazy reading objects rather than dicts to the script
+	if (this->getConfig().itemExists(LAZY_CONFIG_ITEM_NAME))
+	{
+		m_lazyReadings = this->getConfig().getValue(LAZY_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				this->getConfig().getValue(LAZY_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	// Pass arrays, data buffers and images as views of the datapoints
+	if (this->getConfig().itemExists(BUFFERS_CONFIG_ITEM_NAME))
+	{
+		m_bufferViews = this->getConfig().getValue(BUFFERS_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				this->getConfig().getValue(BUFFERS_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	// Pass columnar batches of readings to the script
+	if (this->getConfig().itemExists(COLUMNAR_CONFIG_ITEM_NAME))
+	{
+		m_columnarBatches = this->getConfig().getValue(COLUMNAR_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				this->getConfig().getValue(COLUMNAR_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	// Hold readings across ingest calls
+	configureAccumulation(this->getConfig());
+
+	// Run the script on a worker thread
+	configureAsync(this->getConfig());
+
+	// Measure the time spent in each stage
+	configureLatency(this->getConfig());
+
+	// Transforms applied without Python
+	configureTransforms(this->getConfig());
+
+	if (PythonInterpreter::isFreeThreaded())
+	{
+		m_logger->info("Filter '%s' runs with a free-threaded Python, "
+				"concurrent calls of the script run in parallel",
+				m_name.c_str());
+	}
+
+	if (m_isolated && !m_interpreter.create())
+	{
+		m_logger->warn("Filter '%s' is unable to create an isolated Python interpreter, "
+				"Python 3.12 or later is required. The shared interpreter will be used.",
+				m_name.c_str());
+	}
+
+	PythonInterpreter::LockState state = m_interpreter.acquire(); // acquire GIL
+
+	createTypes();
 
 	// Pass Fledge Data dir
 	setFiltersPath(getDataDir());
@@ -59,15 +157,20 @@ void Python35Filter::init()
 	// Check first we have a Python script to load
 	if (!setScriptName())
 	{
-		PyGILState_Release(state);
 		m_failedScript = true;
 		m_execCount = 0;
+		publishState();
+		m_interpreter.release(state);
 		return;
 	}
 
 	// Configure filter
 	lock();
 	bool ret = configure();
+	// The readings and datapoints passed to the script are published with it
+	configureAssets(this->getConfig());
+	configureDatapoints(this->getConfig());
+	publishState();
 	unlock();
 
 	if (!ret &&  m_init)
@@ -76,8 +179,17 @@ void Python35Filter::init()
 		m_init = false;
 	}
 
-	PyGILState_Release(state); // release GIL
+	m_interpreter.release(state); // release GIL
 
+	// Start the worker processes once the script is known to load
+	if (m_init)
+	{
+		configureWorkers(this->getConfig());
+		configureParallel(this->getConfig());
+		configureProfiler(this->getConfig());
+		configureGC(this->getConfig());
+		configureBudget(this->getConfig());
+	}
 }
 
 /**
@@ -87,49 +199,145 @@ void Python35Filter::init()
  */
 void Python35Filter::ingest(READINGSET *readingSet)
 {
-ReadingSet* finalData = NULL;
-
-	// Protect against reconfiguration
-	lock();
-	bool enabled = isEnabled();
-	unlock();
-
-	if (!enabled)
+	// A reconfiguration in progress publishes its state once it is complete
+	if (!getState()->isEnabled())
 	{
+		// Pass on first the readings queued or held before the filter was disabled
+		waitAsyncIdle();
+		flushAccumulated();
+
 		// Current filter is not active: just pass the readings set
 		m_func(m_data, readingSet);
 		return;
 	}
 
-	if (m_failedScript)
+	// Run the script on the worker thread
+	if (enqueue((ReadingSet *)readingSet))
 	{
-		if (m_execCount++ > 100)
+		return;
+	}
+
+	// Hold the readings until there are enough to call the script
+	if (accumulate((ReadingSet *)readingSet))
+	{
+		return;
+	}
+
+	processBatch(readingSet);
+}
+
+/**
+ * Run the Python script on a set of readings and pass
+ * the result to the next filter in the pipeline
+ *
+ * @param readingSet	The set of readings to process
+ */
+void Python35Filter::processBatch(READINGSET *readingSet)
+{
+	ReadingSet* finalData = NULL;
+
+	PythonFilterStatePtr script = getState();
+	const PythonTransforms *transforms = script->getTransforms();
+	if (!transforms)
+	{
+		finalData = filterSelected(readingSet, script);
+	}
+	else
+	{
+		PythonLatency::TimePoint start = m_latency.start();
+		transforms->apply(((ReadingSet *)readingSet)->getAllReadings());
+		m_latency.record(PythonLatency::TRANSFORMS, start);
+
+		// The readings of the assets named by the transforms do not enter Python
+		vector<Reading *> native;
+		vector<bool> toScript;
+		ReadingSet* scriptReadings = transforms->split((ReadingSet *)readingSet, native, toScript);
+		if (scriptReadings)
 		{
-			m_logger->warn("The %s filter plugin is unable to process data as the supplied Python script has errors.", m_name.c_str());
-			m_execCount = 0;
+			finalData = filterSelected(scriptReadings, script);
+		}
+		if (!native.empty())
+		{
+			trackAssets(native);
+			finalData = PythonAssetFilter::merge(finalData, native, toScript);
 		}
-		delete (ReadingSet *)readingSet;
-		return;
 	}
 
-	AssetTracker *tracker = AssetTracker::getAssetTracker();
-	if (!tracker)
+	if (finalData)
 	{
-		m_logger->warn("Unable to obtian a reference to the asset tracker. Changes will not be tracked");
+		passOn(finalData);
 	}
-        // Get all the readings in the readingset
-	const vector<Reading *>& readings = ((ReadingSet *)readingSet)->getAllReadings();
-	for (vector<Reading *>::const_iterator elem = readings.begin();
-						      elem != readings.end();
-						      ++elem)
+
+	// A collection due once the script has run is made between batches
+	if (m_gc.isPending())
+	{
+		PythonInterpreter::LockState state = m_interpreter.acquire();
+		m_gc.collect();
+		m_interpreter.release(state);
+	}
+}
+
+/**
+ * Run the Python script on the readings of the assets it handles
+ *
+ * @param readingSet	The set of readings to process, deleted
+ * @param script	The state of the script the readings are passed to
+ * @return		The readings to pass on, NULL for none
+ */
+ReadingSet* Python35Filter::filterSelected(READINGSET *readingSet,
+					   const PythonFilterStatePtr& script)
+{
+	PythonAssetFilter *assets = script->getAssets();
+	if (!assets->isEnabled())
+	{
+		return filterBatch(readingSet, script);
+	}
+
+	// The readings of the assets the script does not handle bypass Python
+	ReadingSet* finalData = NULL;
+	vector<Reading *> bypassed;
+	vector<bool> selected;
+	ReadingSet* scriptReadings = assets->split((ReadingSet *)readingSet, bypassed, selected);
+	if (scriptReadings)
+	{
+		finalData = filterBatch(scriptReadings, script);
+	}
+	if (!bypassed.empty())
 	{
-		if (tracker)
+		trackAssets(bypassed);
+		finalData = PythonAssetFilter::merge(finalData, bypassed, selected);
+	}
+	return finalData;
+}
+
+/**
+ * Run the Python script on a set of readings
+ *
+ * @param readingSet	The set of readings to process, deleted
+ * @param script	The script and its options as they were when the readings were received
+ * @param retry		Retry on smaller sets if the script exceeds its time budget
+ * @return		The readings to pass on, NULL for none
+ */
+ReadingSet* Python35Filter::filterBatch(READINGSET *readingSet,
+					const PythonFilterStatePtr& script,
+					bool retry)
+{
+ReadingSet* finalData = NULL;
+
+	if (script->isFailed())
+	{
+		if (m_execCount++ > 100)
 		{
-			tracker->addAssetTrackingTuple(m_name,
-							(*elem)->getAssetName(),
-							string("Filter"));
+			m_logger->warn("The %s filter plugin is unable to process data as the supplied Python script has errors.", m_name.c_str());
+			m_execCount = 0;
 		}
+		delete (ReadingSet *)readingSet;
+		return NULL;
 	}
+
+        // Get all the readings in the readingset
+	const vector<Reading *>& readings = ((ReadingSet *)readingSet)->getAllReadings();
+	trackAssets(readings);
 	
 	/**
 	 * 1 - create a Python object (list of dicts) from input data
@@ -141,226 +349,1382 @@ ReadingSet* finalData = NULL;
 
 		m_logger->fatal("The Python environment failed to  initialize, the %s filter is unable to process any data", m_name.c_str());
 		delete (ReadingSet *)readingSet;
-		return;
+		return NULL;
+	}
+
+	if (m_workers.isRunning())
+	{
+		// The script runs in the worker processes, the GIL is not needed
+		PythonLatency::TimePoint start = m_latency.start();
+		finalData = filterWorkers((ReadingSet *)readingSet);
+		if (finalData)
+		{
+			m_latency.record(PythonLatency::SCRIPT, start);
+
+			return finalData;
+		}
+		// No worker process is left, the script runs in the service
+	}
+
+	if (!script->isColumnar() && !script->isStreaming() && !m_budget.isEnabled())
+	{
+		// Chunks of a large batch run at the same time in the parallel interpreters,
+		// the calls they make are not interrupted by the time budget
+		PythonLatency::TimePoint start = m_latency.start();
+		finalData = m_parallel.process((ReadingSet *)readingSet);
+		if (finalData)
+		{
+			m_latency.record(PythonLatency::SCRIPT, start);
+			trackAssets(finalData->getAllReadings());
+
+			return finalData;
+		}
+	}
+
+	PythonLatency::TimePoint start = m_latency.start();
+	PythonInterpreter::LockState state = m_interpreter.acquire();
+	m_latency.record(PythonLatency::GIL, start);
+	m_profiler.enter();
+	bool gcSuspended = m_gc.beginBatch();
+
+	// The conversion objects of this call, not shared with concurrent calls
+	PythonContext* context = m_contexts.acquire(script->getProjection());
+
+	if (script->isColumnar())
+	{
+		// One call per asset with numeric datapoints as arrays
+		start = m_latency.start();
+		uint64_t call = m_budget.begin();
+		finalData = filterColumnar((ReadingSet *)readingSet, *script, *context);
+		if (m_budget.end(call))
+		{
+			logInterrupted("the readings were dropped");
+		}
+		m_latency.record(PythonLatency::SCRIPT, start);
+
+		m_gc.endBatch(gcSuspended);
+		m_contexts.release(context);
+		m_profiler.leave();
+		m_interpreter.release(state);
+
+		return finalData;
+	}
+
+	if (script->isStreaming())
+	{
+		// The readings are converted one at a time as the script iterates and yields
+		start = m_latency.start();
+		uint64_t call = m_budget.begin();
+		finalData = filterStream((ReadingSet *)readingSet, *script, *context);
+		if (m_budget.end(call))
+		{
+			logInterrupted("the readings were dropped");
+		}
+		m_latency.record(PythonLatency::SCRIPT, start);
+
+		m_gc.endBatch(gcSuspended);
+		m_contexts.release(context);
+		m_profiler.leave();
+		m_interpreter.release(state);
+
+		return finalData;
 	}
 
-	PyGILState_STATE state = PyGILState_Ensure();
+	PythonWriteBack& writeBack = context->getWriteBack();
 
 	// - 1 - Create Python list of dicts as input to the filter
-	PyObject* readingsList = createReadingsList(readings);
+	start = m_latency.start();
+	PyObject* readingsList = createReadingsList(readings, *script, *context);
+	m_latency.record(PythonLatency::CONVERSION, start);
 
 	// Check for errors
 	if (!readingsList)
 	{
 		// Errors while creating Python 3.5 filter input object
 		m_logger->error("Internal error in the filter %s, unable to create data to be sent to the Python filter function", m_name.c_str());
+		PyErr_Clear();
 
-		PyGILState_Release(state);
-		delete (ReadingSet *)readingSet;
-		return;
+		context->getBuffers().release(*writeBack.removedDatapoints());
+		writeBack.release((ReadingSet *)readingSet);
+		m_gc.endBatch(gcSuspended);
+		m_contexts.release(context);
+		m_profiler.leave();
+		m_interpreter.release(state);
+		return NULL;
 	}
 
 	// - 2 - Call Python method passing an object
-	PyObject* pReturn = PyObject_CallFunction(m_pFunc,
+	start = m_latency.start();
+	uint64_t call = m_budget.begin();
+	PyObject* pReturn = PyObject_CallFunction(script->getFunction(),
 						  (char *)string("O").c_str(),
 						  readingsList);
+	bool interrupted = m_budget.end(call);
+	m_latency.record(PythonLatency::SCRIPT, start);
+
+	// - 3 - Handle filter returned data
+	if (!pReturn && interrupted)
+	{
+		// The script exceeded its time budget, the input readings are kept
+		PyErr_Clear();
+		// The script may have written part of its changes through the views
+		bool changed = context->getBuffers().hasViews();
+		releaseReadingsList(readingsList, *context);
+		vector<Reading *> inputs = readings;
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			writeBack.setReused(inputs[i]);
+		}
+		writeBack.release((ReadingSet *)readingSet);
+
+		m_gc.endBatch(gcSuspended);
+		m_contexts.release(context);
+		m_profiler.leave();
+		m_interpreter.release(state);
+
+		return filterInterrupted(inputs, script, retry, changed);
+	}
+	else if (!pReturn)
+	{
+		// Errors while getting result object
+		logErrorMessage();
+
+		// Failed to get filtered data, pass on empty set of data
+		releaseReadingsList(readingsList, *context);
+		writeBack.release((ReadingSet *)readingSet);
+		finalData = new ReadingSet();
+	}
+	else
+	{
+		// Get new set of readings from Python filter
+		start = m_latency.start();
+		vector<Reading *>* newReadings = getFilteredReadings(pReturn, *context);
+		m_latency.record(PythonLatency::RESULTS, start);
+
+		// Remove pReturn object
+		Py_CLEAR(pReturn);
+
+		// Free filter input data, before the readings it may refer to
+		releaseReadingsList(readingsList, *context);
+
+		if (newReadings)
+		{
+			// Filter success
+			// - Delete input data not passed on in the new set
+			writeBack.release((ReadingSet *)readingSet);
+			readingSet = NULL;
+
+			// - Set new readings with filtered/modified data
+			finalData = new ReadingSet(newReadings);
+
+			trackAssets(finalData->getAllReadings());
+
+			// - Remove newReadings pointer
+			delete newReadings;
+		}
+		else
+		{
+			// Failed to get filtered data, pass on empty set of data
+			writeBack.release((ReadingSet *)readingSet);
+			finalData = new ReadingSet();
+		}
+	}
+
+	m_gc.endBatch(gcSuspended);
+	m_contexts.release(context);
+	m_profiler.leave();
+	m_interpreter.release(state);
+
+	// - 4 - Pass (new or old) data set to next filter
+	return finalData;
+}
+
+/**
+ * Pass the result of the script to the next filter in the pipeline
+ * and log the stage latencies when they are due
+ *
+ * @param readingSet	The readings to pass on
+ */
+void Python35Filter::passOn(ReadingSet* readingSet)
+{
+	PythonLatency::TimePoint start = m_latency.start();
+	m_func(m_data, readingSet);
+	m_latency.record(PythonLatency::DOWNSTREAM, start);
+
+	if (m_latency.report(m_logger, m_name))
+	{
+		m_gc.report(m_logger, m_name);
+		m_budget.report(m_logger, m_name);
+		reportQueue();
+	}
+}
+
+/**
+ * Apply the time budget policy to the readings of a call of
+ * the script that was interrupted, the interpreter lock is not held
+ *
+ * The readings are dropped, whatever the policy, if the script was
+ * given buffer views, as it may have changed part of their datapoints
+ * in place before it was interrupted.
+ *
+ * @param readings	The readings passed to the script
+ * @param script	The state of the script that was interrupted
+ * @param retry		Retry on smaller sets if the policy allows it
+ * @param changed	The script may have changed the readings through buffer views
+ * @return		The readings to pass on, NULL for none
+ */
+ReadingSet* Python35Filter::filterInterrupted(vector<Reading *>& readings,
+					      const PythonFilterStatePtr& script,
+					      bool retry,
+					      bool changed)
+{
+	PythonBudget::Policy policy = m_budget.getPolicy();
+	if (changed)
+	{
+		logInterrupted("the readings were dropped as the script may have changed them through buffer views");
+		for (size_t i = 0; i < readings.size(); i++)
+		{
+			delete readings[i];
+		}
+		return new ReadingSet();
+	}
+	if (policy == PythonBudget::PASS_THROUGH)
+	{
+		logInterrupted("the readings were passed on unfiltered");
+		return new ReadingSet(&readings);
+	}
+	if (policy == PythonBudget::DROP || !retry || readings.size() < 2)
+	{
+		logInterrupted("the readings were dropped");
+		for (size_t i = 0; i < readings.size(); i++)
+		{
+			delete readings[i];
+		}
+		return new ReadingSet();
+	}
+
+	// Each half is run once, a half that exceeds the budget again is dropped
+	logInterrupted("the script is run again on each half of the readings");
+	size_t half = readings.size() / 2;
+	vector<Reading *> first(readings.begin(), readings.begin() + half);
+	vector<Reading *> second(readings.begin() + half, readings.end());
+	ReadingSet* finalData = filterBatch((READINGSET *)new ReadingSet(&first), script, false);
+	ReadingSet* secondData = filterBatch((READINGSET *)new ReadingSet(&second), script, false);
+	if (!finalData)
+	{
+		return secondData;
+	}
+	if (secondData)
+	{
+		finalData->append(secondData);
+		delete secondData;
+	}
+	return finalData;
+}
+
+/**
+ * Log a call of the script interrupted as it exceeded its time budget
+ *
+ * @param outcome	What was done with the readings of the call
+ */
+void Python35Filter::logInterrupted(const char *outcome)
+{
+	m_logger->warn("The script of the filter %s exceeded its time budget of %lu ms and was interrupted, "
+			"%s, %lu interrupted calls in total",
+			m_name.c_str(),
+			m_budget.getBudget(),
+			outcome,
+			(unsigned long)m_budget.getTimeouts());
+}
+
+/**
+ * Set the interval of the stage latency reports, 0 disables the measurements
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureLatency(ConfigCategory& config)
+{
+	unsigned long interval = 0;
+	if (config.itemExists(LATENCY_CONFIG_ITEM_NAME))
+	{
+		interval = strtoul(config.getValue(LATENCY_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+	m_latency.setInterval(interval);
+}
+
+/**
+ * Set when the garbage collector runs and whether the objects of the
+ * configured script are frozen. The collections are measured while the
+ * stage latencies are reported.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureGC(ConfigCategory& config)
+{
+	bool freeze = false;
+	if (config.itemExists(GC_FREEZE_ITEM_NAME))
+	{
+		freeze = config.getValue(GC_FREEZE_ITEM_NAME).compare("true") == 0 ||
+			config.getValue(GC_FREEZE_ITEM_NAME).compare("True") == 0;
+	}
+	PythonGC::Mode mode = PythonGC::AUTOMATIC;
+	if (config.itemExists(GC_MODE_ITEM_NAME))
+	{
+		string value = config.getValue(GC_MODE_ITEM_NAME);
+		if (value.compare("Between batches") == 0)
+		{
+			mode = PythonGC::BETWEEN_BATCHES;
+		}
+		else if (value.compare("Scheduled") == 0)
+		{
+			mode = PythonGC::SCHEDULED;
+		}
+	}
+	unsigned long interval = 60;
+	if (config.itemExists(GC_INTERVAL_ITEM_NAME))
+	{
+		interval = strtoul(config.getValue(GC_INTERVAL_ITEM_NAME).c_str(), NULL, 10);
+	}
 
-	// Free filter input data
-	Py_CLEAR(readingsList);
+	PythonInterpreter::LockState state = m_interpreter.acquire();
+	if (!m_gc.configure(mode, interval, freeze, m_latency.isEnabled(), m_interpreter.isIsolated()))
+	{
+		m_logger->warn("Filter %s is unable to import the Python gc module, "
+				"the garbage collector is not controlled",
+				m_name.c_str());
+	}
+	m_interpreter.release(state);
+}
 
+/**
+ * Set the time budget of each call of the script and what is done
+ * with the readings of a call that exceeds it
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureBudget(ConfigCategory& config)
+{
+	unsigned long budget = 0;
+	if (config.itemExists(BUDGET_ITEM_NAME))
+	{
+		budget = strtoul(config.getValue(BUDGET_ITEM_NAME).c_str(), NULL, 10);
+	}
+	PythonBudget::Policy policy = PythonBudget::DROP;
+	if (config.itemExists(BUDGET_POLICY_ITEM_NAME))
+	{
+		string value = config.getValue(BUDGET_POLICY_ITEM_NAME);
+		if (value.compare("Pass through") == 0)
+		{
+			policy = PythonBudget::PASS_THROUGH;
+		}
+		else if (value.compare("Retry in smaller sets") == 0)
+		{
+			policy = PythonBudget::RETRY;
+		}
+	}
+	if (budget && policy != PythonBudget::DROP && m_bufferViews)
+	{
+		m_logger->warn("Filter '%s', the readings of an interrupted call of the script are dropped "
+				"when the script is given buffer views, as it may have changed them in place",
+				this->getName().c_str());
+	}
+	if (budget && m_parallel.isRunning())
+	{
+		m_logger->warn("Filter '%s' does not use its parallel interpreters while a time budget "
+				"is set, the script runs in a single interpreter",
+				this->getName().c_str());
+	}
+	m_budget.configure(&m_interpreter, budget, policy);
+}
+
+/**
+ * Shutdown the Python35 filter
+ */
+void Python35Filter::shutdown()
+{
+	// Pass on the queued and accumulated readings while the script is still loaded
+	stopAsync();
+	stopAccumulation();
+	m_workers.stop();
+	m_parallel.stop();
+
+	// No call of the script is interrupted from now on
+	m_budget.stop();
+
+	// The latencies and collections since the last report
+	m_latency.report(m_logger, m_name, true);
+	m_gc.report(m_logger, m_name);
+	m_budget.report(m_logger, m_name);
+
+	// Readings received from now on are passed on as they are
+	PythonFilterStatePtr disabled = make_shared<PythonFilterState>(&m_interpreter,
+								       (PyObject *)NULL,
+								       (PyObject *)NULL,
+								       m_encode_names,
+								       false,
+								       false,
+								       false,
+								       false,
+								       false,
+								       shared_ptr<const PythonTransforms>(),
+								       make_shared<PythonAssetFilter>(),
+								       shared_ptr<const vector<string> >(),
+								       false);
+	atomic_store(&m_state, disabled);
+
+	// Write the profile of the window in progress
+	m_profiler.stop();
+
+	PythonInterpreter::LockState state = m_interpreter.acquire();
+
+	// Decrement pFunc reference count
+	Py_CLEAR(m_pFunc);
+		
+	// Decrement pModule reference count
+	Py_CLEAR(m_pModule);
+
+	// Remove the reading proxy types
+	m_readingProxy.clear();
+
+	// Release the cached names, buffer types and numpy of the contexts
+	m_contexts.clear();
+
+	// Release the compiled script
+	m_scriptCache.clear();
+
+	// Remove the stream type
+	m_readingStream.clear();
+
+	// Automatic collection of the interpreter as it was
+	m_gc.clear();
+
+	m_init = false;
+
+	// Interpreter is still running, just release the GIL
+	m_interpreter.release(state);
+
+	// Remove the filter own interpreter, if any
+	m_interpreter.destroy();
+}
+
+/**
+ * Create the Python types shared by the calls of the script, the
+ * interpreter lock must be held
+ *
+ * The types are created by the configuration rather than by the first
+ * call that needs them, as calls may be made by several threads at once.
+ */
+void Python35Filter::createTypes()
+{
+	if (m_lazyReadings && !m_readingProxy.init())
+	{
+		m_logger->warn("Unable to create the lazy reading type, readings will be converted to dicts");
+		PyErr_Clear();
+		m_lazyReadings = false;
+	}
+	if (!m_readingStream.init())
+	{
+		PyErr_Clear();
+	}
+}
+
+/**
+ * Publish the state of the script used by the processing of the
+ * readings, the interpreter lock must be held
+ *
+ * The previous state is released once the readings that use it
+ * have been processed.
+ */
+void Python35Filter::publishState()
+{
+	PythonFilterStatePtr state = make_shared<PythonFilterState>(&m_interpreter,
+								    m_pModule,
+								    m_pFunc,
+								    m_encode_names,
+								    isEnabled(),
+								    m_streaming,
+								    m_lazyReadings,
+								    m_bufferViews,
+								    m_columnarBatches,
+								    m_transforms,
+								    m_assets,
+								    m_projection,
+								    m_failedScript);
+	atomic_store(&m_state, state);
+}
+
+/**
+ * Create a Python 3.5 object (list of dicts)
+ * to be passed to Python 3.5 loaded filter
+ *
+ * @param readings	The input readings
+ * @param script	The state of the script the readings are passed to
+ * @param context	The conversion objects of the call
+ * @return		PyObject pointer (list of dicts)
+ *			or NULL in case of errors
+ */
+PyObject* Python35Filter::createReadingsList(const vector<Reading *>& readings,
+					     const PythonFilterState& script,
+					     PythonContext& context)
+{
+	// TODO add checks to all PyList_XYZ methods
+	PyObject* readingsList = PyList_New(0);
+
+	PyObject *temporary_item = NULL;
+
+	PythonKeyCache& keyCache = context.getKeyCache();
+	bool encodeNames = script.encodeNames();
+	keyCache.setEncodeNames(encodeNames);
+
+	// The type is created by the configuration
+	bool lazyReadings = script.lazyReadings() && m_readingProxy.isInitialised();
+
+	PythonBuffers *buffers = NULL;
+	if (script.bufferViews())
+	{
+		if (context.getBuffers().init())
+		{
+			buffers = &context.getBuffers();
+		}
+		else
+		{
+			m_logger->warn("Unable to create the buffer type, arrays will be converted to lists");
+			PyErr_Clear();
+		}
+	}
+
+	// Iterate the input readings
+	for (vector<Reading *>::const_iterator elem = readings.begin();
+                                                      elem != readings.end();
+                                                      ++elem)
+	{
+		// Create PythonReading object from readings data	
+		PythonReading *pyReading = (PythonReading *)(*elem);
+
+		// Add new PythonReading object to the output list
+		// Passing first parameter as true, sets keys to "reading" and "asset_code"
+		// Passing second parameter as strue, sets Bytes string for backwards compatibility
+		// for DICT keys and string values
+
+		if (lazyReadings)
+		{
+			// Datapoints are only converted when the script accesses them
+			temporary_item = m_readingProxy.create(*elem, encodeNames, buffers);
+		}
+		else
+		{
+			// Names and keys are reused from previous calls,
+			// only the datapoints the script uses are converted
+			temporary_item = keyCache.toPython(pyReading, true, buffers);
+			if (temporary_item)
+			{
+				// Keep the items to find what the script changes
+				context.getWriteBack().track(*elem, temporary_item);
+			}
+		}
+
+		if (!temporary_item)
+		{
+			Py_CLEAR(readingsList);
+			break;
+		}
+
+		PyList_Append(readingsList, temporary_item);
+
+		Py_DECREF(temporary_item);
+		temporary_item =  NULL;
+	}
+
+	// Return pointer of new allocated list
+	return readingsList;
+}
+
+/**
+ * Release the list passed to the Python 3.5 filter
+ *
+ * Lazy readings in the list are detached from the input readings,
+ * which are about to be deleted, and the views of their buffers
+ * are released.
+ *
+ * @param readingsList	The list returned by createReadingsList
+ * @param context	The conversion objects of the call
+ */
+void Python35Filter::releaseReadingsList(PyObject* readingsList,
+					 PythonContext& context)
+{
+	if (m_readingProxy.isInitialised())
+	{
+		// The script may have kept the list itself
+		bool shared = Py_REFCNT(readingsList) > 1;
+		for (Py_ssize_t i = 0; i < PyList_Size(readingsList); i++)
+		{
+			// The script may change a list it has kept from another thread
+			PyObject* element = listItem(readingsList, i);
+			if (element && m_readingProxy.isProxy(element))
+			{
+				// Not counting the reference returned by listItem()
+				PythonReadingProxy::detach(element, shared, 1);
+			}
+			Py_XDECREF(element);
+		}
+	}
+
+	Py_DECREF(readingsList);
+
+	context.getBuffers().release(*context.getWriteBack().removedDatapoints());
+}
+
+/**
+ * Get the vector of filtered readings from Python 3.5 script
+ *
+ * @param filteredData	Python 3.5 Object (list of dicts)
+ * @param context	The conversion objects of the call
+ * @return		Pointer to a new allocated vector<Reading *>
+ *			or NULL in case of errors
+ * Note:
+ * input readings returned by the script are updated
+ * in place and keep their timestamps, other readings have:
+ * - new timestamps
+ * - new UUID
+ */
+vector<Reading *>* Python35Filter::getFilteredReadings(PyObject* filteredData,
+						       PythonContext& context)
+{
+	PythonWriteBack& writeBack = context.getWriteBack();
+
+	// Create result set
+	vector<Reading *>* newReadings = new vector<Reading *>();
+
+	// Allow None to mean that no readings are returned
+	if (filteredData == Py_None)
+	{
+		return newReadings;
+	}
+
+	if (PyList_Check(filteredData))
+	{
+		newReadings->reserve(PyList_Size(filteredData));
+
+		// Iterate filtered data in the list
+		bool failed = false;
+		for (Py_ssize_t i = 0; !failed && i < PyList_Size(filteredData); i++)
+		{
+			// Get list item: a new reference, the script may still
+			// change the list from another thread
+			PyObject* element = listItem(filteredData, i);
+			if (!element)
+			{
+				// Failure
+				if (PyErr_Occurred())
+				{
+					this->logErrorMessage();
+				}
+				failed = true;
+			}
+			else if (m_readingProxy.isProxy(element))
+			{
+				// Lazy reading, only changed datapoints are converted
+				try {
+					Reading *original = PythonReadingProxy::getReading(element);
+					if (original && !writeBack.isReused(original))
+					{
+						// Update the input reading rather than a copy
+						Reading *reading = m_readingProxy.toReading(element,
+								writeBack.removedDatapoints());
+						if (reading == original)
+						{
+							writeBack.setReused(original);
+						}
+						newReadings->push_back(reading);
+					}
+					else
+					{
+						newReadings->push_back(m_readingProxy.toReading(element));
+					}
+				} catch (exception &e) {
+					m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
+					failed = true;
+				}
+			}
+			else if (PyDict_Check(element))
+			{
+
+				// Create Reading object from Python object in the list,
+				// input readings are reused if only datapoints have changed
+				try {
+					Reading *reading = writeBack.reuse(element);
+					if (!reading)
+					{
+						reading = PythonBuffers::toReading(element);
+
+						// Keep the datapoints that were not passed to the script
+						Reading *original = writeBack.getReading(element);
+						PythonKeyCache& keyCache = context.getKeyCache();
+						if (original && keyCache.isProjected())
+						{
+							keyCache.copyHidden(original, reading);
+						}
+					}
+
+					if (reading)
+					{
+						// Add the new reading to result vector
+						newReadings->push_back(reading);
+					}
+				} catch (exception &e) {
+					m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
+					failed = true;
+				}
+			}
+			else
+			{
+				m_logger->error("Each element returned by the script must be a Python DICT");
+				failed = true;
+			}
+			Py_XDECREF(element);
+		}
+
+		if (failed)
+		{
+			writeBack.discard(newReadings);
+			delete newReadings;
+			return NULL;
+		}
+		return newReadings;
+	}
+	else
+	{
+		m_logger->error("The return type of the python35 filter function should be a list of readings.");
+		delete newReadings;
+		return NULL;
+	}
+
+}
+
+/**
+ * Check that columnar batches can be created when they are enabled
+ *
+ * Without numpy the script is treated as a failed script, rather than
+ * being called with something it does not expect.
+ * Must be called with the interpreter lock held.
+ *
+ * @return	False if columnar batches are enabled and numpy is missing
+ */
+bool Python35Filter::checkColumnar()
+{
+	if (!m_columnarBatches || PythonColumnar::isAvailable())
+	{
+		return true;
+	}
+
+	m_logger->error("The %s filter requires the numpy Python package for columnar batches, "
+			"the script will not be run", m_name.c_str());
+
+	Py_CLEAR(m_pModule);
+	Py_CLEAR(m_pFunc);
+	m_failedScript = true;
+	return false;
+}
+
+/**
+ * Filter a set of readings in columnar mode
+ *
+ * The readings are grouped by asset and the script is called once
+ * per asset, the returned columns are written back into the readings
+ * in place so that the order of the readings is unchanged.
+ * The script may return None to remove all the readings of an asset.
+ *
+ * @param readingSet	The readings to filter
+ * @param state		The state of the script
+ * @param context	The conversion objects of the call
+ * @return		The set of readings to pass on
+ */
+ReadingSet* Python35Filter::filterColumnar(ReadingSet* readingSet,
+					   const PythonFilterState& state,
+					   PythonContext& context)
+{
+	PythonColumnar& columnar = context.getColumnar();
+	if (!columnar.init())
+	{
+		// numpy was imported by checkColumnar(), fail as the script would
+		m_logger->error("The %s filter is unable to use numpy for columnar batches", m_name.c_str());
+		logErrorMessage();
+		delete readingSet;
+		return new ReadingSet();
+	}
+
+	// Group the readings by asset, in order of first appearance
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	vector<vector<Reading *> > batches;
+	vector<size_t> batchOf(readings.size());
+	map<string, size_t> assets;
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		const string& assetName = readings[i]->getAssetName();
+		map<string, size_t>::const_iterator it = assets.find(assetName);
+		if (it == assets.end())
+		{
+			it = assets.insert(make_pair(assetName, batches.size())).first;
+			batches.push_back(vector<Reading *>());
+		}
+		batches[it->second].push_back(readings[i]);
+		batchOf[i] = it->second;
+	}
+
+	vector<bool> removed(batches.size(), false);
+	bool removals = false;
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		PyObject* batch = columnar.createBatch(batches[b], state.encodeNames());
+		if (!batch)
+		{
+			m_logger->error("Internal error in the filter %s, unable to create data to be sent to the Python filter function", m_name.c_str());
+			logErrorMessage();
+			delete readingSet;
+			return new ReadingSet();
+		}
+
+		PyObject* pReturn = PyObject_CallFunction(state.getFunction(),
+							  (char *)string("O").c_str(),
+							  batch);
+		Py_CLEAR(batch);
+
+		if (!pReturn)
+		{
+			// Errors while getting result object
+			logErrorMessage();
+			delete readingSet;
+			return new ReadingSet();
+		}
+
+		if (pReturn == Py_None)
+		{
+			removed[b] = true;
+			removals = true;
+		}
+		else
+		{
+			try {
+				columnar.applyBatch(pReturn, batches[b]);
+			} catch (exception &e) {
+				m_logger->error("Badly formed batch returned by the Python script: %s", e.what());
+				Py_CLEAR(pReturn);
+				delete readingSet;
+				return new ReadingSet();
+			}
+		}
+		Py_CLEAR(pReturn);
+	}
+
+	if (removals)
+	{
+		vector<Reading *>* kept = new vector<Reading *>();
+		for (size_t i = 0; i < readings.size(); i++)
+		{
+			if (removed[batchOf[i]])
+			{
+				delete readings[i];
+			}
+			else
+			{
+				kept->push_back(readings[i]);
+			}
+		}
+		// The readings have been deleted or moved
+		readingSet->clear();
+		delete readingSet;
+
+		readingSet = new ReadingSet(kept);
+		delete kept;
+	}
+
+	trackAssets(readingSet->getAllReadings());
+
+	return readingSet;
+}
+
+/**
+ * Start or stop the worker processes as set in the configuration
+ *
+ * If the workers cannot be started the script runs in the service.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureWorkers(ConfigCategory& config)
+{
+	long count = 0;
+	unsigned long bufferSize = 4096;
+	unsigned long timeout = 60000;
+	if (config.itemExists(WORKERS_CONFIG_ITEM_NAME))
+	{
+		count = strtol(config.getValue(WORKERS_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(WORKER_BUFFER_CONFIG_ITEM_NAME))
+	{
+		bufferSize = strtoul(config.getValue(WORKER_BUFFER_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(WORKER_TIMEOUT_CONFIG_ITEM_NAME))
+	{
+		timeout = strtoul(config.getValue(WORKER_TIMEOUT_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+
+	m_workers.stop();
+	if (count <= 0 || m_failedScript || m_filterMethod.empty())
+	{
+		return;
+	}
+
+	string filterConfiguration = "{}";
+	if (config.itemExists("config"))
+	{
+		filterConfiguration = config.getValue("config");
+	}
+
+	// Run the workers with the Python installation of the service
+	string python;
+	PythonInterpreter::LockState state = m_interpreter.acquire();
+	PyObject* prefix = PySys_GetObject((char *)"base_exec_prefix");
+	if (prefix && PyUnicode_Check(prefix))
+	{
+		python = string(PyUnicode_AsUTF8(prefix)) + "/bin/python" +
+			to_string(PY_MAJOR_VERSION) + "." + to_string(PY_MINOR_VERSION);
+	}
+	m_interpreter.release(state);
+
+	if (!m_workers.start(m_name, python, count, bufferSize * 1024, timeout, getFiltersPath(),
+			     m_pythonScript, m_filterMethod, filterConfiguration, m_encode_names))
+	{
+		m_logger->warn("Filter %s is unable to start the Python worker processes, "
+				"the script will run in the service", m_name.c_str());
+	}
+}
+
+/**
+ * Start or stop the parallel interpreters as set in the configuration
+ *
+ * The interpreters are only used if the script declares that it keeps
+ * no state across readings, by setting its filter_stateless attribute
+ * to True. Otherwise, or if the interpreters cannot be started, the
+ * script runs in a single interpreter.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureParallel(ConfigCategory& config)
+{
+	long count = 0;
+	unsigned long minReadings = 1000;
+	if (config.itemExists(PARALLEL_CONFIG_ITEM_NAME))
+	{
+		count = strtol(config.getValue(PARALLEL_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(PARALLEL_MIN_CONFIG_ITEM_NAME))
+	{
+		minReadings = strtoul(config.getValue(PARALLEL_MIN_CONFIG_ITEM_NAME).c_str(), NULL, 10);
+	}
+
+	m_parallel.stop();
+	if (count <= 0 || m_failedScript || m_filterMethod.empty() || !m_pModule)
+	{
+		return;
+	}
+
+	bool stateless = false;
+	PythonInterpreter::LockState state = m_interpreter.acquire();
+	PyObject* value = PyObject_GetAttrString(m_pModule, SCRIPT_STATELESS_ATTRIBUTE);
+	if (value)
+	{
+		stateless = PyObject_IsTrue(value) == 1;
+		Py_DECREF(value);
+	}
+	PyErr_Clear();
+	m_interpreter.release(state);
+
+	if (!stateless)
+	{
+		m_logger->warn("Filter %s runs its script in a single interpreter, "
+				"the script does not set %s to True",
+				m_name.c_str(), SCRIPT_STATELESS_ATTRIBUTE);
+		return;
+	}
+	if (!PythonInterpreter::isolationSupported())
+	{
+		m_logger->warn("Filter %s runs its script in a single interpreter, "
+				"parallel interpreters require Python 3.12 or later",
+				m_name.c_str());
+		return;
+	}
+
+	string filterConfiguration = "{}";
+	if (config.itemExists("config"))
+	{
+		filterConfiguration = config.getValue("config");
+	}
 
-	// - 3 - Handle filter returned data
-	if (!pReturn)
+	if (!m_parallel.start(m_name, count, minReadings, getFiltersPath(), m_pythonScript,
+			      m_filterMethod, filterConfiguration, m_encode_names,
+			      *m_projection))
 	{
-		// Errors while getting result object
-		logErrorMessage();
+		m_logger->warn("Filter %s is unable to start the parallel Python interpreters, "
+				"the script runs in a single interpreter", m_name.c_str());
+	}
+}
 
-		// Failed to get filtered data, pass on empty set of data
-		delete (ReadingSet *)readingSet;
-		finalData = new ReadingSet();
+/**
+ * Return the names listed by an attribute of the script, a
+ * string of comma separated names or a list of strings
+ *
+ * The interpreter lock must be held.
+ *
+ * @param attribute	The name of the attribute
+ * @return		The names, none if the attribute is not set
+ */
+vector<string> Python35Filter::getScriptNames(const char *attribute)
+{
+	vector<string> names;
+	if (!m_pModule)
+	{
+		return names;
 	}
-	else
+
+	if (PyObject_HasAttrString(m_pModule, attribute))
 	{
-		// Get new set of readings from Python filter
-		vector<Reading *>* newReadings = getFilteredReadings(pReturn);
-		if (newReadings)
+		PyObject* value = PyObject_GetAttrString(m_pModule, attribute);
+		if (value && PyUnicode_Check(value))
 		{
-			// Filter success
-			// - Delete input data as we have a new set
-			delete (ReadingSet *)readingSet;
-			readingSet = NULL;
-
-			// - Set new readings with filtered/modified data
-			finalData = new ReadingSet(newReadings);
-
-			const vector<Reading *>& readings2 = finalData->getAllReadings();
-			if (tracker)
+			names = PythonAssetFilter::parse(PyUnicode_AsUTF8(value));
+		}
+		else if (value && (PyList_Check(value) || PyTuple_Check(value)))
+		{
+			PyObject* items = PySequence_Fast(value, "");
+			for (Py_ssize_t i = 0; items && i < PySequence_Fast_GET_SIZE(items); i++)
 			{
-				for (vector<Reading *>::const_iterator elem = readings2.begin();
-								      elem != readings2.end();
-								      ++elem)
+				PyObject* item = PySequence_Fast_GET_ITEM(items, i);
+				if (PyUnicode_Check(item))
 				{
-					tracker->addAssetTrackingTuple(m_name,
-									(*elem)->getAssetName(),
-									string("Filter"));
+					names.push_back(PyUnicode_AsUTF8(item));
 				}
 			}
-
-			// - Remove newReadings pointer
-			delete newReadings;
+			Py_XDECREF(items);
 		}
-		else
+		else if (value && value != Py_None)
 		{
-			// Failed to get filtered data, pass on empty set of data
-			delete (ReadingSet *)readingSet;
-			finalData = new ReadingSet();
+			m_logger->warn("Filter %s ignores the %s attribute of its script, "
+					"it must be a string or a list of strings",
+					m_name.c_str(), attribute);
 		}
-
-		// Remove pReturn object
-		Py_CLEAR(pReturn);
+		Py_XDECREF(value);
+		PyErr_Clear();
 	}
 
-	PyGILState_Release(state);
-
-	// - 4 - Pass (new or old) data set to next filter
-	m_func(m_data, finalData);
+	return names;
 }
 
 /**
- * Shutdown the Python35 filter
+ * Set the assets whose readings are passed to the script
+ *
+ * The assets item of the configuration takes precedence over the
+ * filter_assets attribute of the script, a string or a list of
+ * strings that the script may set in set_filter_config(). The
+ * selection is published with the script by publishState(), the
+ * interpreter lock must be held.
+ *
+ * @param config	The filter configuration
  */
-void Python35Filter::shutdown()
+void Python35Filter::configureAssets(ConfigCategory& config)
 {
-	PyGILState_STATE state = PyGILState_Ensure();
+	vector<string> patterns;
+	if (config.itemExists(ASSETS_CONFIG_ITEM_NAME))
+	{
+		patterns = PythonAssetFilter::parse(config.getValue(ASSETS_CONFIG_ITEM_NAME));
+	}
+	if (patterns.empty())
+	{
+		patterns = getScriptNames(SCRIPT_ASSETS_ATTRIBUTE);
+	}
 
-	// Decrement pFunc reference count
-	Py_CLEAR(m_pFunc);
-		
-	// Decrement pModule reference count
-	Py_CLEAR(m_pModule);
+	// The readings being processed keep the selection they were received with
+	shared_ptr<PythonAssetFilter> assets = make_shared<PythonAssetFilter>();
+	assets->setPatterns(patterns);
+	m_assets = assets;
+}
 
-	m_init = false;
+/**
+ * Compile the transforms applied without Python, they are
+ * declared in the configuration passed to the script
+ *
+ * @param config	The configuration of the filter
+ */
+void Python35Filter::configureTransforms(ConfigCategory& config)
+{
+	string filterConfiguration = "{}";
+	if (config.itemExists("config"))
+	{
+		filterConfiguration = config.getValue("config");
+	}
 
-	// Interpreter is still running, just release the GIL
-	PyGILState_Release(state);
+	m_transforms.reset(PythonTransforms::create(m_name, filterConfiguration));
+	if (m_transforms)
+	{
+		m_logger->info("Filter %s applies %lu transforms without Python",
+				m_name.c_str(), (unsigned long)m_transforms->size());
+	}
 }
 
 /**
- * Create a Python 3.5 object (list of dicts)
- * to be passed to Python 3.5 loaded filter
+ * Set the datapoints converted for the script
  *
- * @param readings	The input readings
- * @return		PyObject pointer (list of dicts)
- *			or NULL in case of errors
+ * The datapoints item of the configuration takes precedence over
+ * the filter_datapoints attribute of the script. The projection is
+ * published with the script by publishState(), the interpreter
+ * lock must be held.
+ *
+ * @param config	The filter configuration
  */
-PyObject* Python35Filter::createReadingsList(const vector<Reading *>& readings)
+void Python35Filter::configureDatapoints(ConfigCategory& config)
 {
-	// TODO add checks to all PyList_XYZ methods
-	PyObject* readingsList = PyList_New(0);
+	vector<string> names;
+	if (config.itemExists(DATAPOINTS_CONFIG_ITEM_NAME))
+	{
+		names = PythonAssetFilter::parse(config.getValue(DATAPOINTS_CONFIG_ITEM_NAME));
+	}
+	if (names.empty())
+	{
+		names = getScriptNames(SCRIPT_DATAPOINTS_ATTRIBUTE);
+	}
 
-	PyObject *temporary_item = NULL;
+	m_projection = make_shared<const vector<string> >(names);
+}
 
-	// Iterate the input readings
-	for (vector<Reading *>::const_iterator elem = readings.begin();
-                                                      elem != readings.end();
-                                                      ++elem)
+/**
+ * Start a profiling window of the script when the profiling
+ * options change, the window ends by itself
+ *
+ * The report is written to the scripts directory.
+ *
+ * @param config	The filter configuration
+ */
+void Python35Filter::configureProfiler(ConfigCategory& config)
+{
+	unsigned long duration = 0;
+	unsigned long calls = 0;
+	if (config.itemExists(PROFILE_DURATION_ITEM_NAME))
 	{
-		// Create PythonReading object from readings data	
-		PythonReading *pyReading = (PythonReading *)(*elem);
-
-		// Add new PythonReading object to the output list
-		// Passing first parameter as true, sets keys to "reading" and "asset_code"
-		// Passing second parameter as strue, sets Bytes string for backwards compatibility
-		// for DICT keys and string values
+		duration = strtoul(config.getValue(PROFILE_DURATION_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (config.itemExists(PROFILE_CALLS_ITEM_NAME))
+	{
+		calls = strtoul(config.getValue(PROFILE_CALLS_ITEM_NAME).c_str(), NULL, 10);
+	}
+	if (duration == m_profileDuration && calls == m_profileCalls)
+	{
+		return;
+	}
+	m_profileDuration = duration;
+	m_profileCalls = calls;
 
-		temporary_item = pyReading->toPython(true, m_encode_names);
+	m_profiler.stop();
+	if (!duration)
+	{
+		return;
+	}
+	if (m_workers.isRunning())
+	{
+		m_logger->warn("Filter %s is unable to profile a script that runs in worker processes",
+				m_name.c_str());
+		return;
+	}
+	if (PythonInterpreter::isFreeThreaded())
+	{
+		// The stack of a running thread can not be sampled without the GIL
+		m_logger->warn("Filter %s is unable to profile a script with a free-threaded Python",
+				m_name.c_str());
+		return;
+	}
 
-		PyList_Append(readingsList, temporary_item);
+	char timestamp[32];
+	time_t now = time(NULL);
+	struct tm tm;
+	strftime(timestamp, sizeof(timestamp), "%Y%m%d%H%M%S", localtime_r(&now, &tm));
+	string name = m_name;
+	replace(name.begin(), name.end(), '/', '_');
+	m_profiler.start(&m_interpreter, m_name,
+			 getFiltersPath() + "/" + name + "_profile_" + timestamp + ".txt",
+			 duration, calls);
+}
 
-		Py_DECREF(temporary_item);
-		temporary_item =  NULL;
+/**
+ * Filter a set of readings in the worker processes
+ *
+ * @param readingSet	The readings to filter, deleted unless
+ *			no worker process is running
+ * @return		The set of readings to pass on, empty if the
+ *			script failed, NULL if no worker process is running
+ */
+ReadingSet* Python35Filter::filterWorkers(ReadingSet* readingSet)
+{
+	vector<Reading *>* newReadings = new vector<Reading *>();
+	PythonWorkerPool::Status status = m_workers.process(readingSet->getAllReadings(), *newReadings);
+	if (status == PythonWorkerPool::UNAVAILABLE)
+	{
+		delete newReadings;
+		return NULL;
+	}
+	delete readingSet;
+	if (status == PythonWorkerPool::FAILED)
+	{
+		delete newReadings;
+		return new ReadingSet();
 	}
 
-	// Return pointer of new allocated list
-	return readingsList;
+	ReadingSet* finalData = new ReadingSet(newReadings);
+	delete newReadings;
+
+	trackAssets(finalData->getAllReadings());
+
+	return finalData;
 }
 
 /**
- * Get the vector of filtered readings from Python 3.5 script
+ * Filter a set of readings with a generator script
  *
- * @param filteredData	Python 3.5 Object (list of dicts)
- * @return		Pointer to a new allocated vector<Reading *>
- *			or NULL in case of errors
- * Note:
- * new readings have:
- * - new timestamps
- * - new UUID
+ * The script is passed an iterator over the readings and each reading
+ * it yields is converted at once, neither the input nor the output of
+ * the script exist as a whole in Python.
+ *
+ * @param readingSet	The readings to filter, deleted
+ * @param state		The state of the script
+ * @param context	The conversion objects of the call
+ * @return		The set of readings to pass on,
+ *			empty if the script failed
  */
-vector<Reading *>* Python35Filter::getFilteredReadings(PyObject* filteredData)
+ReadingSet* Python35Filter::filterStream(ReadingSet* readingSet,
+					 const PythonFilterState& state,
+					 PythonContext& context)
 {
-	// Create result set
-	vector<Reading *>* newReadings = new vector<Reading *>();
+	context.getKeyCache().setEncodeNames(state.encodeNames());
 
-	// Allow None to mean that no readings are returned
-	if (filteredData == Py_None)
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	PyObject* stream = m_readingStream.create(readings, &context.getKeyCache());
+	if (!stream)
 	{
-		return newReadings;
+		m_logger->error("Internal error in the filter %s, unable to create data to be sent to the Python filter function", m_name.c_str());
+		logErrorMessage();
+		delete readingSet;
+		return new ReadingSet();
 	}
 
-	if (PyList_Check(filteredData))
+	vector<Reading *>* newReadings = new vector<Reading *>();
+	bool failed = false;
+	PyObject* pReturn = PyObject_CallFunctionObjArgs(state.getFunction(), stream, NULL);
+	PyObject* iterator = pReturn ? PyObject_GetIter(pReturn) : NULL;
+	PyObject* element;
+	while (iterator && !failed && (element = PyIter_Next(iterator)) != NULL)
 	{
-		// Iterate filtered data in the list
-		for (int i = 0; i < PyList_Size(filteredData); i++)
+		if (PyDict_Check(element))
 		{
-			// Get list item: borrowed reference.
-			PyObject* element = PyList_GetItem(filteredData, i);
-			if (!element)
-			{
-				// Failure
-				if (PyErr_Occurred())
-				{
-					this->logErrorMessage();
-				}
-				delete newReadings;
-
-				return NULL;
+			try {
+				newReadings->push_back(PythonBuffers::toReading(element));
+			} catch (exception &e) {
+				m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
+				failed = true;
 			}
+		}
+		else if (element != Py_None)
+		{
+			m_logger->error("Each element returned by the script must be a Python DICT");
+			failed = true;
+		}
+		Py_DECREF(element);
+	}
+	if (PyErr_Occurred())
+	{
+		logErrorMessage();
+		failed = true;
+	}
+	Py_XDECREF(iterator);
+	Py_XDECREF(pReturn);
 
-			if (PyDict_Check(element))
-			{
-
-				// Create Reading object from Python object in the list
-				try {
-					Reading *reading = new PythonReading(element);
+	// Delete the readings the script has not consumed
+	size_t consumed = PythonReadingStream::detach(stream);
+	Py_DECREF(stream);
+	for (size_t i = consumed; i < readings.size(); i++)
+	{
+		delete readings[i];
+	}
+	readingSet->clear();
+	delete readingSet;
 
-					if (reading)
-					{
-						// Add the new reading to result vector
-						newReadings->push_back(reading);
-					}
-				} catch (exception &e) {
-					m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
-					delete newReadings;
-					return NULL;
-				}
-			}
-			else
-			{
-				m_logger->error("Each element returned by the script must be a Python DICT");
-				delete newReadings;
-				return NULL;
-			}
+	if (failed)
+	{
+		// Failed to get filtered data, pass on empty set of data
+		for (size_t i = 0; i < newReadings->size(); i++)
+		{
+			delete (*newReadings)[i];
 		}
+		delete newReadings;
+		return new ReadingSet();
+	}
 
-		return newReadings;
+	ReadingSet* finalData = new ReadingSet(newReadings);
+	delete newReadings;
+	trackAssets(finalData->getAllReadings());
+
+	return finalData;
+}
+
+/**
+ * Add the asset tracking tuples of a set of readings
+ *
+ * The asset tracker is only called for assets the filter has not
+ * registered since it was last configured.
+ *
+ * @param readings	The readings
+ */
+void Python35Filter::trackAssets(const vector<Reading *>& readings)
+{
+	AssetTracker *tracker = AssetTracker::getAssetTracker();
+	if (!tracker)
+	{
+		if (!m_trackerMissing.exchange(true))
+		{
+			m_logger->warn("Unable to obtain a reference to the asset tracker. Changes will not be tracked");
+		}
+		return;
 	}
-	else
+
+	PythonLatency::TimePoint start = m_latency.start();
+	unique_lock<mutex> guard(m_trackedMutex);
+	const string *previous = NULL;
+	for (vector<Reading *>::const_iterator elem = readings.begin();
+					      elem != readings.end();
+					      ++elem)
 	{
-		m_logger->error("The return type of the python35 filter function should be a list of readings.");
-		delete newReadings;
-		return NULL;
+		const string& assetName = (*elem)->getAssetName();
+		// Readings of the same asset usually follow each other
+		if (previous && *previous == assetName)
+		{
+			continue;
+		}
+		previous = &assetName;
+		if (m_trackedAssets.insert(assetName).second)
+		{
+			tracker->addAssetTrackingTuple(m_name,
+							assetName,
+							string("Filter"));
+			m_trackedCalls++;
+		}
 	}
+	guard.unlock();
+	m_latency.record(PythonLatency::ASSET_TRACKING, start);
+}
 
+/**
+ * Return the number of calls of the asset tracker since the filter started
+ */
+unsigned long Python35Filter::getTrackedCalls()
+{
+	lock_guard<mutex> guard(m_trackedMutex);
+	return m_trackedCalls;
 }
 
 /**
@@ -452,11 +1816,58 @@ bool Python35Filter::reconfigure(const string& newConfig)
 
 	ConfigCategory category("new", newConfig);
 	string newScript;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
 	// Configuration change is protected by a lock
 	lock_guard<mutex> guard(m_configMutex);
+	chrono::steady_clock::time_point locked = chrono::steady_clock::now();
+
+	// Register the assets again with the new configuration
+	{
+		lock_guard<mutex> trackedGuard(m_trackedMutex);
+		m_trackedAssets.clear();
+	}
+
+	// The interpreter is chosen when the filter starts
+	if (category.itemExists(ISOLATED_CONFIG_ITEM_NAME))
+	{
+		bool isolated = category.getValue(ISOLATED_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				category.getValue(ISOLATED_CONFIG_ITEM_NAME).compare("True") == 0;
+		if (isolated != m_isolated)
+		{
+			m_logger->warn("Filter '%s', a change of '%s' requires a restart of the service",
+					this->getName().c_str(),
+					ISOLATED_CONFIG_ITEM_NAME);
+		}
+	}
+
+	if (category.itemExists(LAZY_CONFIG_ITEM_NAME))
+	{
+		m_lazyReadings = category.getValue(LAZY_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				category.getValue(LAZY_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	if (category.itemExists(BUFFERS_CONFIG_ITEM_NAME))
+	{
+		m_bufferViews = category.getValue(BUFFERS_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				category.getValue(BUFFERS_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
+
+	if (category.itemExists(COLUMNAR_CONFIG_ITEM_NAME))
+	{
+		m_columnarBatches = category.getValue(COLUMNAR_CONFIG_ITEM_NAME).compare("true") == 0 ||
+				category.getValue(COLUMNAR_CONFIG_ITEM_NAME).compare("True") == 0;
+	}
 
-	PyGILState_STATE state = PyGILState_Ensure(); // acquire GIL
+	// Queued and accumulated readings are processed before the script may change
+	configureAsync(category);
+	configureAccumulation(category);
+	configureLatency(category);
+	configureTransforms(category);
+
+	PythonInterpreter::LockState state = m_interpreter.acquire(); // acquire GIL
+
+	createTypes();
 
 	// Get Python script file from "file" attibute of "scipt" item
 	if (category.itemExists(SCRIPT_CONFIG_ITEM_NAME))
@@ -500,18 +1911,35 @@ bool Python35Filter::reconfigure(const string& newConfig)
 					  this->getName().c_str(),
 					  this->getName().c_str());
 		// Force disable
-		PyGILState_Release(state);
 		this->disableFilter();
+		publishState();
+		m_interpreter.release(state);
 		return false;
 	}
 
+	// If only the configuration of the script has changed the
+	// module and its state are kept and set_filter_config is called
+	bool configOnly = m_pModule && m_pFunc && !m_failedScript &&
+			newScript.compare(m_pythonScript) == 0 &&
+			m_scriptCache.isUnchanged(getFiltersPath(), newScript);
+
+	if (!configOnly)
+	{
+		// Names are created again with the new script
+		m_contexts.invalidate();
+	}
+
 	// Reload module or Import module ?
-	if (newScript.compare(m_pythonScript) == 0 && m_pModule)
+	if (configOnly)
+	{
+		m_execCount = 0;
+	}
+	else if (newScript.compare(m_pythonScript) == 0 && m_pModule)
 	{
 		m_failedScript = false;
 		m_execCount = 0;
-		// Reimport module
-		PyObject* newModule = PyImport_ReloadModule(m_pModule);
+		// Reimport module, unless the content of the script is unchanged
+		PyObject* newModule = m_scriptCache.load(getFiltersPath(), newScript, m_pModule);
 		if (newModule)
 		{
 			// Cleanup Loaded module
@@ -535,8 +1963,9 @@ bool Python35Filter::reconfigure(const string& newConfig)
 						   m_pythonScript.c_str());
 			logErrorMessage();
 
-			PyGILState_Release(state);
 			m_failedScript = true;
+			publishState();
+			m_interpreter.release(state);
 
 			return false;
 		}
@@ -556,7 +1985,7 @@ bool Python35Filter::reconfigure(const string& newConfig)
 		m_pythonScript = newScript;
 
 		// Import the new module
-		PyObject* newModule = PyImport_ImportModule(m_pythonScript.c_str());
+		PyObject* newModule = m_scriptCache.load(getFiltersPath(), m_pythonScript, NULL);
 
 		// Set reloaded module
 		m_pModule = newModule;
@@ -569,15 +1998,16 @@ bool Python35Filter::reconfigure(const string& newConfig)
 				category.getValue("enable").compare("True") == 0;
 	}
 
-	// Set encode/decode attribute names for compatibility
+	bool ret = configOnly ? checkColumnar() : this->configure();
+
+	// Set encode/decode attribute names for compatibility,
+	// configure() uses the configuration the filter started with
 	if (category.itemExists("encode_attribute_names"))
 	{
 		m_encode_names = category.getValue("encode_attribute_names").compare("true") == 0 ||
 				category.getValue("encode_attribute_names").compare("True") == 0;
 	}
 
-	bool ret = this->configure();
-
 	// Whole configuration as it is
 	string filterConfiguration;
 
@@ -641,6 +2071,10 @@ bool Python35Filter::reconfigure(const string& newConfig)
 				// Remove function object
 				Py_CLEAR(pConfigFunc);
 
+				m_failedScript = true;
+				publishState();
+				m_interpreter.release(state);
+
 				return false;
 			}
 			// Remove call object
@@ -658,7 +2092,31 @@ bool Python35Filter::reconfigure(const string& newConfig)
 		Py_CLEAR(pConfigFunc);
 	}
 
-	PyGILState_Release(state);
+	// The readings are processed with the new script, and the readings
+	// and datapoints it selects, from now on
+	configureAssets(category);
+	configureDatapoints(category);
+	publishState();
+
+	m_interpreter.release(state);
+
+	// Start the worker processes with the new script
+	if (ret)
+	{
+		configureWorkers(category);
+		configureParallel(category);
+		configureProfiler(category);
+		configureGC(category);
+		configureBudget(category);
+	}
+
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	m_logger->info("Filter %s has been reconfigured in %.1f ms, %s, "
+			"the readings were held for %.1f ms",
+			m_name.c_str(),
+			chrono::duration<double, milli>(end - start).count(),
+			configOnly ? "the script module was kept" : "the script module was loaded",
+			chrono::duration<double, milli>(end - locked).count());
 
 	return ret;
 }
@@ -710,6 +2168,7 @@ bool Python35Filter::configure()
 	{
 		m_pythonScript.replace(found, strlen(PYTHON_SCRIPT_FILENAME_EXTENSION), "");
 	}
+	m_filterMethod = filterMethod;
 	
 	m_logger->debug("%s filter: script='%s', method='%s'",
 				   this->getName().c_str(),
@@ -734,7 +2193,7 @@ bool Python35Filter::configure()
 	// 2) Import Python script if module object is not set
 	if (!m_pModule)
 	{
-		m_pModule = PyImport_ImportModule(m_pythonScript.c_str());
+		m_pModule = m_scriptCache.load(getFiltersPath(), m_pythonScript, NULL);
 	}
 
 	// Check whether the Python module has been imported
@@ -772,6 +2231,15 @@ bool Python35Filter::configure()
 		return false;
 	}
 
+	// Scripts written as generators are passed a stream of readings
+	m_streaming = PythonReadingStream::isGenerator(m_pFunc);
+
+	if (!checkColumnar())
+	{
+		// This will abort the filter pipeline set up
+		return false;
+	}
+
 	// Whole configuration as it is
 	string filterConfiguration;
 
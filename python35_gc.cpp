@@ -0,0 +1,402 @@
+/*
+ * Fledge "Python 3.5" filter control of the Python garbage collector.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <map>
+#include <mutex>
+#include <python35_gc.h>
+#include <python35_latency.h>
+
+// The interpreter the calling thread runs in
+#if PY_VERSION_HEX >= 0x03090000
+#define currentInterpreter()	PyInterpreterState_Get()
+#else
+#define currentInterpreter()	(PyThreadState_Get()->interp)
+#endif
+
+using namespace std;
+
+/**
+ * The sets of readings in progress that turned off the automatic
+ * collection of an interpreter, shared by the filters that run in it
+ */
+typedef struct {
+	unsigned long	batches;
+	// Automatic collection was on before the first of them
+	bool		enabled;
+} Suspension;
+
+static map<PyInterpreterState *, Suspension> suspensions;
+static mutex suspensionsMutex;
+
+PythonGC::PythonGC() : m_gc(NULL),
+		       m_callback(NULL),
+		       m_mode(AUTOMATIC),
+		       m_frozen(false),
+		       m_pending(-1),
+		       m_lastCollection(0),
+		       m_collected(0),
+		       m_pauseTotal(0),
+		       m_pauseMax(0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_collections[i].store(0);
+	}
+}
+
+/**
+ * Apply the configuration of the garbage collector, once the
+ * script has been loaded and configured
+ *
+ * @param mode		When collections are run
+ * @param interval	The interval between collections in seconds, SCHEDULED only
+ * @param freeze	Freeze the objects that exist once the script is configured
+ * @param monitor	Measure the collections
+ * @param isolated	The script runs in an interpreter of its own
+ * @return		False if the gc module is not available
+ */
+bool PythonGC::configure(Mode mode, unsigned long interval, bool freeze, bool monitor, bool isolated)
+{
+	if (!m_gc)
+	{
+		m_gc = PyImport_ImportModule("gc");
+		if (!m_gc)
+		{
+			PyErr_Clear();
+			return false;
+		}
+	}
+
+	m_mode = mode;
+	m_interval = chrono::seconds(interval);
+	m_pending.store(-1);
+	m_lastCollection.store(chrono::steady_clock::now().time_since_epoch().count());
+
+	// The objects of a previous script are released by the collection
+	if (m_frozen)
+	{
+		call("unfreeze");
+		m_frozen = false;
+	}
+	if (freeze)
+	{
+		if (!PyObject_HasAttrString(m_gc, "freeze"))
+		{
+			Logger::getLogger()->warn("The objects of the script can not be frozen, "
+					"Python 3.7 or later is required");
+		}
+		else if (!isolated)
+		{
+			// Freezing would also apply to the objects of the other filters
+			Logger::getLogger()->warn("The objects of the script can not be frozen, "
+					"an isolated interpreter is required");
+		}
+		else
+		{
+			m_frozen = call("collect") && call("freeze");
+		}
+	}
+
+	PyObject *callbacks = PyObject_GetAttrString(m_gc, "callbacks");
+	if (callbacks && PyList_Check(callbacks))
+	{
+		if (monitor && !m_callback)
+		{
+			// The self of the function is a capsule of this object
+			static PyMethodDef callbackDef = {
+				"filter_gc_callback",
+				PythonGC::callback,
+				METH_VARARGS,
+				NULL
+			};
+			PyObject *self = PyCapsule_New(this, NULL, NULL);
+			m_callback = self ? PyCFunction_New(&callbackDef, self) : NULL;
+			Py_XDECREF(self);
+			if (m_callback && PyList_Append(callbacks, m_callback) < 0)
+			{
+				Py_CLEAR(m_callback);
+			}
+		}
+		else if (!monitor && m_callback)
+		{
+			PyObject *removed = PyObject_CallMethod(callbacks, "remove", "O", m_callback);
+			Py_XDECREF(removed);
+			Py_CLEAR(m_callback);
+		}
+	}
+	Py_XDECREF(callbacks);
+	PyErr_Clear();
+	return true;
+}
+
+/**
+ * Turn off the automatic collection of the interpreter while
+ * the script processes a set of readings
+ *
+ * The automatic collection of an interpreter is turned off by the
+ * first set of readings in progress in it, whatever the filter, and
+ * restored to its previous state once the last one has ended.
+ *
+ * @return	True if endBatch() must turn automatic collection on again
+ */
+bool PythonGC::beginBatch()
+{
+	if (!m_gc || m_mode == AUTOMATIC)
+	{
+		return false;
+	}
+	lock_guard<mutex> guard(suspensionsMutex);
+	Suspension& suspension = suspensions[currentInterpreter()];
+	if (suspension.batches++ == 0)
+	{
+		PyObject *enabled = PyObject_CallMethod(m_gc, "isenabled", NULL);
+		suspension.enabled = enabled && PyObject_IsTrue(enabled) == 1;
+		Py_XDECREF(enabled);
+		PyErr_Clear();
+		if (suspension.enabled)
+		{
+			call("disable");
+		}
+	}
+	return true;
+}
+
+/**
+ * Restore the automatic collection turned off by beginBatch()
+ * and decide whether a collection is run before the next set
+ * of readings
+ *
+ * @param suspended	The value returned by beginBatch()
+ */
+void PythonGC::endBatch(bool suspended)
+{
+	if (suspended)
+	{
+		lock_guard<mutex> guard(suspensionsMutex);
+		map<PyInterpreterState *, Suspension>::iterator it = suspensions.find(currentInterpreter());
+		if (it != suspensions.end() && --it->second.batches == 0)
+		{
+			if (it->second.enabled)
+			{
+				call("enable");
+			}
+			suspensions.erase(it);
+		}
+	}
+
+	if (!m_gc || m_mode == AUTOMATIC || isPending())
+	{
+		return;
+	}
+	int generation = -1;
+	if (m_mode == SCHEDULED)
+	{
+		chrono::steady_clock::time_point last(chrono::steady_clock::duration(m_lastCollection.load()));
+		if (chrono::steady_clock::now() - last >= m_interval)
+		{
+			generation = 2;
+		}
+	}
+	else
+	{
+		generation = dueGeneration();
+	}
+	if (generation >= 0)
+	{
+		m_pending.store(generation);
+	}
+}
+
+/**
+ * Return the oldest generation whose count has reached its
+ * threshold, as Python would collect it, -1 if none
+ */
+int PythonGC::dueGeneration()
+{
+	PyObject *counts = PyObject_CallMethod(m_gc, "get_count", NULL);
+	PyObject *thresholds = PyObject_CallMethod(m_gc, "get_threshold", NULL);
+	int generation = -1;
+	if (counts && thresholds && PyTuple_Check(counts) && PyTuple_Check(thresholds))
+	{
+		Py_ssize_t size = min(PyTuple_Size(counts), PyTuple_Size(thresholds));
+		for (Py_ssize_t i = size - 1; i >= 0 && generation < 0; i--)
+		{
+			long count = PyLong_AsLong(PyTuple_GetItem(counts, i));
+			long threshold = PyLong_AsLong(PyTuple_GetItem(thresholds, i));
+			if (threshold > 0 && count > threshold)
+			{
+				generation = (int)i;
+			}
+		}
+	}
+	Py_XDECREF(counts);
+	Py_XDECREF(thresholds);
+	PyErr_Clear();
+	return generation;
+}
+
+/**
+ * Run the collection decided by endBatch(), if any
+ */
+void PythonGC::collect()
+{
+	int generation = m_pending.exchange(-1);
+	if (generation < 0 || !m_gc)
+	{
+		return;
+	}
+	PyObject *collected = PyObject_CallMethod(m_gc, "collect", "i", generation);
+	Py_XDECREF(collected);
+	PyErr_Clear();
+	if (generation == 2)
+	{
+		m_lastCollection.store(chrono::steady_clock::now().time_since_epoch().count());
+	}
+}
+
+/**
+ * Restore the garbage collector as it was before the filter
+ * was configured, the filter is shut down
+ */
+void PythonGC::clear()
+{
+	if (!m_gc)
+	{
+		return;
+	}
+	if (m_callback)
+	{
+		PyObject *callbacks = PyObject_GetAttrString(m_gc, "callbacks");
+		PyObject *removed = callbacks ? PyObject_CallMethod(callbacks, "remove", "O", m_callback) : NULL;
+		Py_XDECREF(removed);
+		Py_XDECREF(callbacks);
+		Py_CLEAR(m_callback);
+	}
+	if (m_frozen)
+	{
+		call("unfreeze");
+		m_frozen = false;
+	}
+	m_pending.store(-1);
+	PyErr_Clear();
+	Py_CLEAR(m_gc);
+}
+
+/**
+ * Log the number and time of the collections since the last report
+ *
+ * @param logger	The logger
+ * @param name		The name of the filter
+ */
+void PythonGC::report(Logger *logger, const string& name)
+{
+	uint64_t collections[3];
+	uint64_t total = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		collections[i] = m_collections[i].exchange(0);
+		total += collections[i];
+	}
+	uint64_t collected = m_collected.exchange(0);
+	uint64_t pause = m_pauseTotal.exchange(0);
+	uint64_t max = m_pauseMax.exchange(0);
+	if (!total)
+	{
+		return;
+	}
+	logger->info("Filter %s garbage collection: %lu collections (%lu/%lu/%lu by generation), "
+			"pause total %s, max %s, %lu objects collected",
+			name.c_str(),
+			(unsigned long)total,
+			(unsigned long)collections[0],
+			(unsigned long)collections[1],
+			(unsigned long)collections[2],
+			PythonLatency::format(pause).c_str(),
+			PythonLatency::format(max).c_str(),
+			(unsigned long)collected);
+}
+
+/**
+ * Call a function of the gc module without arguments
+ *
+ * @param method	The name of the function
+ * @return		True if the call succeeded
+ */
+bool PythonGC::call(const char *method)
+{
+	PyObject *result = PyObject_CallMethod(m_gc, method, NULL);
+	if (!result)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	Py_DECREF(result);
+	return true;
+}
+
+/**
+ * The function added to gc.callbacks, called by Python at the
+ * start and the end of each collection
+ *
+ * @param self	The capsule of the PythonGC
+ * @param args	The phase and the information of the collection
+ */
+PyObject *PythonGC::callback(PyObject *self, PyObject *args)
+{
+	PythonGC *gc = (PythonGC *)PyCapsule_GetPointer(self, NULL);
+	PyObject *phase, *info;
+	if (gc && PyArg_ParseTuple(args, "OO", &phase, &info))
+	{
+		gc->event(phase, info);
+	}
+	PyErr_Clear();
+	Py_RETURN_NONE;
+}
+
+/**
+ * Measure a collection
+ *
+ * @param phase	"start" or "stop"
+ * @param info	The generation collected and the number of objects collected
+ */
+void PythonGC::event(PyObject *phase, PyObject *info)
+{
+	if (!PyUnicode_Check(phase) || !PyDict_Check(info))
+	{
+		return;
+	}
+	if (PyUnicode_CompareWithASCIIString(phase, "start") == 0)
+	{
+		m_started = chrono::steady_clock::now();
+		return;
+	}
+	if (PyUnicode_CompareWithASCIIString(phase, "stop") != 0 ||
+	    m_started == chrono::steady_clock::time_point())
+	{
+		return;
+	}
+	int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_started).count();
+	uint64_t pause = elapsed > 0 ? elapsed : 0;
+	m_started = chrono::steady_clock::time_point();
+
+	PyObject *generation = PyDict_GetItemString(info, "generation");
+	long index = generation ? PyLong_AsLong(generation) : 0;
+	m_collections[index >= 0 && index < 3 ? index : 2]++;
+	PyObject *collected = PyDict_GetItemString(info, "collected");
+	if (collected)
+	{
+		long count = PyLong_AsLong(collected);
+		m_collected += count > 0 ? count : 0;
+	}
+
+	m_pauseTotal += pause;
+	uint64_t max = m_pauseMax.load();
+	while (pause > max && !m_pauseMax.compare_exchange_weak(max, pause))
+	{
+	}
+}
@@ -0,0 +1,318 @@
+/*
+ * Fledge "Python 3.5" filter interpreter handling.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <python35_interpreter.h>
+
+#if PY_VERSION_HEX >= 0x030D0000
+#define currentThreadState()	PyThreadState_GetUnchecked()
+#else
+#define currentThreadState()	_PyThreadState_UncheckedGet()
+#endif
+
+using namespace std;
+
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+namespace {
+
+/**
+ * The sub-interpreters that exist and the thread states
+ * created for them, by identifier of the interpreter
+ *
+ * No interpreter lock is held while the registry is locked, but a
+ * thread deleting its thread state takes the lock of the interpreter.
+ */
+struct Registry {
+	mutex		lock;
+	uint64_t	lastId;
+	map<uint64_t, set<PyThreadState *> >
+			interpreters;
+};
+
+/**
+ * Return the registry, which is never destroyed since
+ * threads may exit while the service exits
+ */
+Registry& registry()
+{
+	static Registry *shared = new Registry();
+	return *shared;
+}
+
+/**
+ * The thread states of a thread, one per sub-interpreter it
+ * has called into, deleted when the thread exits
+ */
+class ThreadStates
+{
+	public:
+		ThreadStates() {};
+		~ThreadStates();
+
+		map<uint64_t, PyThreadState *>	states;
+};
+
+thread_local ThreadStates threadStates;
+
+ThreadStates::~ThreadStates()
+{
+	Registry& shared = registry();
+	lock_guard<mutex> guard(shared.lock);
+	for (auto it = states.begin(); it != states.end(); ++it)
+	{
+		// The thread states of a destroyed interpreter are already deleted
+		auto interpreter = shared.interpreters.find(it->first);
+		if (interpreter == shared.interpreters.end() || !Py_IsInitialized())
+		{
+			continue;
+		}
+		interpreter->second.erase(it->second);
+		PyEval_RestoreThread(it->second);
+		PyThreadState_Clear(it->second);
+		PyThreadState_DeleteCurrent();
+	}
+	states.clear();
+}
+
+/**
+ * Create the thread state of the calling thread for a sub-interpreter
+ * and forget those of the interpreters destroyed since
+ *
+ * @param id		The identifier of the interpreter
+ * @param interp	The interpreter
+ * @return		The thread state
+ */
+PyThreadState *newThreadState(uint64_t id, PyInterpreterState *interp)
+{
+	Registry& shared = registry();
+	lock_guard<mutex> guard(shared.lock);
+	for (auto it = threadStates.states.begin(); it != threadStates.states.end(); )
+	{
+		if (shared.interpreters.count(it->first))
+		{
+			++it;
+		}
+		else
+		{
+			it = threadStates.states.erase(it);
+		}
+	}
+	PyThreadState *threadState = PyThreadState_New(interp);
+	shared.interpreters[id].insert(threadState);
+	threadStates.states[id] = threadState;
+	return threadState;
+}
+
+}
+#endif
+
+/**
+ * Return true if the Python runtime we are built against
+ * supports sub-interpreters with their own GIL
+ */
+bool PythonInterpreter::isolationSupported()
+{
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Return true if the Python runtime we are built against
+ * runs without a GIL
+ */
+bool PythonInterpreter::isFreeThreaded()
+{
+#ifdef PYTHON35_FREE_THREADED
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Create a sub-interpreter with its own GIL for the filter
+ *
+ * The Python runtime must have been initialised and the
+ * caller must not hold any interpreter lock.
+ *
+ * @return	True if the sub-interpreter has been created,
+ *		false if the shared interpreter must be used
+ */
+bool PythonInterpreter::create()
+{
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+	if (m_threadState)
+	{
+		return true;
+	}
+
+	PyGILState_STATE state = PyGILState_Ensure();
+
+	// Detach from the main interpreter before creating the new one
+	PyThreadState *mainState = PyThreadState_Swap(NULL);
+
+	PyInterpreterConfig config;
+	config.use_main_obmalloc = 0;
+	config.allow_fork = 0;
+	config.allow_exec = 0;
+	config.allow_threads = 1;
+	config.allow_daemon_threads = 0;
+	// Refuse extension modules that do not support sub-interpreters
+	config.check_multi_interp_extensions = 1;
+	config.gil = PyInterpreterConfig_OWN_GIL;
+
+	PyThreadState *threadState = NULL;
+	PyStatus status = Py_NewInterpreterFromConfig(&threadState, &config);
+	if (PyStatus_Exception(status) || !threadState)
+	{
+		PyThreadState_Swap(mainState);
+		PyGILState_Release(state);
+		return false;
+	}
+
+	// Release the new interpreter lock and return to the main interpreter
+	PyEval_SaveThread();
+	PyThreadState_Swap(mainState);
+	PyGILState_Release(state);
+
+	m_threadState = threadState;
+
+	Registry& shared = registry();
+	lock_guard<mutex> guard(shared.lock);
+	m_id = ++shared.lastId;
+	shared.interpreters[m_id];
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Destroy the filter sub-interpreter, if any.
+ *
+ * All the Python objects owned by the filter must have been
+ * released beforehand, no thread may be using the interpreter and
+ * the caller must not hold any interpreter lock. The thread states
+ * created for the threads that called into the interpreter are deleted.
+ */
+void PythonInterpreter::destroy()
+{
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+	if (!m_threadState)
+	{
+		return;
+	}
+
+	PyThreadState *savedState = currentThreadState();
+	if (savedState)
+	{
+		PyEval_SaveThread();
+	}
+
+	// The threads still running no longer delete their thread state
+	set<PyThreadState *> threads;
+	{
+		Registry& shared = registry();
+		lock_guard<mutex> guard(shared.lock);
+		threads.swap(shared.interpreters[m_id]);
+		shared.interpreters.erase(m_id);
+	}
+
+	PyEval_RestoreThread(m_threadState);
+	for (auto it = threads.begin(); it != threads.end(); ++it)
+	{
+		PyThreadState_Clear(*it);
+		PyThreadState_Delete(*it);
+	}
+	// No interpreter lock is held on return
+	Py_EndInterpreter(m_threadState);
+	m_threadState = NULL;
+
+	if (savedState)
+	{
+		PyEval_RestoreThread(savedState);
+	}
+#endif
+}
+
+/**
+ * Acquire the interpreter lock for the calling thread
+ *
+ * In shared mode this is the process wide GIL, with a sub-interpreter
+ * the lock of the sub-interpreter is taken with the thread state of
+ * the calling thread, created the first time the thread calls in.
+ *
+ * @return	The state to pass to release()
+ */
+PythonInterpreter::LockState PythonInterpreter::acquire()
+{
+	LockState state;
+	state.savedState = NULL;
+
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+	if (m_threadState)
+	{
+		// The caller may be a Python thread of the main interpreter
+		state.savedState = currentThreadState();
+		if (state.savedState)
+		{
+			PyEval_SaveThread();
+		}
+
+		auto it = threadStates.states.find(m_id);
+		PyThreadState *threadState = it != threadStates.states.end() ? it->second :
+				newThreadState(m_id, PyThreadState_GetInterpreter(m_threadState));
+		PyEval_RestoreThread(threadState);
+
+		state.gilState = PyGILState_UNLOCKED;
+		return state;
+	}
+#endif
+	state.gilState = PyGILState_Ensure();
+
+	return state;
+}
+
+/**
+ * Release the interpreter lock taken by acquire()
+ *
+ * @param state		The state returned by acquire()
+ */
+void PythonInterpreter::release(LockState& state)
+{
+#ifdef PYTHON35_ISOLATED_INTERPRETER
+	if (m_threadState)
+	{
+		// Attaching the thread state made it the one used by the PyGILState
+		// functions of the thread, which must not find it once the call is
+		// over. A thread state created for the purpose takes its place and
+		// is deleted, the thread state of the thread is kept for its next call.
+		// The placeholder can not be kept for the next release(), the
+		// PyGILState functions would find it once the call is over.
+		PyThreadState *threadState = PyThreadState_Get();
+		PyThreadState *unbind = PyThreadState_New(PyThreadState_GetInterpreter(threadState));
+		PyThreadState_Swap(unbind);
+		PyThreadState_Clear(unbind);
+		PyThreadState_DeleteCurrent();
+
+		if (state.savedState)
+		{
+			PyEval_RestoreThread(state.savedState);
+			state.savedState = NULL;
+		}
+		return;
+	}
+#endif
+	PyGILState_Release(state.gilState);
+}
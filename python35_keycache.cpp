@@ -0,0 +1,262 @@
+/*
+ * Fledge "Python 3.5" filter key object cache.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <vector>
+#include <python35_keycache.h>
+#include <python35_values.h>
+
+// Keys of the reading dict, as set by PythonReading::toPython(true, ...)
+#define READING_KEY		"reading"
+#define ASSET_CODE_KEY		"asset_code"
+#define ID_KEY			"id"
+#define TIMESTAMP_KEY		"timestamp"
+#define USER_TIMESTAMP_KEY	"user_timestamp"
+
+// Maximum number of cached datapoint or asset names
+#define MAX_CACHED_NAMES	4096
+
+using namespace std;
+
+/**
+ * Set whether datapoint names are bytes objects, the
+ * cached names are released if this changes
+ */
+void PythonKeyCache::setEncodeNames(bool encodeNames)
+{
+	if (encodeNames != m_encodeNames)
+	{
+		clear();
+		m_encodeNames = encodeNames;
+	}
+}
+
+/**
+ * Release the cached objects
+ */
+void PythonKeyCache::clear()
+{
+	Py_CLEAR(m_readingKey);
+	Py_CLEAR(m_assetKey);
+	Py_CLEAR(m_idKey);
+	Py_CLEAR(m_timestampKey);
+	Py_CLEAR(m_userTimestampKey);
+	for (unordered_map<string, PyObject *>::iterator it = m_names.begin(); it != m_names.end(); ++it)
+	{
+		Py_DECREF(it->second);
+	}
+	m_names.clear();
+	for (unordered_map<string, PyObject *>::iterator it = m_assets.begin(); it != m_assets.end(); ++it)
+	{
+		Py_DECREF(it->second);
+	}
+	m_assets.clear();
+}
+
+/**
+ * Return the object of a name, from the cache if possible
+ *
+ * @param cache	The cache of names
+ * @param name	The name
+ * @param bytes	Create a bytes object rather than a str object
+ * @return	New reference or NULL with a Python exception set
+ */
+PyObject *PythonKeyCache::find(unordered_map<string, PyObject *>& cache, const string& name, bool bytes)
+{
+	unordered_map<string, PyObject *>::const_iterator it = cache.find(name);
+	if (it != cache.end())
+	{
+		Py_INCREF(it->second);
+		return it->second;
+	}
+
+	PyObject *object = bytes ?
+		PyBytes_FromStringAndSize(name.c_str(), name.length()) :
+		PyUnicode_FromStringAndSize(name.c_str(), name.length());
+	if (!object || cache.size() >= MAX_CACHED_NAMES)
+	{
+		return object;
+	}
+	if (!bytes)
+	{
+		PyUnicode_InternInPlace(&object);
+	}
+	// The hash is kept by the object and not computed again by the dicts
+	if (PyObject_Hash(object) == -1)
+	{
+		PyErr_Clear();
+		return object;
+	}
+	Py_INCREF(object);
+	cache[name] = object;
+	return object;
+}
+
+/**
+ * Set the names of the datapoints converted by toPython()
+ *
+ * @param names	The datapoint names, none to convert all datapoints
+ */
+void PythonKeyCache::setProjection(const vector<string>& names)
+{
+	m_projection.clear();
+	m_projection.insert(names.begin(), names.end());
+}
+
+/**
+ * Copy the datapoints left out by the projection from one reading
+ * to another that does not have a datapoint of the same name
+ *
+ * @param from	The input reading
+ * @param to	A reading created from the dict of the input reading
+ */
+void PythonKeyCache::copyHidden(Reading *from, Reading *to) const
+{
+	const vector<Datapoint *>& points = from->getReadingData();
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const string& name = points[i]->getName();
+		if (!m_projection.count(name) && !to->getDatapoint(name))
+		{
+			to->addDatapoint(new Datapoint(name, points[i]->getData()));
+		}
+	}
+}
+
+/**
+ * Create the keys of the reading dict
+ *
+ * @return	False with a Python exception set if a key cannot be created
+ */
+bool PythonKeyCache::createKeys()
+{
+	if (m_readingKey)
+	{
+		return true;
+	}
+	m_readingKey = PyUnicode_InternFromString(READING_KEY);
+	m_assetKey = PyUnicode_InternFromString(ASSET_CODE_KEY);
+	m_idKey = PyUnicode_InternFromString(ID_KEY);
+	m_timestampKey = PyUnicode_InternFromString(TIMESTAMP_KEY);
+	m_userTimestampKey = PyUnicode_InternFromString(USER_TIMESTAMP_KEY);
+	if (!m_readingKey || !m_assetKey || !m_idKey || !m_timestampKey || !m_userTimestampKey)
+	{
+		Py_CLEAR(m_readingKey);
+		Py_CLEAR(m_assetKey);
+		Py_CLEAR(m_idKey);
+		Py_CLEAR(m_timestampKey);
+		Py_CLEAR(m_userTimestampKey);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Add an item to a dict, the reference to the value is stolen
+ *
+ * @param dict	The dict
+ * @param key	The key
+ * @param value	The value, NULL if its creation failed
+ * @return	False with a Python exception set if the item is not added
+ */
+static bool setItem(PyObject *dict, PyObject *key, PyObject *value)
+{
+	if (!value)
+	{
+		return false;
+	}
+	int ret = PyDict_SetItem(dict, key, value);
+	Py_DECREF(value);
+	return ret == 0;
+}
+
+/**
+ * Convert a reading to the dict passed to the script
+ *
+ * The dict has the items set by PythonReading::toPython(true, ...),
+ * its keys, the datapoint names and the asset name are the cached
+ * objects. The datapoints are converted by PythonValues, arrays,
+ * data buffers and images are passed as views if buffers are given.
+ *
+ * @param reading	The reading to convert
+ * @param projected	Only convert the datapoints of the projection
+ * @param buffers	Pass arrays, data buffers and images as views
+ *			of the datapoints, NULL to convert them to lists
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonKeyCache::toPython(Reading *reading, bool projected, PythonBuffers *buffers)
+{
+	projected = projected && !m_projection.empty();
+	if (!createKeys())
+	{
+		return NULL;
+	}
+
+	PyObject *datapoints = PyDict_New();
+	if (!datapoints)
+	{
+		return NULL;
+	}
+	const string& assetName = reading->getAssetName();
+	const vector<Datapoint *>& points = reading->getReadingData();
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const string& name = points[i]->getName();
+		if (projected && !m_projection.count(name))
+		{
+			continue;
+		}
+		DatapointValue& data = points[i]->getData();
+		PyObject *key = find(m_names, name, m_encodeNames);
+		if (!key)
+		{
+			Py_DECREF(datapoints);
+			return NULL;
+		}
+		PyObject *value;
+		if (data.getType() == DatapointValue::T_INTEGER)
+		{
+			value = PyLong_FromLong(data.toInt());
+		}
+		else if (data.getType() == DatapointValue::T_FLOAT)
+		{
+			value = PyFloat_FromDouble(data.toDouble());
+		}
+		else if (buffers && PythonBuffers::isBuffer(data))
+		{
+			value = buffers->create(reading, points[i]);
+		}
+		else
+		{
+			value = PythonValues::toPython(assetName, points[i], m_encodeNames);
+		}
+		bool added = setItem(datapoints, key, value);
+		Py_DECREF(key);
+		if (!added)
+		{
+			Py_DECREF(datapoints);
+			return NULL;
+		}
+	}
+
+	PyObject *dict = PyDict_New();
+	if (!dict)
+	{
+		Py_DECREF(datapoints);
+		return NULL;
+	}
+	if (!setItem(dict, m_readingKey, datapoints) ||
+	    !setItem(dict, m_assetKey, find(m_assets, assetName, false)) ||
+	    !setItem(dict, m_idKey, PyLong_FromUnsignedLong(reading->getId())) ||
+	    !setItem(dict, m_timestampKey, PyUnicode_FromString(reading->getAssetDateTime().c_str())) ||
+	    !setItem(dict, m_userTimestampKey, PyUnicode_FromString(reading->getAssetDateUserTime().c_str())))
+	{
+		Py_DECREF(dict);
+		return NULL;
+	}
+	return dict;
+}
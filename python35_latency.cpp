@@ -0,0 +1,225 @@
+/*
+ * Fledge "Python 3.5" filter latency histograms.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <python35_latency.h>
+
+using namespace std;
+
+// Names of the stages in the log
+static const char *stageNames[PythonLatency::STAGES] = {
+	"transforms",
+	"GIL",
+	"conversion",
+	"script",
+	"results",
+	"asset tracking",
+	"downstream"
+};
+
+PythonLatency::PythonLatency() : m_interval(0)
+{
+	for (int stage = 0; stage < STAGES; stage++)
+	{
+		for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+		{
+			m_counts[stage][i].store(0, memory_order_relaxed);
+		}
+		m_max[stage].store(0, memory_order_relaxed);
+	}
+}
+
+/**
+ * Set the reporting interval, 0 stops the measurements
+ *
+ * @param seconds	The interval between two reports
+ */
+void PythonLatency::setInterval(unsigned long seconds)
+{
+	lock_guard<mutex> guard(m_reportMutex);
+	if (seconds && !m_interval.load())
+	{
+		m_lastReport = chrono::steady_clock::now();
+	}
+	m_interval.store(seconds);
+}
+
+/**
+ * Record the time spent in a stage
+ *
+ * @param stage	The stage
+ * @param start	The time returned by start() when the stage began
+ */
+void PythonLatency::record(Stage stage, const TimePoint& start)
+{
+	if (start == TimePoint())
+	{
+		return;
+	}
+	int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+	uint64_t value = elapsed > 0 ? elapsed : 0;
+
+	m_counts[stage][bucket(value)].fetch_add(1, memory_order_relaxed);
+	uint64_t max = m_max[stage].load(memory_order_relaxed);
+	while (value > max && !m_max[stage].compare_exchange_weak(max, value, memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * Log the percentiles of each stage and reset the histograms
+ * if the reporting interval has elapsed
+ *
+ * @param logger	The logger
+ * @param name		The name of the filter
+ * @param force		Report even if the interval has not elapsed
+ * @return		True if the report was due
+ */
+bool PythonLatency::report(Logger *logger, const string& name, bool force)
+{
+	unsigned long interval = m_interval.load(memory_order_relaxed);
+	if (!interval)
+	{
+		return false;
+	}
+	unique_lock<mutex> guard(m_reportMutex, try_to_lock);
+	if (!guard.owns_lock())
+	{
+		// Another thread is reporting
+		return false;
+	}
+	TimePoint now = chrono::steady_clock::now();
+	if (!force && now - m_lastReport < chrono::seconds(interval))
+	{
+		return false;
+	}
+	m_lastReport = now;
+
+	string message;
+	uint64_t counts[LATENCY_BUCKETS];
+	for (int stage = 0; stage < STAGES; stage++)
+	{
+		uint64_t total = 0;
+		for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+		{
+			counts[i] = m_counts[stage][i].exchange(0, memory_order_relaxed);
+			total += counts[i];
+		}
+		uint64_t max = m_max[stage].exchange(0, memory_order_relaxed);
+		if (!total)
+		{
+			continue;
+		}
+		if (!message.empty())
+		{
+			message += ", ";
+		}
+		// The percentiles are the highest value of their bucket
+		uint64_t p50 = min(percentile(counts, total, 0.50), max);
+		uint64_t p99 = min(percentile(counts, total, 0.99), max);
+		message += string(stageNames[stage]) + " " +
+			format(p50) + "/" + format(p99) + "/" + format(max) +
+			" (" + to_string(total) + ")";
+	}
+
+	if (!message.empty())
+	{
+		logger->info("Filter %s stage latency p50/p99/max (count): %s",
+				name.c_str(), message.c_str());
+	}
+	return true;
+}
+
+/**
+ * Return the bucket of a value
+ *
+ * @param value	The value in nanoseconds
+ */
+size_t PythonLatency::bucket(uint64_t value)
+{
+	if (value < LATENCY_SUB_BUCKETS)
+	{
+		return value;
+	}
+	int msb = 63 - __builtin_clzll(value);
+	if (msb >= LATENCY_MAX_BITS)
+	{
+		return LATENCY_BUCKETS - 1;
+	}
+	return (msb - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS +
+		((value >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/**
+ * Return the highest value of a bucket
+ *
+ * @param index	The bucket
+ */
+uint64_t PythonLatency::bucketValue(size_t index)
+{
+	if (index < LATENCY_SUB_BUCKETS)
+	{
+		return index;
+	}
+	int shift = index / LATENCY_SUB_BUCKETS - 1;
+	uint64_t lowest = (uint64_t)(LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS) << shift;
+	return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * Return a percentile of a histogram
+ *
+ * @param counts	The counts of the buckets
+ * @param total		The sum of the counts
+ * @param fraction	The percentile, between 0 and 1
+ */
+uint64_t PythonLatency::percentile(const uint64_t *counts, uint64_t total, double fraction)
+{
+	uint64_t rank = (uint64_t)ceil(fraction * total);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			return bucketValue(i);
+		}
+	}
+	return bucketValue(LATENCY_BUCKETS - 1);
+}
+
+/**
+ * Format a time in nanoseconds with a suitable unit
+ */
+string PythonLatency::format(uint64_t value)
+{
+	char buffer[32];
+	if (value < 1000)
+	{
+		snprintf(buffer, sizeof(buffer), "%luns", (unsigned long)value);
+	}
+	else if (value < 1000000)
+	{
+		snprintf(buffer, sizeof(buffer), "%.1fus", value / 1e3);
+	}
+	else if (value < 1000000000)
+	{
+		snprintf(buffer, sizeof(buffer), "%.1fms", value / 1e6);
+	}
+	else
+	{
+		snprintf(buffer, sizeof(buffer), "%.2fs", value / 1e9);
+	}
+	return string(buffer);
+}
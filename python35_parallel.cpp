@@ -0,0 +1,535 @@
+/*
+ * Fledge "Python 3.5" filter parallel interpreters.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdexcept>
+#include <python35_parallel.h>
+#include <python35_buffers.h>
+
+// Filter configuration method
+#define DEFAULT_FILTER_CONFIG_METHOD "set_filter_config"
+
+using namespace std;
+
+PythonParallel::PythonParallel() : m_minReadings(0), m_encodeNames(true), m_running(false)
+{
+	m_logger = Logger::getLogger();
+}
+
+PythonParallel::~PythonParallel()
+{
+	stop();
+}
+
+/**
+ * Create the sub-interpreters and load the script in each of them
+ *
+ * The caller must not hold any interpreter lock.
+ *
+ * @param name		The name of the filter
+ * @param count		The number of interpreters
+ * @param minReadings	The smallest batch that is split
+ * @param scriptPath	The directory of the script
+ * @param module	The name of the script module
+ * @param method	The name of the script function
+ * @param config	The JSON configuration passed to set_filter_config
+ * @param encodeNames	Datapoint names are bytes objects
+ * @param projection	The names of the datapoints converted, empty for all
+ * @return		True if all the interpreters are ready
+ */
+bool PythonParallel::start(const string& name,
+			   int count,
+			   size_t minReadings,
+			   const string& scriptPath,
+			   const string& module,
+			   const string& method,
+			   const string& config,
+			   bool encodeNames,
+			   const vector<string>& projection)
+{
+	stop();
+
+	if (!PythonInterpreter::isolationSupported())
+	{
+		return false;
+	}
+
+	lock_guard<mutex> guard(m_mutex);
+	m_name = name;
+	m_minReadings = minReadings;
+	m_scriptPath = scriptPath;
+	m_module = module;
+	m_method = method;
+	m_config = config;
+	m_encodeNames = encodeNames;
+	m_projection = projection;
+
+	for (int i = 0; i < count; i++)
+	{
+		Lane *lane = new Lane();
+		lane->module = NULL;
+		lane->func = NULL;
+		lane->thread = NULL;
+		lane->busy = false;
+		lane->chunk = NULL;
+		lane->result = NULL;
+		lane->exit = false;
+		if (!startLane(lane))
+		{
+			stopLane(lane);
+			for (size_t n = 0; n < m_lanes.size(); n++)
+			{
+				stopLane(m_lanes[n]);
+			}
+			m_lanes.clear();
+			return false;
+		}
+		m_lanes.push_back(lane);
+	}
+
+	// The threads wait for chunks once the lock is released
+	for (size_t i = 0; i < m_lanes.size(); i++)
+	{
+		Lane *lane = m_lanes[i];
+		lane->thread = new thread(&PythonParallel::runLane, this, lane);
+	}
+	m_running = true;
+
+	m_logger->info("Filter %s started %d parallel Python interpreters", m_name.c_str(), count);
+	return true;
+}
+
+/**
+ * Stop the threads of the lanes, once the batches in progress are
+ * processed, and destroy the sub-interpreters
+ *
+ * The caller must not hold any interpreter lock.
+ */
+void PythonParallel::stop()
+{
+	vector<Lane *> lanes;
+	{
+		unique_lock<mutex> guard(m_mutex);
+		m_running = false;
+		m_cv.wait(guard, [this]() {
+			for (size_t i = 0; i < m_lanes.size(); i++)
+			{
+				if (m_lanes[i]->busy)
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+		lanes.swap(m_lanes);
+		for (size_t i = 0; i < lanes.size(); i++)
+		{
+			lanes[i]->exit = true;
+		}
+		m_cv.notify_all();
+	}
+
+	for (size_t i = 0; i < lanes.size(); i++)
+	{
+		stopLane(lanes[i]);
+	}
+}
+
+/**
+ * Return true if the sub-interpreters are ready to process readings
+ */
+bool PythonParallel::isRunning()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_running;
+}
+
+/**
+ * Create a sub-interpreter, load the script and pass it its configuration
+ *
+ * @param lane	The lane to start
+ * @return	True on success
+ */
+bool PythonParallel::startLane(Lane *lane)
+{
+	if (!lane->interpreter.create())
+	{
+		m_logger->warn("Filter %s is unable to create a Python interpreter with its own GIL",
+				m_name.c_str());
+		return false;
+	}
+
+	PythonInterpreter::LockState state = lane->interpreter.acquire();
+
+	// Each interpreter has its own sys.path
+	PyObject* sysPath = PySys_GetObject((char *)"path");
+	PyObject* pPath = PyUnicode_DecodeFSDefault(m_scriptPath.c_str());
+	if (sysPath && pPath)
+	{
+		PyList_Insert(sysPath, 0, pPath);
+	}
+	Py_CLEAR(pPath);
+
+	lane->keyCache.setEncodeNames(m_encodeNames);
+	lane->keyCache.setProjection(m_projection);
+
+	lane->module = lane->scriptCache.load(m_scriptPath, m_module, NULL);
+	if (lane->module)
+	{
+		lane->func = PyObject_GetAttrString(lane->module, m_method.c_str());
+	}
+	bool ret = lane->func && PyCallable_Check(lane->func);
+
+	PyObject* pConfigFunc = ret ? PyObject_GetAttrString(lane->module,
+							     DEFAULT_FILTER_CONFIG_METHOD) : NULL;
+	if (pConfigFunc && PyCallable_Check(pConfigFunc))
+	{
+		PyObject* pConfig = PyDict_New();
+		PyObject* pConfigObject = PyUnicode_DecodeFSDefault(m_config.c_str());
+		PyDict_SetItemString(pConfig, "config", pConfigObject);
+		Py_CLEAR(pConfigObject);
+
+		PyObject* pSetConfig = PyObject_CallFunctionObjArgs(pConfigFunc, pConfig, NULL);
+		ret = pSetConfig && PyBool_Check(pSetConfig) && PyLong_AsLong(pSetConfig);
+		Py_CLEAR(pSetConfig);
+		Py_CLEAR(pConfig);
+	}
+	else if (ret)
+	{
+		// The script has no configuration method
+		PyErr_Clear();
+	}
+	Py_CLEAR(pConfigFunc);
+
+	if (!ret)
+	{
+		// For example an extension module that does not support sub-interpreters
+		logError();
+	}
+
+	lane->interpreter.release(state);
+	return ret;
+}
+
+/**
+ * Wait for the thread of a lane, release the script
+ * of the lane and destroy its interpreter
+ *
+ * @param lane	The lane to stop, deleted
+ */
+void PythonParallel::stopLane(Lane *lane)
+{
+	if (lane->thread)
+	{
+		// The thread state of the thread is deleted as it exits
+		lane->thread->join();
+		delete lane->thread;
+	}
+	if (lane->interpreter.isIsolated())
+	{
+		PythonInterpreter::LockState state = lane->interpreter.acquire();
+		Py_CLEAR(lane->func);
+		Py_CLEAR(lane->module);
+		lane->keyCache.clear();
+		lane->scriptCache.clear();
+		lane->interpreter.release(state);
+
+		lane->interpreter.destroy();
+	}
+	delete lane;
+}
+
+/**
+ * Thread of a lane: run the script on the chunks given to the lane
+ * until the lane is stopped
+ *
+ * The thread keeps its thread state of the interpreter of the lane
+ * from one chunk to the next.
+ *
+ * @param lane	The lane
+ */
+void PythonParallel::runLane(Lane *lane)
+{
+	unique_lock<mutex> guard(m_mutex);
+	while (true)
+	{
+		m_cv.wait(guard, [lane]() { return lane->chunk || lane->exit; });
+		if (!lane->chunk)
+		{
+			break;
+		}
+		ReadingSet *chunk = lane->chunk;
+		guard.unlock();
+
+		vector<Reading *> *result = run(lane, chunk);
+
+		guard.lock();
+		lane->result = result;
+		lane->chunk = NULL;
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Run the script on a batch of readings, split between the interpreters
+ *
+ * Each chunk is processed by the thread of an idle lane while the
+ * calling thread waits. The lock of the lanes is only held to claim
+ * and release them, so concurrent batches run in different lanes.
+ * The caller must not hold any interpreter lock.
+ *
+ * @param readingSet	The readings to filter, deleted unless NULL is returned
+ * @return		The readings to pass on in the order of the chunks,
+ *			empty if the script failed on any chunk, or NULL if
+ *			the interpreters are not running, all the lanes are
+ *			used by other batches or the batch is too small to
+ *			be split
+ */
+ReadingSet *PythonParallel::process(ReadingSet *readingSet)
+{
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	vector<Lane *> lanes;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running || readings.empty() || readings.size() < m_minReadings)
+		{
+			return NULL;
+		}
+		for (size_t i = 0; i < m_lanes.size() && lanes.size() < readings.size(); i++)
+		{
+			if (!m_lanes[i]->busy)
+			{
+				m_lanes[i]->busy = true;
+				lanes.push_back(m_lanes[i]);
+			}
+		}
+	}
+	if (lanes.empty())
+	{
+		return NULL;
+	}
+
+	size_t count = lanes.size();
+	size_t perLane = (readings.size() + count - 1) / count;
+
+	// One contiguous chunk per lane, the chunks own the readings
+	vector<ReadingSet *> chunks;
+	for (size_t start = 0; start < readings.size(); start += perLane)
+	{
+		size_t end = min(start + perLane, readings.size());
+		vector<Reading *> *chunk = new vector<Reading *>(readings.begin() + start,
+								 readings.begin() + end);
+		chunks.push_back(new ReadingSet(chunk));
+		delete chunk;
+	}
+	readingSet->clear();
+	delete readingSet;
+
+	vector<vector<Reading *> *> results(chunks.size(), NULL);
+	{
+		unique_lock<mutex> guard(m_mutex);
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			lanes[i]->result = NULL;
+			lanes[i]->chunk = chunks[i];
+		}
+		m_cv.notify_all();
+
+		m_cv.wait(guard, [&lanes, &chunks]() {
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				if (lanes[i]->chunk)
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+
+		for (size_t i = 0; i < lanes.size(); i++)
+		{
+			if (i < chunks.size())
+			{
+				results[i] = lanes[i]->result;
+				lanes[i]->result = NULL;
+			}
+			lanes[i]->busy = false;
+		}
+		m_cv.notify_all();
+	}
+
+	bool failed = false;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		failed = failed || !results[i];
+	}
+
+	vector<Reading *> *merged = new vector<Reading *>;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (!results[i])
+		{
+			continue;
+		}
+		for (size_t r = 0; r < results[i]->size(); r++)
+		{
+			if (failed)
+			{
+				delete (*results[i])[r];
+			}
+			else
+			{
+				merged->push_back((*results[i])[r]);
+			}
+		}
+		delete results[i];
+	}
+
+	ReadingSet *finalData = new ReadingSet(merged);
+	delete merged;
+	return finalData;
+}
+
+/**
+ * Run the script on a chunk of readings in the interpreter of a lane
+ *
+ * @param lane		The lane
+ * @param chunk		The readings, deleted
+ * @return		The readings returned by the script, NULL on failure
+ */
+vector<Reading *> *PythonParallel::run(Lane *lane, ReadingSet *chunk)
+{
+	PythonInterpreter::LockState state = lane->interpreter.acquire();
+
+	PythonWriteBack writeBack;
+	const vector<Reading *>& readings = chunk->getAllReadings();
+	PyObject* readingsList = PyList_New(0);
+	for (size_t i = 0; readingsList && i < readings.size(); i++)
+	{
+		PyObject* item = lane->keyCache.toPython(readings[i], true);
+		if (!item)
+		{
+			Py_CLEAR(readingsList);
+			break;
+		}
+		writeBack.track(readings[i], item);
+		PyList_Append(readingsList, item);
+		Py_DECREF(item);
+	}
+
+	vector<Reading *> *newReadings = NULL;
+	if (!readingsList)
+	{
+		m_logger->error("Internal error in the filter %s, unable to create data to be sent to the Python filter function", m_name.c_str());
+		PyErr_Clear();
+	}
+	else
+	{
+		PyObject* pReturn = PyObject_CallFunctionObjArgs(lane->func, readingsList, NULL);
+		if (!pReturn)
+		{
+			logError();
+		}
+		else
+		{
+			newReadings = getReadings(lane, writeBack, pReturn);
+			Py_CLEAR(pReturn);
+		}
+		Py_CLEAR(readingsList);
+	}
+
+	// Delete the input readings that are not passed on
+	writeBack.release(chunk);
+
+	lane->interpreter.release(state);
+	return newReadings;
+}
+
+/**
+ * Convert the list returned by the script in a lane to readings
+ *
+ * @param lane		The lane
+ * @param writeBack	The dicts passed to the script
+ * @param result	The object returned by the script
+ * @return		The readings, NULL on failure
+ */
+vector<Reading *> *PythonParallel::getReadings(Lane *lane,
+					       PythonWriteBack& writeBack,
+					       PyObject *result)
+{
+	vector<Reading *> *newReadings = new vector<Reading *>();
+	if (result == Py_None)
+	{
+		return newReadings;
+	}
+	if (!PyList_Check(result))
+	{
+		m_logger->error("The return type of the python35 filter function should be a list of readings.");
+		delete newReadings;
+		return NULL;
+	}
+
+	newReadings->reserve(PyList_Size(result));
+	for (Py_ssize_t i = 0; i < PyList_Size(result); i++)
+	{
+		PyObject* element = PyList_GetItem(result, i);
+		if (!element || !PyDict_Check(element))
+		{
+			m_logger->error("Each element returned by the script must be a Python DICT");
+			writeBack.discard(newReadings);
+			delete newReadings;
+			return NULL;
+		}
+		try {
+			Reading *reading = writeBack.reuse(element);
+			if (!reading)
+			{
+				reading = PythonBuffers::toReading(element);
+
+				// Keep the datapoints that were not passed to the script
+				Reading *original = writeBack.getReading(element);
+				if (reading && original && lane->keyCache.isProjected())
+				{
+					lane->keyCache.copyHidden(original, reading);
+				}
+			}
+			if (reading)
+			{
+				newReadings->push_back(reading);
+			}
+		} catch (exception &e) {
+			m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
+			writeBack.discard(newReadings);
+			delete newReadings;
+			return NULL;
+		}
+	}
+	return newReadings;
+}
+
+/**
+ * Log and clear the Python error of the calling thread, if any
+ */
+void PythonParallel::logError()
+{
+	if (!PyErr_Occurred())
+	{
+		return;
+	}
+	PyObject *ptype, *pvalue, *ptraceback;
+	PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+	PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+	PyObject *pstr = pvalue ? PyObject_Repr(pvalue) : NULL;
+	const char *msg = pstr ? PyUnicode_AsUTF8(pstr) : NULL;
+	m_logger->error("Python error in parallel interpreter of filter %s: %s",
+			m_name.c_str(), msg ? msg : "unknown error");
+	Py_CLEAR(pstr);
+	Py_CLEAR(ptype);
+	Py_CLEAR(pvalue);
+	Py_CLEAR(ptraceback);
+	PyErr_Clear();
+}
@@ -0,0 +1,335 @@
+/*
+ * Fledge "Python 3.5" filter script profiler.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <python35_profiler.h>
+
+#include <frameobject.h>
+
+// Interval between two samples
+#define SAMPLE_INTERVAL_MS	10
+// Number of functions and lines in the report
+#define REPORT_TOP		30
+
+// Frame accessors, the frame structures are opaque from Python 3.11
+#if PY_VERSION_HEX >= 0x03090000
+#define threadFrame(tstate)	PyThreadState_GetFrame(tstate)
+#define frameCode(frame)	PyFrame_GetCode(frame)
+#define frameBack(frame)	PyFrame_GetBack(frame)
+#else
+static PyFrameObject *threadFrame(PyThreadState *tstate)
+{
+	Py_XINCREF(tstate->frame);
+	return tstate->frame;
+}
+static PyCodeObject *frameCode(PyFrameObject *frame)
+{
+	Py_INCREF(frame->f_code);
+	return frame->f_code;
+}
+static PyFrameObject *frameBack(PyFrameObject *frame)
+{
+	Py_XINCREF(frame->f_back);
+	return frame->f_back;
+}
+#endif
+
+using namespace std;
+
+PythonProfiler::PythonProfiler() : m_interpreter(NULL),
+				   m_thread(NULL),
+				   m_active(false),
+				   m_stop(false),
+				   m_done(false),
+				   m_maxCalls(0),
+				   m_calls(0),
+				   m_samples(0),
+				   m_native(0)
+{
+	m_logger = Logger::getLogger();
+}
+
+PythonProfiler::~PythonProfiler()
+{
+	stop();
+}
+
+/**
+ * Start a profiling window, the window in progress if any is stopped
+ *
+ * The caller must not hold the interpreter lock.
+ *
+ * @param interpreter	The interpreter the script runs in
+ * @param name		The name of the filter
+ * @param reportPath	The file the report is written to
+ * @param duration	The length of the window in seconds
+ * @param calls		The maximum number of calls of the script, 0 for no limit
+ * @return		True if the profiler has started
+ */
+bool PythonProfiler::start(PythonInterpreter *interpreter,
+			   const string& name,
+			   const string& reportPath,
+			   unsigned long duration,
+			   unsigned long calls)
+{
+	stop();
+
+	m_interpreter = interpreter;
+	m_name = name;
+	m_reportPath = reportPath;
+	m_maxCalls = calls;
+	m_stop = false;
+	m_done = false;
+	m_calls = 0;
+	m_samples = 0;
+	m_native = 0;
+	m_functions.clear();
+	m_lines.clear();
+	m_start = chrono::steady_clock::now();
+	m_end = m_start + chrono::seconds(duration);
+
+	m_active = true;
+	m_thread = new thread(&PythonProfiler::sampler, this);
+
+	m_logger->info("Filter %s is profiling its script for %lu seconds", m_name.c_str(), duration);
+	return true;
+}
+
+/**
+ * End the profiling window in progress, if any, and
+ * wait for the report to be written
+ *
+ * The caller must not hold the interpreter lock.
+ */
+void PythonProfiler::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+}
+
+/**
+ * Mark the start of a call of the script by the calling thread,
+ * the interpreter lock must be held
+ */
+void PythonProfiler::enter()
+{
+	if (m_active)
+	{
+		m_targets.insert(PyThreadState_Get());
+	}
+}
+
+/**
+ * Mark the end of a call of the script by the calling thread,
+ * the interpreter lock must be held
+ *
+ * Only the call of the calling thread is removed, the calls
+ * of the other threads are still sampled.
+ */
+void PythonProfiler::leave()
+{
+	unordered_multiset<PyThreadState *>::iterator it = m_targets.find(PyThreadState_Get());
+	if (it != m_targets.end())
+	{
+		m_targets.erase(it);
+	}
+	if (m_active)
+	{
+		called();
+	}
+}
+
+/**
+ * Count a call of the script, the window ends
+ * when the maximum number of calls is reached
+ */
+void PythonProfiler::called()
+{
+	if (++m_calls == m_maxCalls)
+	{
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_done = true;
+		}
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * The profiler thread, samples the script until the end of the window
+ */
+void PythonProfiler::sampler()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (!m_stop && !m_done)
+	{
+		chrono::steady_clock::time_point next = chrono::steady_clock::now() +
+							chrono::milliseconds(SAMPLE_INTERVAL_MS);
+		if (next >= m_end)
+		{
+			break;
+		}
+		if (m_cv.wait_until(lck, next, [this]{ return m_stop || m_done; }))
+		{
+			break;
+		}
+
+		lck.unlock();
+		PythonInterpreter::LockState state = m_interpreter->acquire();
+		sample();
+		m_interpreter->release(state);
+		lck.lock();
+	}
+	lck.unlock();
+
+	m_active = false;
+	writeReport();
+}
+
+/**
+ * Record the stack of each call of the script, the interpreter lock is held
+ */
+void PythonProfiler::sample()
+{
+	for (unordered_multiset<PyThreadState *>::const_iterator it = m_targets.begin();
+								 it != m_targets.end();
+								 ++it)
+	{
+		sample(*it);
+	}
+}
+
+/**
+ * Record the stack of a call of the script, the interpreter lock is held
+ *
+ * @param target	The thread state running the call
+ */
+void PythonProfiler::sample(PyThreadState *target)
+{
+	m_samples++;
+	PyFrameObject *frame = threadFrame(target);
+	if (!frame)
+	{
+		m_native++;
+		return;
+	}
+
+	// Functions and lines are counted once per sample, whatever the recursion
+	unordered_set<string> functions;
+	unordered_set<string> lines;
+	bool top = true;
+	while (frame)
+	{
+		PyCodeObject *code = frameCode(frame);
+		const char *file = PyUnicode_Check(code->co_filename) ? PyUnicode_AsUTF8(code->co_filename) : NULL;
+		const char *func = PyUnicode_Check(code->co_name) ? PyUnicode_AsUTF8(code->co_name) : NULL;
+		if (!file || !func)
+		{
+			PyErr_Clear();
+		}
+		string function = string(func ? func : "?") + " (" + (file ? file : "?") + ":" +
+				  to_string(code->co_firstlineno) + ")";
+		string line = string(file ? file : "?") + ":" + to_string(PyFrame_GetLineNumber(frame)) +
+			      " (" + (func ? func : "?") + ")";
+		Py_DECREF(code);
+
+		if (functions.insert(function).second)
+		{
+			m_functions[function].cumulative++;
+		}
+		if (lines.insert(line).second)
+		{
+			m_lines[line].cumulative++;
+		}
+		if (top)
+		{
+			m_functions[function].self++;
+			m_lines[line].self++;
+			top = false;
+		}
+
+		PyFrameObject *back = frameBack(frame);
+		Py_DECREF(frame);
+		frame = back;
+	}
+}
+
+/**
+ * Write the functions or lines with the most samples
+ *
+ * @param fp		The report file
+ * @param title		The title of the table
+ * @param counts	The samples of each function or line
+ * @param samples	The total number of samples
+ */
+void PythonProfiler::writeTop(FILE *fp, const char *title, const Counts& counts, unsigned long samples)
+{
+	vector<pair<string, Count> > sorted(counts.begin(), counts.end());
+	sort(sorted.begin(), sorted.end(),
+	     [](const pair<string, Count>& a, const pair<string, Count>& b) {
+		return a.second.cumulative != b.second.cumulative ?
+			a.second.cumulative > b.second.cumulative :
+			a.second.self > b.second.self;
+	});
+
+	fprintf(fp, "\n%s by cumulative samples\n\n", title);
+	fprintf(fp, "%17s %17s\n", "cumulative", "self");
+	for (size_t i = 0; i < sorted.size() && i < REPORT_TOP; i++)
+	{
+		const Count& count = sorted[i].second;
+		fprintf(fp, "%9lu %6.2f%% %9lu %6.2f%%  %s\n",
+			count.cumulative, 100.0 * count.cumulative / samples,
+			count.self, 100.0 * count.self / samples,
+			sorted[i].first.c_str());
+	}
+}
+
+/**
+ * Write the report of the profiling window
+ */
+void PythonProfiler::writeReport()
+{
+	FILE *fp = fopen(m_reportPath.c_str(), "w");
+	if (!fp)
+	{
+		m_logger->error("Filter %s is unable to write the profile of its script to %s",
+				m_name.c_str(), m_reportPath.c_str());
+		return;
+	}
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+	fprintf(fp, "Profile of the script of filter %s\n\n", m_name.c_str());
+	fprintf(fp, "%lu calls of the script in %.1f seconds%s\n",
+		m_calls.load(), elapsed, m_stop ? ", stopped before the end of the window" : "");
+	fprintf(fp, "%lu samples at %d ms intervals while the script was running, "
+		"%lu outside of Python code\n",
+		m_samples, SAMPLE_INTERVAL_MS, m_native);
+
+	if (m_samples)
+	{
+		writeTop(fp, "Functions", m_functions, m_samples);
+		writeTop(fp, "Lines", m_lines, m_samples);
+	}
+	fclose(fp);
+
+	m_logger->info("Filter %s has written the profile of its script to %s",
+			m_name.c_str(), m_reportPath.c_str());
+}
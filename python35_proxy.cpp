@@ -0,0 +1,1243 @@
+/*
+ * Fledge "Python 3.5" filter lazy reading objects.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <pythonreading.h>
+#include <python35_proxy.h>
+#include <python35_writeback.h>
+#include <python35_values.h>
+
+// Keys of the reading dict, as set by PythonReading::toPython(true, ...)
+#define READING_KEY	"reading"
+#define ASSET_CODE_KEY	"asset_code"
+
+using namespace std;
+
+/**
+ * The 'reading' item of a reading proxy: datapoint names and values.
+ *
+ * Datapoints that have not been accessed yet are pending, they are
+ * converted and moved to the items dict the first time they are used.
+ */
+typedef struct {
+	PyObject_HEAD
+	// The C++ reading, NULL once detached
+	Reading		*reading;
+	// Datapoints of the C++ reading
+	Datapoint	**points;
+	Py_ssize_t	count;
+	// Datapoints not yet converted, same index as points
+	char		*pending;
+	Py_ssize_t	pendingCount;
+	// Index of the last datapoint found
+	Py_ssize_t	hint;
+	// Datapoint names are bytes objects
+	bool		encodeNames;
+	// Creates views of the arrays, NULL to convert them
+	PythonBuffers	*buffers;
+	// Converted and assigned items
+	PyObject	*items;
+	// Keys assigned by the script, NULL until the first assignment
+	PyObject	*assigned;
+} DatapointsObject;
+
+/**
+ * A reading proxy: 'asset_code', 'reading' and the other items
+ * of the dict normally built by PythonReading::toPython().
+ */
+typedef struct {
+	PyObject_HEAD
+	// The C++ reading, NULL once detached
+	Reading		*reading;
+	// The DatapointsObject of this reading
+	PyObject	*datapoints;
+	// Converted and assigned items
+	PyObject	*items;
+	// Items not yet added to the items dict
+	bool		readingPending;
+	bool		assetPending;
+	bool		extrasPending;
+} ReadingObject;
+
+/**
+ * Check whether a key is the given string key
+ */
+static bool isKey(PyObject *key, const char *name)
+{
+	return PyUnicode_Check(key) && PyUnicode_CompareWithASCIIString(key, name) == 0;
+}
+
+/**
+ * Convert a single datapoint to a Python object
+ *
+ * Views of arrays are created here, all the other types are converted
+ * as PythonReading::toPython() does so that they are identical to what
+ * a script gets without proxies.
+ *
+ * @param reading	The reading the datapoint belongs to
+ * @param dp		The datapoint to convert
+ * @param encodeNames	Use bytes objects for names and strings
+ * @param buffers	Creates views of arrays, NULL to convert them
+ * @return		New reference or NULL with a Python exception set
+ */
+static PyObject *convertDatapoint(Reading *reading,
+				  Datapoint *dp,
+				  bool encodeNames,
+				  PythonBuffers *buffers)
+{
+	DatapointValue& data = dp->getData();
+
+	switch (data.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			return PyLong_FromLong(data.toInt());
+		case DatapointValue::T_FLOAT:
+			return PyFloat_FromDouble(data.toDouble());
+		default:
+			if (buffers && PythonBuffers::isBuffer(data))
+			{
+				return buffers->create(reading, dp);
+			}
+			break;
+	}
+
+	return PythonValues::toPython(reading->getAssetName(), dp, encodeNames);
+}
+
+/*
+ * Datapoints object
+ */
+
+/**
+ * Create the key object of a datapoint name
+ */
+static PyObject *datapointKey(DatapointsObject *self, const string& name)
+{
+	if (self->encodeNames)
+	{
+		return PyBytes_FromStringAndSize(name.c_str(), name.length());
+	}
+	return PyUnicode_FromStringAndSize(name.c_str(), name.length());
+}
+
+/**
+ * Find a pending datapoint by key
+ *
+ * @return	The datapoint index or -1 if not found
+ */
+static Py_ssize_t findPending(DatapointsObject *self, PyObject *key)
+{
+	if (self->pendingCount == 0)
+	{
+		return -1;
+	}
+
+	const char *name;
+	Py_ssize_t len;
+	if (self->encodeNames)
+	{
+		if (!PyBytes_Check(key))
+		{
+			return -1;
+		}
+		name = PyBytes_AS_STRING(key);
+		len = PyBytes_GET_SIZE(key);
+	}
+	else
+	{
+		if (!PyUnicode_Check(key))
+		{
+			return -1;
+		}
+		name = PyUnicode_AsUTF8AndSize(key, &len);
+		if (!name)
+		{
+			PyErr_Clear();
+			return -1;
+		}
+	}
+
+	// Datapoints are usually accessed in order, start after the last one found
+	for (Py_ssize_t n = 0; n < self->count; n++)
+	{
+		Py_ssize_t i = (self->hint + n) % self->count;
+		if (self->pending[i])
+		{
+			const string dpName = self->points[i]->getName();
+			if ((Py_ssize_t)dpName.length() == len && memcmp(dpName.c_str(), name, len) == 0)
+			{
+				self->hint = i + 1;
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+/**
+ * Convert a pending datapoint and move it to the items dict
+ *
+ * @return	New reference to the value or NULL on error
+ */
+static PyObject *realizeDatapoint(DatapointsObject *self, Py_ssize_t index, PyObject *key)
+{
+	PyObject *value = convertDatapoint(self->reading,
+					   self->points[index],
+					   self->encodeNames,
+					   self->buffers);
+	if (!value)
+	{
+		return NULL;
+	}
+	if (PyDict_SetItem(self->items, key, value) < 0)
+	{
+		Py_DECREF(value);
+		return NULL;
+	}
+	self->pending[index] = 0;
+	self->pendingCount--;
+	return value;
+}
+
+/**
+ * Return the datapoint keys, in datapoint order followed by added keys
+ */
+static PyObject *datapointsKeys(DatapointsObject *self, PyObject *unused = NULL)
+{
+	PyObject *keys = PyList_New(0);
+	if (!keys)
+	{
+		return NULL;
+	}
+
+	PyObject *seen = NULL;
+	for (Py_ssize_t i = 0; i < self->count && self->points; i++)
+	{
+		PyObject *key = datapointKey(self, self->points[i]->getName());
+		if (!key)
+		{
+			Py_XDECREF(seen);
+			Py_DECREF(keys);
+			return NULL;
+		}
+		if (self->pending[i] || PyDict_Contains(self->items, key) == 1)
+		{
+			if (!seen)
+			{
+				seen = PySet_New(NULL);
+			}
+			PyList_Append(keys, key);
+			PySet_Add(seen, key);
+		}
+		Py_DECREF(key);
+	}
+
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(self->items, &pos, &key, &value))
+	{
+		if (!seen || PySet_Contains(seen, key) != 1)
+		{
+			PyList_Append(keys, key);
+		}
+	}
+	Py_XDECREF(seen);
+
+	return keys;
+}
+
+static PyObject *datapointsGetItem(DatapointsObject *self, PyObject *key)
+{
+	PyObject *value = PyDict_GetItemWithError(self->items, key);
+	if (value)
+	{
+		Py_INCREF(value);
+		return value;
+	}
+	if (PyErr_Occurred())
+	{
+		return NULL;
+	}
+
+	Py_ssize_t index = findPending(self, key);
+	if (index < 0)
+	{
+		PyErr_SetObject(PyExc_KeyError, key);
+		return NULL;
+	}
+	return realizeDatapoint(self, index, key);
+}
+
+static int datapointsSetItem(DatapointsObject *self, PyObject *key, PyObject *value)
+{
+	Py_ssize_t index = findPending(self, key);
+	if (index >= 0)
+	{
+		// Assigned or deleted before being read
+		self->pending[index] = 0;
+		self->pendingCount--;
+	}
+
+	if (!value)
+	{
+		if (index >= 0)
+		{
+			return 0;
+		}
+		if (self->assigned)
+		{
+			PySet_Discard(self->assigned, key);
+		}
+		return PyDict_DelItem(self->items, key);
+	}
+
+	if (!self->assigned)
+	{
+		self->assigned = PySet_New(NULL);
+		if (!self->assigned)
+		{
+			return -1;
+		}
+	}
+	if (PySet_Add(self->assigned, key) < 0)
+	{
+		return -1;
+	}
+	return PyDict_SetItem(self->items, key, value);
+}
+
+static Py_ssize_t datapointsLength(DatapointsObject *self)
+{
+	return self->pendingCount + PyDict_Size(self->items);
+}
+
+static int datapointsContains(DatapointsObject *self, PyObject *key)
+{
+	int ret = PyDict_Contains(self->items, key);
+	if (ret != 0)
+	{
+		return ret;
+	}
+	return findPending(self, key) >= 0;
+}
+
+static PyObject *datapointsIter(DatapointsObject *self)
+{
+	PyObject *keys = datapointsKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *iter = PyObject_GetIter(keys);
+	Py_DECREF(keys);
+	return iter;
+}
+
+/**
+ * Return a dict with all the datapoints, converting the pending ones
+ */
+static PyObject *datapointsCopy(DatapointsObject *self, PyObject *unused = NULL)
+{
+	PyObject *keys = datapointsKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *dict = PyDict_New();
+	for (Py_ssize_t i = 0; dict && i < PyList_GET_SIZE(keys); i++)
+	{
+		PyObject *key = PyList_GET_ITEM(keys, i);
+		PyObject *value = datapointsGetItem(self, key);
+		if (!value || PyDict_SetItem(dict, key, value) < 0)
+		{
+			Py_CLEAR(dict);
+		}
+		Py_XDECREF(value);
+	}
+	Py_DECREF(keys);
+	return dict;
+}
+
+static PyObject *datapointsItems(DatapointsObject *self, PyObject *unused)
+{
+	PyObject *dict = datapointsCopy(self);
+	if (!dict)
+	{
+		return NULL;
+	}
+	PyObject *items = PyDict_Items(dict);
+	Py_DECREF(dict);
+	return items;
+}
+
+static PyObject *datapointsValues(DatapointsObject *self, PyObject *unused)
+{
+	PyObject *dict = datapointsCopy(self);
+	if (!dict)
+	{
+		return NULL;
+	}
+	PyObject *values = PyDict_Values(dict);
+	Py_DECREF(dict);
+	return values;
+}
+
+static PyObject *datapointsGet(DatapointsObject *self, PyObject *args)
+{
+	PyObject *key, *def = Py_None;
+	if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &def))
+	{
+		return NULL;
+	}
+	PyObject *value = datapointsGetItem(self, key);
+	if (!value && PyErr_ExceptionMatches(PyExc_KeyError))
+	{
+		PyErr_Clear();
+		Py_INCREF(def);
+		return def;
+	}
+	return value;
+}
+
+static PyObject *datapointsPop(DatapointsObject *self, PyObject *args)
+{
+	PyObject *key, *def = NULL;
+	if (!PyArg_UnpackTuple(args, "pop", 1, 2, &key, &def))
+	{
+		return NULL;
+	}
+	PyObject *value = datapointsGetItem(self, key);
+	if (!value)
+	{
+		if (def && PyErr_ExceptionMatches(PyExc_KeyError))
+		{
+			PyErr_Clear();
+			Py_INCREF(def);
+			return def;
+		}
+		return NULL;
+	}
+	if (datapointsSetItem(self, key, NULL) < 0)
+	{
+		Py_DECREF(value);
+		return NULL;
+	}
+	return value;
+}
+
+static PyObject *datapointsRepr(DatapointsObject *self)
+{
+	PyObject *dict = datapointsCopy(self);
+	if (!dict)
+	{
+		return NULL;
+	}
+	PyObject *repr = PyObject_Repr(dict);
+	Py_DECREF(dict);
+	return repr;
+}
+
+/**
+ * Convert all the pending datapoints and drop the C++ reading
+ */
+static int datapointsDetach(DatapointsObject *self, bool keep)
+{
+	int ret = 0;
+	// The views are released with the call, the kept items are converted
+	self->buffers = NULL;
+	if (keep && self->reading)
+	{
+		PyObject *dict = datapointsCopy(self);
+		if (dict)
+		{
+			Py_SETREF(self->items, dict);
+		}
+		else
+		{
+			ret = -1;
+		}
+	}
+	self->reading = NULL;
+	self->count = 0;
+	self->pendingCount = 0;
+	PyMem_Free(self->points);
+	self->points = NULL;
+	PyMem_Free(self->pending);
+	self->pending = NULL;
+	return ret;
+}
+
+static int datapointsTraverse(DatapointsObject *self, visitproc visit, void *arg)
+{
+	Py_VISIT(self->items);
+	Py_VISIT(self->assigned);
+	Py_VISIT(Py_TYPE(self));
+	return 0;
+}
+
+static int datapointsClear(DatapointsObject *self)
+{
+	Py_CLEAR(self->items);
+	Py_CLEAR(self->assigned);
+	return 0;
+}
+
+static void datapointsDealloc(DatapointsObject *self)
+{
+	PyTypeObject *type = Py_TYPE(self);
+	PyObject_GC_UnTrack(self);
+	datapointsClear(self);
+	PyMem_Free(self->points);
+	PyMem_Free(self->pending);
+	type->tp_free((PyObject *)self);
+	Py_DECREF(type);
+}
+
+/*
+ * Reading object
+ */
+
+/**
+ * Add the items of the reading other than the asset code and
+ * datapoints, e.g. the timestamps, exactly as toPython() sets them
+ */
+static int realizeExtras(ReadingObject *self)
+{
+	if (!self->extrasPending)
+	{
+		return 0;
+	}
+	self->extrasPending = false;
+	if (!self->reading)
+	{
+		return 0;
+	}
+
+	Reading empty(self->reading->getAssetName(), vector<Datapoint *>());
+	struct timeval tm;
+	self->reading->getTimestamp(&tm);
+	empty.setTimestamp(tm);
+	self->reading->getUserTimestamp(&tm);
+	empty.setUserTimestamp(tm);
+	empty.setId(self->reading->getId());
+
+	DatapointsObject *datapoints = (DatapointsObject *)self->datapoints;
+	PyObject *dict = ((PythonReading *)&empty)->toPython(true, datapoints->encodeNames);
+	if (!dict)
+	{
+		return -1;
+	}
+
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(dict, &pos, &key, &value))
+	{
+		if (!isKey(key, READING_KEY) && !isKey(key, ASSET_CODE_KEY))
+		{
+			if (PyDict_SetDefault(self->items, key, value) == NULL)
+			{
+				Py_DECREF(dict);
+				return -1;
+			}
+		}
+	}
+	Py_DECREF(dict);
+
+	return 0;
+}
+
+static PyObject *readingGetItem(ReadingObject *self, PyObject *key)
+{
+	PyObject *value = PyDict_GetItemWithError(self->items, key);
+	if (value)
+	{
+		Py_INCREF(value);
+		return value;
+	}
+	if (PyErr_Occurred())
+	{
+		return NULL;
+	}
+
+	if (self->readingPending && isKey(key, READING_KEY))
+	{
+		if (PyDict_SetItem(self->items, key, self->datapoints) < 0)
+		{
+			return NULL;
+		}
+		self->readingPending = false;
+		Py_INCREF(self->datapoints);
+		return self->datapoints;
+	}
+	if (self->assetPending && isKey(key, ASSET_CODE_KEY))
+	{
+		value = PyUnicode_FromString(self->reading->getAssetName().c_str());
+		if (!value || PyDict_SetItem(self->items, key, value) < 0)
+		{
+			Py_XDECREF(value);
+			return NULL;
+		}
+		self->assetPending = false;
+		return value;
+	}
+	if (self->extrasPending)
+	{
+		if (realizeExtras(self) < 0)
+		{
+			return NULL;
+		}
+		return readingGetItem(self, key);
+	}
+
+	PyErr_SetObject(PyExc_KeyError, key);
+	return NULL;
+}
+
+static int readingSetItem(ReadingObject *self, PyObject *key, PyObject *value)
+{
+	bool wasPending = false;
+	if (self->readingPending && isKey(key, READING_KEY))
+	{
+		self->readingPending = false;
+		wasPending = true;
+	}
+	else if (self->assetPending && isKey(key, ASSET_CODE_KEY))
+	{
+		self->assetPending = false;
+		wasPending = true;
+	}
+	else if (realizeExtras(self) < 0)
+	{
+		return -1;
+	}
+
+	if (!value)
+	{
+		return wasPending ? 0 : PyDict_DelItem(self->items, key);
+	}
+	return PyDict_SetItem(self->items, key, value);
+}
+
+static PyObject *readingKeys(ReadingObject *self, PyObject *unused = NULL)
+{
+	if (realizeExtras(self) < 0)
+	{
+		return NULL;
+	}
+	PyObject *keys = PyList_New(0);
+	if (!keys)
+	{
+		return NULL;
+	}
+	if (self->readingPending)
+	{
+		PyObject *key = PyUnicode_FromString(READING_KEY);
+		PyList_Append(keys, key);
+		Py_XDECREF(key);
+	}
+	if (self->assetPending)
+	{
+		PyObject *key = PyUnicode_FromString(ASSET_CODE_KEY);
+		PyList_Append(keys, key);
+		Py_XDECREF(key);
+	}
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(self->items, &pos, &key, &value))
+	{
+		PyList_Append(keys, key);
+	}
+	return keys;
+}
+
+static Py_ssize_t readingLength(ReadingObject *self)
+{
+	if (realizeExtras(self) < 0)
+	{
+		return -1;
+	}
+	return (self->readingPending ? 1 : 0) +
+		(self->assetPending ? 1 : 0) +
+		PyDict_Size(self->items);
+}
+
+static int readingContains(ReadingObject *self, PyObject *key)
+{
+	if ((self->readingPending && isKey(key, READING_KEY)) ||
+	    (self->assetPending && isKey(key, ASSET_CODE_KEY)))
+	{
+		return 1;
+	}
+	if (realizeExtras(self) < 0)
+	{
+		return -1;
+	}
+	return PyDict_Contains(self->items, key);
+}
+
+static PyObject *readingIter(ReadingObject *self)
+{
+	PyObject *keys = readingKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *iter = PyObject_GetIter(keys);
+	Py_DECREF(keys);
+	return iter;
+}
+
+/**
+ * Return the reading as a plain dict, the same as toPython() would
+ */
+static PyObject *readingCopy(ReadingObject *self, PyObject *unused = NULL)
+{
+	PyObject *keys = readingKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *dict = PyDict_New();
+	for (Py_ssize_t i = 0; dict && i < PyList_GET_SIZE(keys); i++)
+	{
+		PyObject *key = PyList_GET_ITEM(keys, i);
+		PyObject *value = readingGetItem(self, key);
+		if (value && Py_TYPE(value) == Py_TYPE(self->datapoints))
+		{
+			Py_SETREF(value, datapointsCopy((DatapointsObject *)value));
+		}
+		if (!value || PyDict_SetItem(dict, key, value) < 0)
+		{
+			Py_CLEAR(dict);
+		}
+		Py_XDECREF(value);
+	}
+	Py_DECREF(keys);
+	return dict;
+}
+
+static PyObject *readingItems(ReadingObject *self, PyObject *unused)
+{
+	PyObject *keys = readingKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *items = PyList_New(0);
+	for (Py_ssize_t i = 0; items && i < PyList_GET_SIZE(keys); i++)
+	{
+		PyObject *key = PyList_GET_ITEM(keys, i);
+		PyObject *value = readingGetItem(self, key);
+		PyObject *item = value ? PyTuple_Pack(2, key, value) : NULL;
+		if (!item || PyList_Append(items, item) < 0)
+		{
+			Py_CLEAR(items);
+		}
+		Py_XDECREF(item);
+		Py_XDECREF(value);
+	}
+	Py_DECREF(keys);
+	return items;
+}
+
+static PyObject *readingValues(ReadingObject *self, PyObject *unused)
+{
+	PyObject *keys = readingKeys(self);
+	if (!keys)
+	{
+		return NULL;
+	}
+	PyObject *values = PyList_New(0);
+	for (Py_ssize_t i = 0; values && i < PyList_GET_SIZE(keys); i++)
+	{
+		PyObject *value = readingGetItem(self, PyList_GET_ITEM(keys, i));
+		if (!value || PyList_Append(values, value) < 0)
+		{
+			Py_CLEAR(values);
+		}
+		Py_XDECREF(value);
+	}
+	Py_DECREF(keys);
+	return values;
+}
+
+static PyObject *readingGet(ReadingObject *self, PyObject *args)
+{
+	PyObject *key, *def = Py_None;
+	if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &def))
+	{
+		return NULL;
+	}
+	PyObject *value = readingGetItem(self, key);
+	if (!value && PyErr_ExceptionMatches(PyExc_KeyError))
+	{
+		PyErr_Clear();
+		Py_INCREF(def);
+		return def;
+	}
+	return value;
+}
+
+static PyObject *readingPop(ReadingObject *self, PyObject *args)
+{
+	PyObject *key, *def = NULL;
+	if (!PyArg_UnpackTuple(args, "pop", 1, 2, &key, &def))
+	{
+		return NULL;
+	}
+	PyObject *value = readingGetItem(self, key);
+	if (!value)
+	{
+		if (def && PyErr_ExceptionMatches(PyExc_KeyError))
+		{
+			PyErr_Clear();
+			Py_INCREF(def);
+			return def;
+		}
+		return NULL;
+	}
+	if (readingSetItem(self, key, NULL) < 0)
+	{
+		Py_DECREF(value);
+		return NULL;
+	}
+	return value;
+}
+
+static PyObject *readingRepr(ReadingObject *self)
+{
+	PyObject *dict = readingCopy(self);
+	if (!dict)
+	{
+		return NULL;
+	}
+	PyObject *repr = PyObject_Repr(dict);
+	Py_DECREF(dict);
+	return repr;
+}
+
+static int readingTraverse(ReadingObject *self, visitproc visit, void *arg)
+{
+	Py_VISIT(self->datapoints);
+	Py_VISIT(self->items);
+	Py_VISIT(Py_TYPE(self));
+	return 0;
+}
+
+static int readingClear(ReadingObject *self)
+{
+	Py_CLEAR(self->datapoints);
+	Py_CLEAR(self->items);
+	return 0;
+}
+
+static void readingDealloc(ReadingObject *self)
+{
+	PyTypeObject *type = Py_TYPE(self);
+	PyObject_GC_UnTrack(self);
+	readingClear(self);
+	type->tp_free((PyObject *)self);
+	Py_DECREF(type);
+}
+
+/**
+ * Proxies are only created by the filter
+ */
+static PyObject *proxyNew(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	PyErr_Format(PyExc_TypeError, "cannot create '%s' instances", type->tp_name);
+	return NULL;
+}
+
+static PyMethodDef datapointsMethods[] = {
+	{"keys", (PyCFunction)datapointsKeys, METH_NOARGS, NULL},
+	{"items", (PyCFunction)datapointsItems, METH_NOARGS, NULL},
+	{"values", (PyCFunction)datapointsValues, METH_NOARGS, NULL},
+	{"get", (PyCFunction)datapointsGet, METH_VARARGS, NULL},
+	{"pop", (PyCFunction)datapointsPop, METH_VARARGS, NULL},
+	{"copy", (PyCFunction)datapointsCopy, METH_NOARGS, "Return the datapoints as a dict"},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot datapointsSlots[] = {
+	{Py_tp_dealloc, (void *)datapointsDealloc},
+	{Py_tp_traverse, (void *)datapointsTraverse},
+	{Py_tp_clear, (void *)datapointsClear},
+	{Py_tp_repr, (void *)datapointsRepr},
+	{Py_tp_iter, (void *)datapointsIter},
+	{Py_tp_new, (void *)proxyNew},
+	{Py_tp_methods, (void *)datapointsMethods},
+	{Py_mp_length, (void *)datapointsLength},
+	{Py_mp_subscript, (void *)datapointsGetItem},
+	{Py_mp_ass_subscript, (void *)datapointsSetItem},
+	{Py_sq_contains, (void *)datapointsContains},
+	{Py_tp_doc, (void *)"Datapoints of a Fledge reading, converted on first access"},
+	{0, NULL}
+};
+
+static PyType_Spec datapointsSpec = {
+	"python35.Datapoints",
+	sizeof(DatapointsObject),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+	datapointsSlots
+};
+
+static PyMethodDef readingMethods[] = {
+	{"keys", (PyCFunction)readingKeys, METH_NOARGS, NULL},
+	{"items", (PyCFunction)readingItems, METH_NOARGS, NULL},
+	{"values", (PyCFunction)readingValues, METH_NOARGS, NULL},
+	{"get", (PyCFunction)readingGet, METH_VARARGS, NULL},
+	{"pop", (PyCFunction)readingPop, METH_VARARGS, NULL},
+	{"copy", (PyCFunction)readingCopy, METH_NOARGS, "Return the reading as a dict"},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot readingSlots[] = {
+	{Py_tp_dealloc, (void *)readingDealloc},
+	{Py_tp_traverse, (void *)readingTraverse},
+	{Py_tp_clear, (void *)readingClear},
+	{Py_tp_repr, (void *)readingRepr},
+	{Py_tp_iter, (void *)readingIter},
+	{Py_tp_new, (void *)proxyNew},
+	{Py_tp_methods, (void *)readingMethods},
+	{Py_mp_length, (void *)readingLength},
+	{Py_mp_subscript, (void *)readingGetItem},
+	{Py_mp_ass_subscript, (void *)readingSetItem},
+	{Py_sq_contains, (void *)readingContains},
+	{Py_tp_doc, (void *)"Fledge reading, datapoints are converted on first access"},
+	{0, NULL}
+};
+
+static PyType_Spec readingSpec = {
+	"python35.Reading",
+	sizeof(ReadingObject),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+	readingSlots
+};
+
+/**
+ * Register a proxy type as a collections.abc.MutableMapping
+ */
+static void registerMapping(PyObject *type)
+{
+	PyObject *abc = PyImport_ImportModule("collections.abc");
+	if (abc)
+	{
+		PyObject *mapping = PyObject_GetAttrString(abc, "MutableMapping");
+		if (mapping)
+		{
+			PyObject *ret = PyObject_CallMethod(mapping, "register", "O", type);
+			Py_XDECREF(ret);
+			Py_DECREF(mapping);
+		}
+		Py_DECREF(abc);
+	}
+	PyErr_Clear();
+}
+
+/**
+ * Create the proxy types in the current interpreter
+ *
+ * @return	True on success
+ */
+bool PythonReadingProxy::init()
+{
+	if (m_readingType)
+	{
+		return true;
+	}
+
+	m_datapointsType = PyType_FromSpec(&datapointsSpec);
+	m_readingType = PyType_FromSpec(&readingSpec);
+	if (!m_datapointsType || !m_readingType)
+	{
+		clear();
+		return false;
+	}
+
+	registerMapping(m_datapointsType);
+	registerMapping(m_readingType);
+
+	return true;
+}
+
+/**
+ * Release the proxy types
+ */
+void PythonReadingProxy::clear()
+{
+	Py_CLEAR(m_readingType);
+	Py_CLEAR(m_datapointsType);
+}
+
+/**
+ * Create a proxy for a reading
+ *
+ * @param reading	The reading, must remain valid until detach()
+ * @param encodeNames	Datapoint names and strings as bytes objects
+ * @param buffers	Pass arrays, data buffers and images as views
+ *			of the datapoints, NULL to convert them to lists
+ * @return		New reference or NULL on error
+ */
+PyObject *PythonReadingProxy::create(Reading *reading, bool encodeNames, PythonBuffers *buffers)
+{
+	DatapointsObject *datapoints = (DatapointsObject *)
+		PyType_GenericAlloc((PyTypeObject *)m_datapointsType, 0);
+	if (!datapoints)
+	{
+		return NULL;
+	}
+	datapoints->reading = reading;
+	datapoints->encodeNames = encodeNames;
+	datapoints->buffers = buffers;
+	datapoints->items = PyDict_New();
+
+	vector<Datapoint *> points = reading->getReadingData();
+	datapoints->count = points.size();
+	datapoints->pendingCount = datapoints->count;
+	datapoints->points = (Datapoint **)PyMem_Malloc(sizeof(Datapoint *) * (datapoints->count + 1));
+	datapoints->pending = (char *)PyMem_Malloc(datapoints->count + 1);
+	if (!datapoints->items || !datapoints->points || !datapoints->pending)
+	{
+		Py_DECREF(datapoints);
+		return PyErr_NoMemory();
+	}
+	if (datapoints->count)
+	{
+		memcpy(datapoints->points, &points[0], sizeof(Datapoint *) * datapoints->count);
+		memset(datapoints->pending, 1, datapoints->count);
+	}
+
+	ReadingObject *proxy = (ReadingObject *)
+		PyType_GenericAlloc((PyTypeObject *)m_readingType, 0);
+	if (!proxy)
+	{
+		Py_DECREF(datapoints);
+		return NULL;
+	}
+	proxy->reading = reading;
+	proxy->datapoints = (PyObject *)datapoints;
+	proxy->items = PyDict_New();
+	proxy->readingPending = true;
+	proxy->assetPending = true;
+	proxy->extrasPending = true;
+	if (!proxy->items)
+	{
+		Py_DECREF(proxy);
+		return NULL;
+	}
+
+	return (PyObject *)proxy;
+}
+
+/**
+ * Check whether an object is a reading proxy
+ */
+bool PythonReadingProxy::isProxy(PyObject *object) const
+{
+	return m_readingType && Py_TYPE(object) == (PyTypeObject *)m_readingType;
+}
+
+/**
+ * Apply the changes made by the script to a reading
+ *
+ * Only datapoints the script has assigned, or that may have been
+ * modified in place, are converted from Python.
+ *
+ * @param self		The datapoints of the proxy
+ * @param reading	The reading to update
+ * @param removed	If not NULL the datapoints removed from the reading
+ *			are added to it rather than deleted
+ */
+static void applyChanges(DatapointsObject *self, Reading *reading, vector<Datapoint *> *removed)
+{
+	PyObject *changed = PyDict_New();
+	if (!changed)
+	{
+		throw runtime_error("Unable to allocate the changed datapoints");
+	}
+
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(self->items, &pos, &key, &value))
+	{
+		if ((self->assigned && PySet_Contains(self->assigned, key) == 1) ||
+		    !PythonWriteBack::isImmutable(value))
+		{
+			PyDict_SetItem(changed, key, value);
+		}
+	}
+
+	// Convert the changed datapoints in the standard way
+	try {
+		PythonWriteBack::applyDatapoints(reading, changed, removed);
+	} catch (...) {
+		Py_DECREF(changed);
+		throw;
+	}
+	Py_DECREF(changed);
+
+	// Remove the datapoints deleted by the script
+	for (Py_ssize_t i = 0; i < self->count; i++)
+	{
+		if (self->pending[i])
+		{
+			continue;
+		}
+		const string name = self->points[i]->getName();
+		PyObject *dpKey = datapointKey(self, name);
+		if (dpKey && PyDict_Contains(self->items, dpKey) == 0)
+		{
+			Datapoint *dp = reading->removeDatapoint(name);
+			if (dp && removed)
+			{
+				// The proxy still refers to the datapoint
+				removed->push_back(dp);
+			}
+			else
+			{
+				delete dp;
+			}
+		}
+		Py_XDECREF(dpKey);
+	}
+}
+
+/**
+ * Build the output reading for a proxy returned by the script
+ *
+ * The datapoints the script has not changed are copied from the
+ * original reading, as are the timestamps. The original reading
+ * itself may be updated instead, unless the script has replaced
+ * the items of the proxy.
+ *
+ * @param object	The reading proxy
+ * @param removed	If not NULL update the original reading, the
+ *			datapoints removed from it are added to removed
+ * @return		A new reading or the original reading
+ * @throw		exception for badly formed readings
+ */
+Reading *PythonReadingProxy::toReading(PyObject *object, vector<Datapoint *> *removed)
+{
+	ReadingObject *proxy = (ReadingObject *)object;
+	DatapointsObject *datapoints = (DatapointsObject *)proxy->datapoints;
+
+	PyObject *asset = NULL;
+	if (!proxy->assetPending)
+	{
+		asset = PyDict_GetItemString(proxy->items, ASSET_CODE_KEY);
+	}
+	bool intact = proxy->reading &&
+		datapoints->reading == proxy->reading &&
+		(proxy->readingPending ||
+		 PyDict_GetItemString(proxy->items, READING_KEY) == proxy->datapoints) &&
+		(proxy->assetPending || (asset && PyUnicode_Check(asset)));
+
+	if (!intact)
+	{
+		// The structure has been changed by the script, use the standard conversion
+		PyObject *dict = readingCopy(proxy);
+		if (!dict)
+		{
+			throw runtime_error(PythonReading::errorMessage());
+		}
+		try {
+			Reading *reading = PythonBuffers::toReading(dict);
+			Py_DECREF(dict);
+			return reading;
+		} catch (...) {
+			Py_DECREF(dict);
+			throw;
+		}
+	}
+
+	const char *assetName = NULL;
+	if (asset)
+	{
+		assetName = PyUnicode_AsUTF8(asset);
+		if (!assetName)
+		{
+			throw runtime_error("Unable to parse the asset code value. Asset codes should be a string.");
+		}
+	}
+
+	Reading *reading = removed ? proxy->reading : new Reading(*proxy->reading);
+	try {
+		applyChanges(datapoints, reading, removed);
+	} catch (...) {
+		if (!removed)
+		{
+			delete reading;
+		}
+		throw;
+	}
+	if (assetName)
+	{
+		reading->setAssetName(assetName);
+	}
+
+	return reading;
+}
+
+/**
+ * Return the C++ reading of a proxy, NULL once detached
+ */
+Reading *PythonReadingProxy::getReading(PyObject *object)
+{
+	return ((ReadingObject *)object)->reading;
+}
+
+/**
+ * Detach a proxy from its C++ reading
+ *
+ * If the script kept a reference to the proxy, or to its datapoints,
+ * the remaining datapoints are converted so that the object stays usable.
+ *
+ * @param object	The reading proxy, referenced once by the input list
+ * @param shared	The input list is still referenced by the script
+ * @param callerRefs	The references to the proxy held by the caller,
+ *			in addition to that of the input list
+ * @return		True if the datapoints were converted to be kept
+ */
+bool PythonReadingProxy::detach(PyObject *object, bool shared, Py_ssize_t callerRefs)
+{
+	ReadingObject *proxy = (ReadingObject *)object;
+	if (!proxy->reading)
+	{
+		return false;
+	}
+
+	DatapointsObject *datapoints = (DatapointsObject *)proxy->datapoints;
+	Py_ssize_t internalRefs = proxy->readingPending ? 1 : 2;
+	bool keepReading = shared || Py_REFCNT(object) > 1 + callerRefs;
+	bool keepDatapoints = keepReading || Py_REFCNT(proxy->datapoints) > internalRefs;
+
+	if (keepReading)
+	{
+		if (proxy->assetPending)
+		{
+			PyObject *key = PyUnicode_FromString(ASSET_CODE_KEY);
+			Py_XDECREF(readingGetItem(proxy, key));
+			Py_XDECREF(key);
+		}
+		realizeExtras(proxy);
+	}
+	if (datapointsDetach(datapoints, keepDatapoints) < 0 || PyErr_Occurred())
+	{
+		PyErr_Clear();
+	}
+	proxy->reading = NULL;
+	proxy->assetPending = false;
+	proxy->extrasPending = false;
+	return keepDatapoints;
+}
@@ -0,0 +1,348 @@
+/*
+ * Fledge "Python 3.5" filter script compilation cache.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <python35_scriptcache.h>
+
+#include <marshal.h>
+
+// Directory of the cached code, relative to the scripts path
+#define CACHE_DIRECTORY		"__pycache__"
+// Digits of the hash in the name of a cache file
+#define HASH_DIGITS		16
+
+using namespace std;
+
+/**
+ * Return the end of the name of the cache files, the marshal
+ * format of code objects depends on the Python version
+ */
+static string cacheSuffix()
+{
+	return ".cpython-" + to_string(PY_MAJOR_VERSION) + to_string(PY_MINOR_VERSION) + ".code";
+}
+
+PythonScriptCache::PythonScriptCache() : m_code(NULL),
+					 m_codeHash(0),
+					 m_loadedHash(0)
+{
+	m_logger = Logger::getLogger();
+}
+
+/**
+ * Load the script as a module
+ *
+ * If a module loaded from the same script is passed and the content of
+ * the script has not changed, the module is returned as it is. If the
+ * content has changed the script is executed in a new module, the
+ * module passed and its globals are left unchanged for the calls of
+ * the script that still use them.
+ *
+ * @param directory	The scripts path
+ * @param name		The name of the script, without extension
+ * @param module	The module loaded from the script, or NULL
+ * @return		New reference to the module, NULL with a Python error set on failure
+ */
+PyObject *PythonScriptCache::load(const string& directory, const string& name, PyObject *module)
+{
+	string path = directory + "/" + name + ".py";
+	string source;
+	if (!readFile(path, source))
+	{
+		// The script is not in the scripts path, Python finds it
+		m_loadedName.clear();
+		m_logger->debug("Script %s is not in %s, it is imported by Python",
+				name.c_str(), directory.c_str());
+		PyObject *previous = detachModule(name);
+		PyObject *result = PyImport_ImportModule(name.c_str());
+		restoreModule(name, previous, result);
+		return result;
+	}
+
+	uint64_t hash = contentHash(source);
+	if (module && name.compare(m_loadedName) == 0 && hash == m_loadedHash)
+	{
+		m_logger->debug("Script %s has not changed, the module is kept", name.c_str());
+		Py_INCREF(module);
+		return module;
+	}
+	m_loadedName.clear();
+
+	PyObject *code = compile(directory, name, source, hash);
+	if (!code)
+	{
+		return NULL;
+	}
+
+	PyObject *previous = detachModule(name);
+	PyObject *result = PyImport_ExecCodeModuleEx(name.c_str(), code, path.c_str());
+	restoreModule(name, previous, result);
+	if (!result)
+	{
+		return NULL;
+	}
+
+	m_loadedName = name;
+	m_loadedHash = hash;
+	return result;
+}
+
+/**
+ * Remove a module from sys.modules, so that it is loaded
+ * again in a new module object
+ *
+ * @param name	The name of the module
+ * @return	New reference to the module removed, or NULL
+ */
+PyObject *PythonScriptCache::detachModule(const string& name)
+{
+	PyObject *modules = PyImport_GetModuleDict();
+	PyObject *previous = PyDict_GetItemString(modules, name.c_str());
+	if (!previous)
+	{
+		return NULL;
+	}
+	Py_INCREF(previous);
+	if (PyDict_DelItemString(modules, name.c_str()) < 0)
+	{
+		PyErr_Clear();
+	}
+	return previous;
+}
+
+/**
+ * Put back in sys.modules the module removed by detachModule()
+ * if the new module has not been loaded
+ *
+ * @param name		The name of the module
+ * @param previous	The module removed, the reference is released
+ * @param loaded	The new module, NULL if it failed to load
+ */
+void PythonScriptCache::restoreModule(const string& name, PyObject *previous, PyObject *loaded)
+{
+	if (!previous)
+	{
+		return;
+	}
+	if (!loaded)
+	{
+		// The error of the load is kept
+		PyObject *type, *value, *traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		if (PyDict_SetItemString(PyImport_GetModuleDict(), name.c_str(), previous) < 0)
+		{
+			PyErr_Clear();
+		}
+		PyErr_Restore(type, value, traceback);
+	}
+	Py_DECREF(previous);
+}
+
+/**
+ * Return true if the script has not changed since its module was loaded
+ *
+ * @param directory	The scripts path
+ * @param name		The name of the script, without extension
+ */
+bool PythonScriptCache::isUnchanged(const string& directory, const string& name)
+{
+	if (m_loadedName.empty() || name.compare(m_loadedName) != 0)
+	{
+		return false;
+	}
+	string source;
+	return readFile(directory + "/" + name + ".py", source) && contentHash(source) == m_loadedHash;
+}
+
+/**
+ * Release the code object
+ */
+void PythonScriptCache::clear()
+{
+	Py_CLEAR(m_code);
+	m_loadedName.clear();
+}
+
+/**
+ * Return the code object of a script, compiled or read
+ * from the cache files if the content has not changed
+ *
+ * @param directory	The scripts path
+ * @param name		The name of the script
+ * @param source	The content of the script
+ * @param hash		The hash of the content
+ * @return		Borrowed reference to the code object, NULL with a Python error set on failure
+ */
+PyObject *PythonScriptCache::compile(const string& directory,
+				     const string& name,
+				     const string& source,
+				     uint64_t hash)
+{
+	if (m_code && hash == m_codeHash)
+	{
+		return m_code;
+	}
+	Py_CLEAR(m_code);
+
+	PyObject *code = NULL;
+	string cached;
+	if (readFile(directory + "/" CACHE_DIRECTORY "/" + cacheName(name, hash), cached))
+	{
+		code = PyMarshal_ReadObjectFromString(cached.data(), cached.size());
+		if (!code || !PyCode_Check(code))
+		{
+			// A damaged cache file is replaced
+			PyErr_Clear();
+			Py_CLEAR(code);
+		}
+	}
+
+	if (!code)
+	{
+		string path = directory + "/" + name + ".py";
+		code = Py_CompileString(source.c_str(), path.c_str(), Py_file_input);
+		if (!code)
+		{
+			return NULL;
+		}
+		writeCache(directory, name, hash, code);
+	}
+	else
+	{
+		m_logger->debug("Script %s is loaded from its compiled code", name.c_str());
+	}
+
+	m_code = code;
+	m_codeHash = hash;
+	return m_code;
+}
+
+/**
+ * Persist a code object and remove the cache files
+ * of the previous contents of the script
+ *
+ * @param directory	The scripts path
+ * @param name		The name of the script
+ * @param hash		The hash of the content
+ * @param code		The code object
+ */
+void PythonScriptCache::writeCache(const string& directory,
+				   const string& name,
+				   uint64_t hash,
+				   PyObject *code)
+{
+	string cacheDirectory = directory + "/" CACHE_DIRECTORY;
+	if (mkdir(cacheDirectory.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		m_logger->warn("Unable to create %s, the compiled script %s is not kept",
+				cacheDirectory.c_str(), name.c_str());
+		return;
+	}
+
+	PyObject *data = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+	if (!data)
+	{
+		PyErr_Clear();
+		return;
+	}
+
+	// Written under a temporary name so that a cache file is always complete
+	string fileName = cacheName(name, hash);
+	string path = cacheDirectory + "/" + fileName;
+	string temporary = path + "." + to_string(getpid());
+	FILE *fp = fopen(temporary.c_str(), "wb");
+	bool written = fp && fwrite(PyBytes_AS_STRING(data), 1, PyBytes_GET_SIZE(data), fp) ==
+					(size_t)PyBytes_GET_SIZE(data);
+	if (fp && fclose(fp) != 0)
+	{
+		written = false;
+	}
+	Py_DECREF(data);
+	if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		unlink(temporary.c_str());
+		m_logger->warn("Unable to write %s, the compiled script %s is not kept",
+				path.c_str(), name.c_str());
+		return;
+	}
+
+	DIR *dir = opendir(cacheDirectory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+	string prefix = name + ".";
+	string suffix = cacheSuffix();
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		string entryName = entry->d_name;
+		if (entryName.length() == fileName.length() &&
+		    entryName.compare(0, prefix.length(), prefix) == 0 &&
+		    entryName.compare(entryName.length() - suffix.length(), suffix.length(), suffix) == 0 &&
+		    entryName.compare(fileName) != 0)
+		{
+			unlink((cacheDirectory + "/" + entryName).c_str());
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * Read the content of a file
+ *
+ * @param path		The file
+ * @param content	Returns the content
+ * @return		True if the file has been read
+ */
+bool PythonScriptCache::readFile(const string& path, string& content)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	content.clear();
+	char buffer[8192];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		content.append(buffer, n);
+	}
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+/**
+ * Return the 64 bit FNV-1a hash of a content
+ */
+uint64_t PythonScriptCache::contentHash(const string& content)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < content.length(); i++)
+	{
+		hash ^= (unsigned char)content[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Return the name of the cache file of a content of a script
+ */
+string PythonScriptCache::cacheName(const string& name, uint64_t hash)
+{
+	char digits[HASH_DIGITS + 1];
+	snprintf(digits, sizeof(digits), "%016llx", (unsigned long long)hash);
+	return name + "." + digits + cacheSuffix();
+}
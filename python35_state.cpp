@@ -0,0 +1,74 @@
+/*
+ * Fledge "Python 3.5" filter script state.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <python35_state.h>
+
+/**
+ * Create a snapshot, the interpreter lock must be held
+ * if the module or the function is set
+ *
+ * @param interpreter	The interpreter the script runs in
+ * @param module	The module of the script, may be NULL
+ * @param function	The function of the script, may be NULL
+ * @param encodeNames	Datapoint names are bytes objects
+ * @param enabled	The filter is enabled
+ * @param streaming	The function is a generator
+ * @param lazyReadings	The readings are passed as lazy reading objects
+ * @param bufferViews	Arrays, data buffers and images are passed as views
+ * @param columnar	The readings are passed as columnar batches
+ * @param transforms	The transforms applied without Python, may be NULL
+ * @param assets	The assets whose readings are passed to the script
+ * @param projection	The names of the datapoints converted, empty for all
+ * @param failed	The script failed to load or to configure
+ */
+PythonFilterState::PythonFilterState(PythonInterpreter *interpreter,
+				     PyObject *module,
+				     PyObject *function,
+				     bool encodeNames,
+				     bool enabled,
+				     bool streaming,
+				     bool lazyReadings,
+				     bool bufferViews,
+				     bool columnar,
+				     const std::shared_ptr<const PythonTransforms>& transforms,
+				     const std::shared_ptr<PythonAssetFilter>& assets,
+				     const std::shared_ptr<const std::vector<std::string> >& projection,
+				     bool failed) :
+				     m_interpreter(interpreter),
+				     m_module(module),
+				     m_function(function),
+				     m_encodeNames(encodeNames),
+				     m_enabled(enabled),
+				     m_streaming(streaming),
+				     m_lazyReadings(lazyReadings),
+				     m_bufferViews(bufferViews),
+				     m_columnar(columnar),
+				     m_transforms(transforms),
+				     m_assets(assets),
+				     m_projection(projection),
+				     m_failed(failed)
+{
+	Py_XINCREF(m_module);
+	Py_XINCREF(m_function);
+}
+
+/**
+ * Release the references to the module and function, the
+ * interpreter lock is taken whether or not the caller holds it
+ */
+PythonFilterState::~PythonFilterState()
+{
+	if ((!m_module && !m_function) || !Py_IsInitialized())
+	{
+		return;
+	}
+	PythonInterpreter::LockState state = m_interpreter->acquire();
+	Py_CLEAR(m_function);
+	Py_CLEAR(m_module);
+	m_interpreter->release(state);
+}
@@ -0,0 +1,178 @@
+/*
+ * Fledge "Python 3.5" filter reading streams.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <python35_stream.h>
+
+// Code flag of generator functions
+#ifndef CO_GENERATOR
+#define CO_GENERATOR	0x0020
+#endif
+
+using namespace std;
+
+/**
+ * The iterator passed to the script
+ */
+typedef struct {
+	PyObject_HEAD
+	// The readings of the batch, NULL once detached
+	Reading * const	*readings;
+	size_t		count;
+	// Index of the next reading, the previous ones have been deleted
+	size_t		next;
+	PythonKeyCache	*keyCache;
+} StreamObject;
+
+/**
+ * Return the next reading as a dict and delete the C++ reading
+ */
+static PyObject *streamNext(StreamObject *self)
+{
+	if (!self->readings || self->next >= self->count)
+	{
+		return NULL;
+	}
+
+	Reading *reading = self->readings[self->next];
+	PyObject *dict = self->keyCache->toPython(reading);
+	if (!dict)
+	{
+		return NULL;
+	}
+	self->next++;
+	delete reading;
+
+	return dict;
+}
+
+static PyObject *streamLengthHint(StreamObject *self, PyObject *unused)
+{
+	return PyLong_FromSize_t(self->readings ? self->count - self->next : 0);
+}
+
+static void streamDealloc(StreamObject *self)
+{
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject *)self);
+	Py_DECREF(type);
+}
+
+/**
+ * Streams are only created by the filter
+ */
+static PyObject *streamNew(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	PyErr_Format(PyExc_TypeError, "cannot create '%s' instances", type->tp_name);
+	return NULL;
+}
+
+static PyMethodDef streamMethods[] = {
+	{"__length_hint__", (PyCFunction)streamLengthHint, METH_NOARGS, NULL},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot streamSlots[] = {
+	{Py_tp_dealloc, (void *)streamDealloc},
+	{Py_tp_iter, (void *)PyObject_SelfIter},
+	{Py_tp_iternext, (void *)streamNext},
+	{Py_tp_new, (void *)streamNew},
+	{Py_tp_methods, (void *)streamMethods},
+	{Py_tp_doc, (void *)"Fledge readings, converted as they are iterated"},
+	{0, NULL}
+};
+
+static PyType_Spec streamSpec = {
+	"python35.ReadingStream",
+	sizeof(StreamObject),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	streamSlots
+};
+
+/**
+ * Create the stream type in the current interpreter
+ *
+ * @return	False with a Python exception set on error
+ */
+bool PythonReadingStream::init()
+{
+	if (!m_type)
+	{
+		m_type = PyType_FromSpec(&streamSpec);
+	}
+	return m_type != NULL;
+}
+
+/**
+ * Release the stream type
+ */
+void PythonReadingStream::clear()
+{
+	Py_CLEAR(m_type);
+}
+
+/**
+ * Create a stream over a set of readings
+ *
+ * The readings are deleted as the script consumes them,
+ * detach() returns how many have been deleted.
+ *
+ * @param readings	The readings of the batch
+ * @param keyCache	Converts the readings to dicts
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonReadingStream::create(const vector<Reading *>& readings, PythonKeyCache *keyCache)
+{
+	if (!init())
+	{
+		return NULL;
+	}
+
+	StreamObject *stream = (StreamObject *)PyType_GenericAlloc((PyTypeObject *)m_type, 0);
+	if (!stream)
+	{
+		return NULL;
+	}
+	stream->readings = readings.empty() ? NULL : &readings[0];
+	stream->count = readings.size();
+	stream->next = 0;
+	stream->keyCache = keyCache;
+
+	return (PyObject *)stream;
+}
+
+/**
+ * Detach a stream from the readings of the batch, the script
+ * may keep the stream but it has no more readings
+ *
+ * @param stream	The stream returned by create()
+ * @return		The number of readings deleted by the stream
+ */
+size_t PythonReadingStream::detach(PyObject *stream)
+{
+	StreamObject *self = (StreamObject *)stream;
+	size_t consumed = self->next;
+	self->readings = NULL;
+	self->count = 0;
+	self->next = 0;
+	return consumed;
+}
+
+/**
+ * Check whether a script function is a generator function
+ */
+bool PythonReadingStream::isGenerator(PyObject *function)
+{
+	PyObject *code = PyObject_GetAttrString(function, "__code__");
+	PyObject *flags = code ? PyObject_GetAttrString(code, "co_flags") : NULL;
+	bool generator = flags && PyLong_Check(flags) && (PyLong_AsLong(flags) & CO_GENERATOR);
+	Py_XDECREF(flags);
+	Py_XDECREF(code);
+	PyErr_Clear();
+	return generator;
+}
@@ -0,0 +1,424 @@
+/*
+ * Fledge "Python 3.5" filter native transforms.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <fnmatch.h>
+#include <python35_transforms.h>
+#include <rapidjson/document.h>
+
+// Member of the configuration of the script with the transforms
+#define TRANSFORMS_MEMBER	"transforms"
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Compile the transforms declared in the configuration of the script
+ *
+ * @param name		The name of the filter
+ * @param configuration	The JSON configuration of the script
+ * @return		The transforms, NULL if there are none or they are not valid
+ */
+PythonTransforms *PythonTransforms::create(const string& name, const string& configuration)
+{
+	Document doc;
+	doc.Parse(configuration.c_str());
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember(TRANSFORMS_MEMBER))
+	{
+		return NULL;
+	}
+
+	Logger *logger = Logger::getLogger();
+	const Value& list = doc[TRANSFORMS_MEMBER];
+	if (!list.IsArray())
+	{
+		logger->error("Filter %s ignores its transforms, \"%s\" must be a list",
+				name.c_str(), TRANSFORMS_MEMBER);
+		return NULL;
+	}
+
+	PythonTransforms *transforms = new PythonTransforms();
+	for (SizeType i = 0; i < list.Size(); i++)
+	{
+		Transform transform;
+		transform.asset = "*";
+		transform.namedAsset = false;
+		transform.datapoint = "*";
+		transform.hasScale = transform.hasOffset = transform.hasMin = transform.hasMax = false;
+		transform.scale = 1.0;
+		transform.offset = transform.min = transform.max = 0.0;
+		transform.integral = true;
+
+		string error;
+		const Value& item = list[i];
+		if (!item.IsObject())
+		{
+			error = "is not an object";
+		}
+		else
+		{
+			for (Value::ConstMemberIterator m = item.MemberBegin();
+			     m != item.MemberEnd() && error.empty();
+			     ++m)
+			{
+				string member = m->name.GetString();
+				if (member == "asset" || member == "datapoint" || member == "rename")
+				{
+					if (!m->value.IsString())
+					{
+						error = "\"" + member + "\" must be a string";
+					}
+					else if (member == "asset")
+					{
+						transform.asset = m->value.GetString();
+						transform.namedAsset = true;
+					}
+					else if (member == "datapoint")
+					{
+						transform.datapoint = m->value.GetString();
+					}
+					else
+					{
+						transform.rename = m->value.GetString();
+					}
+				}
+				else if (member == "scale" || member == "offset" || member == "min" || member == "max")
+				{
+					if (!m->value.IsNumber())
+					{
+						error = "\"" + member + "\" must be a number";
+						continue;
+					}
+					double value = m->value.GetDouble();
+					transform.integral = transform.integral && m->value.IsInt64();
+					if (member == "scale")
+					{
+						transform.hasScale = true;
+						transform.scale = value;
+					}
+					else if (member == "offset")
+					{
+						transform.hasOffset = true;
+						transform.offset = value;
+					}
+					else if (member == "min")
+					{
+						transform.hasMin = true;
+						transform.min = value;
+					}
+					else
+					{
+						transform.hasMax = true;
+						transform.max = value;
+					}
+				}
+				else
+				{
+					error = "has an unknown member \"" + member + "\"";
+				}
+			}
+		}
+		if (error.empty() && !transform.hasScale && !transform.hasOffset &&
+		    !transform.hasMin && !transform.hasMax && transform.rename.empty())
+		{
+			error = "has no operation";
+		}
+		if (error.empty() && !transform.rename.empty() &&
+		    transform.datapoint.find_first_of("*?[") != string::npos)
+		{
+			error = "renames the datapoints of a pattern";
+		}
+		if (!error.empty())
+		{
+			logger->error("Filter %s ignores its transforms, transform %u %s",
+					name.c_str(), i + 1, error.c_str());
+			delete transforms;
+			return NULL;
+		}
+		transforms->m_transforms.push_back(transform);
+		transforms->m_namedAssets = transforms->m_namedAssets || transform.namedAsset;
+	}
+
+	if (transforms->m_transforms.empty())
+	{
+		delete transforms;
+		return NULL;
+	}
+	return transforms;
+}
+
+/**
+ * Split a set of readings into the readings processed by the
+ * transforms only and the readings passed to the script
+ *
+ * Only the transforms that name their asset take readings away from
+ * the script, a transform without an asset does not.
+ *
+ * @param readingSet	The readings, the set is deleted unless all its
+ *			readings are passed to the script
+ * @param native	Returns the readings processed by the transforms only
+ * @param toScript	Returns whether each reading is passed to the script
+ * @return		The readings passed to the script, NULL if none
+ */
+ReadingSet *PythonTransforms::split(ReadingSet *readingSet,
+				    vector<Reading *>& native,
+				    vector<bool>& toScript) const
+{
+	if (!m_namedAssets)
+	{
+		return readingSet;
+	}
+
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	vector<Reading *> *scriptReadings = new vector<Reading *>();
+	toScript.reserve(readings.size());
+	const string *previous = NULL;
+	bool match = false;
+	for (vector<Reading *>::const_iterator elem = readings.begin();
+					      elem != readings.end();
+					      ++elem)
+	{
+		const string& assetName = (*elem)->getAssetName();
+		// Readings of the same asset usually follow each other
+		if (!previous || *previous != assetName)
+		{
+			match = matchesAsset(assetName);
+			previous = &assetName;
+		}
+		toScript.push_back(!match);
+		if (match)
+		{
+			native.push_back(*elem);
+		}
+		else
+		{
+			scriptReadings->push_back(*elem);
+		}
+	}
+
+	if (native.empty())
+	{
+		delete scriptReadings;
+		toScript.clear();
+		return readingSet;
+	}
+
+	// The readings are now owned by the new set and the native vector
+	readingSet->clear();
+	delete readingSet;
+
+	if (scriptReadings->empty())
+	{
+		delete scriptReadings;
+		return NULL;
+	}
+	ReadingSet *result = new ReadingSet(scriptReadings);
+	delete scriptReadings;
+	return result;
+}
+
+/**
+ * Apply the transforms to the datapoints of readings
+ *
+ * @param readings	The readings, changed in place
+ */
+void PythonTransforms::apply(const vector<Reading *>& readings) const
+{
+	const string *previous = NULL;
+	vector<const Transform *> active;
+	for (vector<Reading *>::const_iterator elem = readings.begin();
+					      elem != readings.end();
+					      ++elem)
+	{
+		const string& assetName = (*elem)->getAssetName();
+		if (!previous || *previous != assetName)
+		{
+			active.clear();
+			for (size_t i = 0; i < m_transforms.size(); i++)
+			{
+				if (matches(m_transforms[i].asset, assetName))
+				{
+					active.push_back(&m_transforms[i]);
+				}
+			}
+			previous = &assetName;
+		}
+
+		vector<Datapoint *>& datapoints = (*elem)->getReadingData();
+		for (size_t t = 0; t < active.size(); t++)
+		{
+			const Transform& transform = *active[t];
+			for (size_t d = 0; d < datapoints.size(); d++)
+			{
+				if (!matches(transform.datapoint, datapoints[d]->getName()))
+				{
+					continue;
+				}
+				applyValue(transform, datapoints[d]->getData());
+				if (!transform.rename.empty())
+				{
+					datapoints[d]->setName(transform.rename);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Return true if a transform that names its asset applies
+ * to the readings of an asset
+ */
+bool PythonTransforms::matchesAsset(const string& asset) const
+{
+	for (size_t i = 0; i < m_transforms.size(); i++)
+	{
+		if (m_transforms[i].namedAsset && matches(m_transforms[i].asset, asset))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Return true if a name matches a name or pattern
+ */
+bool PythonTransforms::matches(const string& pattern, const string& name)
+{
+	if (pattern.length() == 1 && pattern[0] == '*')
+	{
+		return true;
+	}
+	if (pattern.find_first_of("*?[") == string::npos)
+	{
+		return pattern == name;
+	}
+	return fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+}
+
+/**
+ * Apply the numeric operations of a transform to a datapoint value,
+ * values that are not numbers are unchanged
+ *
+ * @param transform	The transform
+ * @param value		The value, changed in place
+ */
+void PythonTransforms::applyValue(const Transform& transform, DatapointValue& value)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			if (transform.integral)
+			{
+				long result = value.toInt();
+				if (transform.hasScale)
+				{
+					result *= (long)transform.scale;
+				}
+				if (transform.hasOffset)
+				{
+					result += (long)transform.offset;
+				}
+				if (transform.hasMin && result < (long)transform.min)
+				{
+					result = (long)transform.min;
+				}
+				if (transform.hasMax && result > (long)transform.max)
+				{
+					result = (long)transform.max;
+				}
+				value.setValue(result);
+				break;
+			}
+			// An integer with a fractional transform becomes a float
+			value.setValue((double)value.toInt());
+			// Fall through
+		case DatapointValue::T_FLOAT:
+		{
+			double result = value.toDouble();
+			if (transform.hasScale)
+			{
+				result *= transform.scale;
+			}
+			if (transform.hasOffset)
+			{
+				result += transform.offset;
+			}
+			if (transform.hasMin && result < transform.min)
+			{
+				result = transform.min;
+			}
+			if (transform.hasMax && result > transform.max)
+			{
+				result = transform.max;
+			}
+			value.setValue(result);
+			break;
+		}
+		case DatapointValue::T_FLOAT_ARRAY:
+			if (value.getDpArr())
+			{
+				applyArray(transform, *value.getDpArr());
+			}
+			break;
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+			if (value.getDp2DArr())
+			{
+				vector<vector<double> *>& rows = *value.getDp2DArr();
+				for (size_t i = 0; i < rows.size(); i++)
+				{
+					if (rows[i])
+					{
+						applyArray(transform, *rows[i]);
+					}
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Apply the numeric operations of a transform to an array
+ *
+ * Each operation is a separate loop with no dependency between the
+ * elements, so that it is compiled to vector instructions.
+ *
+ * @param transform	The transform
+ * @param values	The array, changed in place
+ */
+void PythonTransforms::applyArray(const Transform& transform, vector<double>& values)
+{
+	double *data = values.data();
+	size_t count = values.size();
+	if (transform.hasScale || transform.hasOffset)
+	{
+		const double scale = transform.scale;
+		const double offset = transform.offset;
+		for (size_t i = 0; i < count; i++)
+		{
+			data[i] = data[i] * scale + offset;
+		}
+	}
+	if (transform.hasMin)
+	{
+		const double min = transform.min;
+		for (size_t i = 0; i < count; i++)
+		{
+			data[i] = data[i] < min ? min : data[i];
+		}
+	}
+	if (transform.hasMax)
+	{
+		const double max = transform.max;
+		for (size_t i = 0; i < count; i++)
+		{
+			data[i] = data[i] > max ? max : data[i];
+		}
+	}
+}
@@ -0,0 +1,188 @@
+/*
+ * Fledge "Python 3.5" filter conversion of datapoint values.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <vector>
+#include <pythonreading.h>
+#include <python35_values.h>
+
+// Key of the datapoints in the reading dict, as set by PythonReading::toPython(true, ...)
+#define READING_KEY	"reading"
+
+using namespace std;
+
+/**
+ * Convert the value of a datapoint to a Python object
+ *
+ * @param asset		The asset of the reading the datapoint belongs to
+ * @param dp		The datapoint
+ * @param encodeStrings	Strings are bytes objects rather than str objects
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonValues::toPython(const string& asset, Datapoint *dp, bool encodeStrings)
+{
+	DatapointValue& data = dp->getData();
+	if (isDirect(data))
+	{
+		return convert(data, encodeStrings);
+	}
+	return convertReading(asset, dp, encodeStrings);
+}
+
+/**
+ * Return true if a value is converted without PythonReading
+ */
+bool PythonValues::isDirect(DatapointValue& value)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+		case DatapointValue::T_FLOAT:
+		case DatapointValue::T_STRING:
+		case DatapointValue::T_FLOAT_ARRAY:
+			return true;
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+		{
+			vector<Datapoint *> *children = value.getDpVec();
+			if (!children)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < children->size(); i++)
+			{
+				if (!isDirect((*children)[i]->getData()))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Convert a value accepted by isDirect()
+ *
+ * @param value		The value
+ * @param encodeStrings	Strings are bytes objects rather than str objects
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonValues::convert(DatapointValue& value, bool encodeStrings)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			return PyLong_FromLong(value.toInt());
+		case DatapointValue::T_FLOAT:
+			return PyFloat_FromDouble(value.toDouble());
+		case DatapointValue::T_STRING:
+		{
+			string str = value.toStringValue();
+			return encodeStrings ?
+				PyBytes_FromStringAndSize(str.c_str(), str.length()) :
+				PyUnicode_FromStringAndSize(str.c_str(), str.length());
+		}
+		case DatapointValue::T_FLOAT_ARRAY:
+		{
+			vector<double> *values = value.getDpArr();
+			PyObject *list = PyList_New(values ? values->size() : 0);
+			for (size_t i = 0; list && values && i < values->size(); i++)
+			{
+				PyObject *item = PyFloat_FromDouble((*values)[i]);
+				if (!item)
+				{
+					Py_CLEAR(list);
+					break;
+				}
+				PyList_SET_ITEM(list, i, item);
+			}
+			return list;
+		}
+		case DatapointValue::T_DP_DICT:
+		{
+			vector<Datapoint *> *children = value.getDpVec();
+			PyObject *dict = PyDict_New();
+			for (size_t i = 0; dict && i < children->size(); i++)
+			{
+				Datapoint *child = (*children)[i];
+				PyObject *item = convert(child->getData(), encodeStrings);
+				if (!item || PyDict_SetItemString(dict, child->getName().c_str(), item) < 0)
+				{
+					Py_XDECREF(item);
+					Py_CLEAR(dict);
+					break;
+				}
+				Py_DECREF(item);
+			}
+			return dict;
+		}
+		case DatapointValue::T_DP_LIST:
+		{
+			vector<Datapoint *> *children = value.getDpVec();
+			PyObject *list = PyList_New(children->size());
+			for (size_t i = 0; list && i < children->size(); i++)
+			{
+				PyObject *item = convert((*children)[i]->getData(), encodeStrings);
+				if (!item)
+				{
+					Py_CLEAR(list);
+					break;
+				}
+				PyList_SET_ITEM(list, i, item);
+			}
+			return list;
+		}
+		default:
+			PyErr_SetString(PyExc_ValueError, "Unsupported datapoint type");
+			return NULL;
+	}
+}
+
+/**
+ * Convert a datapoint with PythonReading::toPython()
+ *
+ * @param asset		The asset of the reading the datapoint belongs to
+ * @param dp		The datapoint
+ * @param encodeStrings	Strings are bytes objects rather than str objects
+ * @return		New reference or NULL with a Python exception set
+ */
+PyObject *PythonValues::convertReading(const string& asset, Datapoint *dp, bool encodeStrings)
+{
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint(dp->getName(), dp->getData()));
+	Reading single(asset, values);
+
+	PyObject *dict = ((PythonReading *)&single)->toPython(true, encodeStrings);
+	if (!dict)
+	{
+		return NULL;
+	}
+
+	PyObject *value = NULL;
+	PyObject *datapoints = PyDict_GetItemString(dict, READING_KEY);
+	if (datapoints && PyDict_Check(datapoints))
+	{
+		PyObject *key;
+		Py_ssize_t pos = 0;
+		if (PyDict_Next(datapoints, &pos, &key, &value))
+		{
+			Py_INCREF(value);
+		}
+	}
+	Py_DECREF(dict);
+
+	if (!value && !PyErr_Occurred())
+	{
+		PyErr_Format(PyExc_ValueError,
+			     "Unable to convert datapoint '%s'",
+			     dp->getName().c_str());
+	}
+	return value;
+}
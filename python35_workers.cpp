@@ -0,0 +1,1572 @@
+/*
+ * Fledge "Python 3.5" filter worker processes.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <Python.h>
+#include <python35_workers.h>
+
+// File descriptor of the doorbell socket in the worker
+#define WORKER_BELL_FD	3
+// Shortest time in milliseconds given to a new worker to load the script
+#define WORKER_START_TIMEOUT	10000
+
+// Type codes of the Python marshal format
+#define MARSHAL_NONE			'N'
+#define MARSHAL_FALSE			'F'
+#define MARSHAL_TRUE			'T'
+#define MARSHAL_INT			'i'
+#define MARSHAL_LONG			'l'
+#define MARSHAL_FLOAT			'f'
+#define MARSHAL_BINARY_FLOAT		'g'
+#define MARSHAL_BYTES			's'
+#define MARSHAL_INTERNED		't'
+#define MARSHAL_UNICODE			'u'
+#define MARSHAL_ASCII			'a'
+#define MARSHAL_ASCII_INTERNED		'A'
+#define MARSHAL_SHORT_ASCII		'z'
+#define MARSHAL_SHORT_ASCII_INTERNED	'Z'
+#define MARSHAL_TUPLE			'('
+#define MARSHAL_SMALL_TUPLE		')'
+#define MARSHAL_LIST			'['
+#define MARSHAL_DICT			'{'
+#define MARSHAL_NULL			'0'
+#define MARSHAL_FLAG_REF		0x80
+
+using namespace std;
+
+extern char **environ;
+
+/**
+ * The program run by each worker process
+ *
+ * Arguments: shared memory file, ring capacity, scripts path,
+ * module and method
+ */
+static const char *workerProgram = R"(
+import sys, os, struct, marshal, mmap, importlib, inspect, traceback
+
+shm, cap, path, module, method = sys.argv[1:6]
+cap = int(cap)
+bell = 3
+sys.path.insert(0, path)
+
+fd = os.open(shm, os.O_RDWR)
+buf = mmap.mmap(fd, 0)
+os.close(fd)
+
+HDR = 64
+REQUEST = 0
+RESPONSE = HDR + cap
+# Version 2 of the marshal format has no references between objects
+VERSION = 2
+
+def get(base, pos, n):
+    off = pos % cap
+    first = min(n, cap - off)
+    data = buf[base + HDR + off:base + HDR + off + first]
+    if n > first:
+        data += buf[base + HDR:base + HDR + n - first]
+    return data
+
+def put(base, pos, data):
+    off = pos % cap
+    first = min(len(data), cap - off)
+    buf[base + HDR + off:base + HDR + off + first] = data[:first]
+    if len(data) > first:
+        buf[base + HDR:base + HDR + len(data) - first] = data[first:]
+
+def receive():
+    if not os.read(bell, 1):
+        sys.exit(0)
+    head, tail = struct.unpack_from('=QQ', buf, REQUEST)
+    n, = struct.unpack('=I', get(REQUEST, tail, 4))
+    data = get(REQUEST, tail + 4, n)
+    struct.pack_into('=Q', buf, REQUEST + 8, tail + 4 + n)
+    return data
+
+def send(data):
+    if len(data) + 4 > cap:
+        data = marshal.dumps((1, 'The result of the script is larger than the worker buffer size'), VERSION)
+    head, = struct.unpack_from('=Q', buf, RESPONSE)
+    put(RESPONSE, head, struct.pack('=I', len(data)) + data)
+    struct.pack_into('=Q', buf, RESPONSE, head + 4 + len(data))
+    os.write(bell, b'.')
+
+# Types of datapoint values marshal writes as they are
+NATIVE = {int, float, str, bytes, bool, type(None), dict, list}
+
+def plain(value):
+    # Values marshal does not write or writes as bytes, such as NumPy arrays and scalars
+    if isinstance(value, dict):
+        return {plain(k): plain(v) for k, v in value.items()}
+    if isinstance(value, (list, tuple)):
+        return [plain(v) for v in value]
+    if hasattr(value, 'tolist'):
+        return plain(value.tolist())
+    for kind in (bool, int, float, str, bytes):
+        if isinstance(value, kind):
+            return kind(value)
+    if value is None:
+        return None
+    raise TypeError('Unable to convert %s' % type(value).__name__)
+
+def row(reading, origins):
+    if not isinstance(reading, dict):
+        raise TypeError('Each element returned by the script must be a Python DICT')
+    values = reading.get('reading')
+    if isinstance(values, dict) and not NATIVE.issuperset(map(type, values.values())):
+        values = plain(values)
+    return (origins.get(id(reading), -1), reading.get('asset_code'), reading.get('id'),
+            reading.get('timestamp'), reading.get('user_timestamp'), values)
+
+func = None
+while True:
+    message = marshal.loads(receive())
+    try:
+        if isinstance(message, dict):
+            script = importlib.import_module(module)
+            func = getattr(script, method)
+            configure = getattr(script, 'set_filter_config', None)
+            if configure is not None and not configure({'config': message['config']}):
+                raise RuntimeError('set_filter_config failed')
+            result = (0, None)
+        else:
+            # The position of the dicts passed to the script, kept alive to keep their id
+            inputs = list(message)
+            origins = {id(r): i for i, r in enumerate(inputs)}
+            ret = func(message)
+            if ret is None:
+                ret = []
+            elif inspect.isgenerator(ret):
+                ret = [r for r in ret if r is not None]
+            if not isinstance(ret, list):
+                raise TypeError('The return type of the python35 filter function should be a list of readings.')
+            result = (0, [row(r, origins) for r in ret])
+            del inputs
+        try:
+            data = marshal.dumps(result, VERSION)
+        except ValueError:
+            data = marshal.dumps(plain(result), VERSION)
+        send(data)
+    except Exception:
+        send(marshal.dumps((1, traceback.format_exc()), VERSION))
+)";
+
+/**
+ * Return true for the datapoints that are not sent to the workers
+ */
+static bool isHidden(DatapointValue& value)
+{
+	return value.getType() == DatapointValue::T_IMAGE ||
+		value.getType() == DatapointValue::T_DATABUFFER;
+}
+
+/**
+ * Append an unsigned 32 bit value, marshal uses little endian
+ */
+static void marshalUInt32(string& out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		out += (char)((value >> (8 * i)) & 0xff);
+	}
+}
+
+/**
+ * Set the number of items of a list started at a given offset
+ */
+static void marshalCount(string& out, size_t offset, uint32_t count)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		out[offset + 1 + i] = (char)((count >> (8 * i)) & 0xff);
+	}
+}
+
+/**
+ * Append an integer
+ */
+static void marshalLong(string& out, long value)
+{
+	if (value >= INT32_MIN && value <= INT32_MAX)
+	{
+		out += MARSHAL_INT;
+		marshalUInt32(out, (uint32_t)(int32_t)value);
+		return;
+	}
+
+	// Digits of 15 bits, least significant first, the count has the sign of the value
+	unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+	uint16_t digits[5];
+	int32_t count = 0;
+	while (magnitude)
+	{
+		digits[count++] = magnitude & 0x7fff;
+		magnitude >>= 15;
+	}
+	out += MARSHAL_LONG;
+	marshalUInt32(out, (uint32_t)(value < 0 ? -count : count));
+	for (int32_t i = 0; i < count; i++)
+	{
+		out += (char)(digits[i] & 0xff);
+		out += (char)(digits[i] >> 8);
+	}
+}
+
+/**
+ * Append a floating point value, NaN and infinities included
+ */
+static void marshalDouble(string& out, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	out += MARSHAL_BINARY_FLOAT;
+	for (int i = 0; i < 8; i++)
+	{
+		out += (char)((bits >> (8 * i)) & 0xff);
+	}
+}
+
+/**
+ * Append a string as a str or a bytes object
+ */
+static void marshalString(string& out, const string& str, bool bytes)
+{
+	out += bytes ? MARSHAL_BYTES : MARSHAL_UNICODE;
+	marshalUInt32(out, str.length());
+	out += str;
+}
+
+/**
+ * Append an array of floating point values
+ */
+static void marshalArray(string& out, vector<double> *values)
+{
+	out += MARSHAL_LIST;
+	marshalUInt32(out, values ? values->size() : 0);
+	for (size_t i = 0; values && i < values->size(); i++)
+	{
+		marshalDouble(out, (*values)[i]);
+	}
+}
+
+/**
+ * Append a datapoint value as PythonReading::toPython() converts it
+ *
+ * Images and data buffers nested in dicts and lists are written as None
+ *
+ * @param out		The message
+ * @param value		The value
+ * @param encodeStrings	Strings are bytes objects rather than str objects
+ */
+static void marshalValue(string& out, DatapointValue& value, bool encodeStrings)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			marshalLong(out, value.toInt());
+			break;
+		case DatapointValue::T_FLOAT:
+			marshalDouble(out, value.toDouble());
+			break;
+		case DatapointValue::T_STRING:
+			marshalString(out, value.toStringValue(), encodeStrings);
+			break;
+		case DatapointValue::T_FLOAT_ARRAY:
+			marshalArray(out, value.getDpArr());
+			break;
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			vector<vector<double>*> *rows = value.getDp2DArr();
+			out += MARSHAL_LIST;
+			marshalUInt32(out, rows ? rows->size() : 0);
+			for (size_t i = 0; rows && i < rows->size(); i++)
+			{
+				marshalArray(out, (*rows)[i]);
+			}
+			break;
+		}
+		case DatapointValue::T_DP_DICT:
+		{
+			vector<Datapoint *> *datapoints = value.getDpVec();
+			out += MARSHAL_DICT;
+			for (size_t i = 0; datapoints && i < datapoints->size(); i++)
+			{
+				marshalString(out, (*datapoints)[i]->getName(), false);
+				marshalValue(out, (*datapoints)[i]->getData(), encodeStrings);
+			}
+			out += MARSHAL_NULL;
+			break;
+		}
+		case DatapointValue::T_DP_LIST:
+		{
+			vector<Datapoint *> *datapoints = value.getDpVec();
+			out += MARSHAL_LIST;
+			marshalUInt32(out, datapoints ? datapoints->size() : 0);
+			for (size_t i = 0; datapoints && i < datapoints->size(); i++)
+			{
+				marshalValue(out, (*datapoints)[i]->getData(), encodeStrings);
+			}
+			break;
+		}
+		default:
+			out += MARSHAL_NONE;
+			break;
+	}
+}
+
+/**
+ * Append a reading as the dict the script gets in the shared interpreter
+ *
+ * @param out		The message
+ * @param reading	The reading
+ * @param encodeNames	Use bytes objects for datapoint names and strings
+ */
+static void marshalReading(string& out, Reading *reading, bool encodeNames)
+{
+	out += MARSHAL_DICT;
+	marshalString(out, "reading", false);
+	out += MARSHAL_DICT;
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		if (isHidden(datapoints[i]->getData()))
+		{
+			continue;
+		}
+		marshalString(out, datapoints[i]->getName(), encodeNames);
+		marshalValue(out, datapoints[i]->getData(), encodeNames);
+	}
+	out += MARSHAL_NULL;
+	marshalString(out, "asset_code", false);
+	marshalString(out, reading->getAssetName(), false);
+	marshalString(out, "id", false);
+	marshalLong(out, (long)reading->getId());
+	marshalString(out, "timestamp", false);
+	marshalString(out, reading->getAssetDateTime(), false);
+	marshalString(out, "user_timestamp", false);
+	marshalString(out, reading->getAssetDateUserTime(), false);
+	out += MARSHAL_NULL;
+}
+
+/**
+ * MarshalReader class
+ *
+ * Reads the results written by marshal.dumps() in the workers. Only
+ * the types readings are made of are supported, version 2 of the
+ * format has no references between objects.
+ */
+class MarshalReader
+{
+	public:
+		MarshalReader(const string& data) :
+			m_pos((const uint8_t *)data.data()),
+			m_end((const uint8_t *)data.data() + data.length()) {};
+
+		char		peek()
+				{
+					need(1);
+					return (char)(*m_pos & ~MARSHAL_FLAG_REF);
+				};
+		char		type()
+				{
+					char type = peek();
+					m_pos++;
+					return type;
+				};
+		static bool	isInteger(char type)
+				{
+					return type == MARSHAL_INT || type == MARSHAL_LONG ||
+						type == MARSHAL_TRUE || type == MARSHAL_FALSE;
+				};
+		static bool	isFloat(char type)
+				{
+					return type == MARSHAL_BINARY_FLOAT || type == MARSHAL_FLOAT;
+				};
+		static bool	isString(char type);
+		long		readInt(char type);
+		double		readFloat(char type);
+		std::string	readString(char type);
+		size_t		readSequence();
+		Datapoint	*readDatapoint(const std::string& name);
+		void		readDict(std::vector<Datapoint *>& datapoints);
+		void		skip() { delete readDatapoint(""); };
+
+	private:
+		void		need(size_t length)
+				{
+					if ((size_t)(m_end - m_pos) < length)
+					{
+						throw runtime_error("Truncated result from the Python worker");
+					}
+				};
+		uint32_t	readUInt32();
+		Datapoint	*readList(const std::string& name, size_t count);
+
+	private:
+		const uint8_t	*m_pos;
+		const uint8_t	*m_end;
+};
+
+/**
+ * Return true for the types of str and bytes objects
+ */
+bool MarshalReader::isString(char type)
+{
+	switch (type)
+	{
+		case MARSHAL_BYTES:
+		case MARSHAL_UNICODE:
+		case MARSHAL_INTERNED:
+		case MARSHAL_ASCII:
+		case MARSHAL_ASCII_INTERNED:
+		case MARSHAL_SHORT_ASCII:
+		case MARSHAL_SHORT_ASCII_INTERNED:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Read an unsigned 32 bit value
+ */
+uint32_t MarshalReader::readUInt32()
+{
+	need(4);
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		value |= (uint32_t)m_pos[i] << (8 * i);
+	}
+	m_pos += 4;
+	return value;
+}
+
+/**
+ * Read an integer or a boolean
+ *
+ * @param type	The type read by type()
+ */
+long MarshalReader::readInt(char type)
+{
+	if (type == MARSHAL_TRUE || type == MARSHAL_FALSE)
+	{
+		return type == MARSHAL_TRUE;
+	}
+	if (type == MARSHAL_INT)
+	{
+		return (int32_t)readUInt32();
+	}
+
+	int32_t count = (int32_t)readUInt32();
+	size_t digits = count < 0 ? -(int64_t)count : count;
+	// 64 bits are 4 digits of 15 bits and 4 bits of a fifth one
+	if (digits > 5)
+	{
+		throw runtime_error("An integer returned by the script is out of range");
+	}
+	need(2 * digits);
+	unsigned long magnitude = 0;
+	for (size_t i = 0; i < digits; i++)
+	{
+		unsigned long digit = m_pos[2 * i] | (m_pos[2 * i + 1] << 8);
+		if (i == 4 && digit >= 16)
+		{
+			throw runtime_error("An integer returned by the script is out of range");
+		}
+		magnitude |= digit << (15 * i);
+	}
+	m_pos += 2 * digits;
+	return count < 0 ? -(long)magnitude : (long)magnitude;
+}
+
+/**
+ * Read a floating point value
+ *
+ * @param type	The type read by type()
+ */
+double MarshalReader::readFloat(char type)
+{
+	if (type == MARSHAL_FLOAT)
+	{
+		need(1);
+		size_t length = *m_pos++;
+		need(length);
+		string text((const char *)m_pos, length);
+		m_pos += length;
+		return strtod(text.c_str(), NULL);
+	}
+
+	need(8);
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		bits |= (uint64_t)m_pos[i] << (8 * i);
+	}
+	m_pos += 8;
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/**
+ * Read a str or bytes object
+ *
+ * @param type	The type read by type()
+ */
+string MarshalReader::readString(char type)
+{
+	size_t length;
+	if (type == MARSHAL_SHORT_ASCII || type == MARSHAL_SHORT_ASCII_INTERNED)
+	{
+		need(1);
+		length = *m_pos++;
+	}
+	else
+	{
+		length = readUInt32();
+	}
+	need(length);
+	string str((const char *)m_pos, length);
+	m_pos += length;
+	return str;
+}
+
+/**
+ * Read the start of a list or tuple
+ *
+ * @return	The number of items
+ */
+size_t MarshalReader::readSequence()
+{
+	char sequence = type();
+	if (sequence == MARSHAL_SMALL_TUPLE)
+	{
+		need(1);
+		return *m_pos++;
+	}
+	if (sequence != MARSHAL_LIST && sequence != MARSHAL_TUPLE)
+	{
+		throw runtime_error("Badly formed result from the Python worker");
+	}
+	return readUInt32();
+}
+
+/**
+ * Read the items of a dict as datapoints, None values are left out
+ *
+ * @param datapoints	The datapoints read, added to on errors too
+ */
+void MarshalReader::readDict(vector<Datapoint *>& datapoints)
+{
+	while (peek() != MARSHAL_NULL)
+	{
+		char key = type();
+		if (!isString(key))
+		{
+			throw runtime_error("The names of the datapoints must be strings");
+		}
+		string name = readString(key);
+		Datapoint *dp = readDatapoint(name);
+		if (dp)
+		{
+			datapoints.push_back(dp);
+		}
+	}
+	m_pos++;
+}
+
+/**
+ * Read a value as a datapoint
+ *
+ * @param name	The name of the datapoint
+ * @return	The new datapoint or NULL for None
+ */
+Datapoint *MarshalReader::readDatapoint(const string& name)
+{
+	char value = type();
+	if (isInteger(value))
+	{
+		DatapointValue data(readInt(value));
+		return new Datapoint(name, data);
+	}
+	if (isFloat(value))
+	{
+		DatapointValue data(readFloat(value));
+		return new Datapoint(name, data);
+	}
+	if (isString(value))
+	{
+		DatapointValue data(readString(value));
+		return new Datapoint(name, data);
+	}
+
+	switch (value)
+	{
+		case MARSHAL_NONE:
+			return NULL;
+		case MARSHAL_DICT:
+		{
+			vector<Datapoint *> *values = new vector<Datapoint *>;
+			try {
+				readDict(*values);
+			} catch (exception&) {
+				for (size_t i = 0; i < values->size(); i++)
+				{
+					delete (*values)[i];
+				}
+				delete values;
+				throw;
+			}
+			DatapointValue data(values, true);
+			return new Datapoint(name, data);
+		}
+		case MARSHAL_SMALL_TUPLE:
+			need(1);
+			return readList(name, *m_pos++);
+		case MARSHAL_LIST:
+		case MARSHAL_TUPLE:
+			return readList(name, readUInt32());
+		default:
+			throw runtime_error(string("Unsupported type '") + value + "' in the result of the Python worker");
+	}
+}
+
+/**
+ * Read the items of a list or tuple as a datapoint
+ *
+ * Lists of numbers are arrays, lists of lists of numbers are two
+ * dimensional arrays, others are lists of datapoints.
+ *
+ * @param name	The name of the datapoint
+ * @param count	The number of items
+ * @return	The new datapoint
+ */
+Datapoint *MarshalReader::readList(const string& name, size_t count)
+{
+	const uint8_t *items = m_pos;
+	vector<double> numbers;
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		char item = peek();
+		if (!isInteger(item) && !isFloat(item))
+		{
+			break;
+		}
+		m_pos++;
+		numbers.push_back(isFloat(item) ? readFloat(item) : (double)readInt(item));
+	}
+	if (i == count)
+	{
+		DatapointValue data(numbers);
+		return new Datapoint(name, data);
+	}
+
+	// Not only numbers, read the items again as datapoints
+	m_pos = items;
+	vector<Datapoint *> *values = new vector<Datapoint *>;
+	bool arrays = true;
+	try {
+		for (i = 0; i < count; i++)
+		{
+			Datapoint *dp = readDatapoint(to_string(i));
+			if (dp)
+			{
+				values->push_back(dp);
+			}
+			arrays = arrays && dp && dp->getData().getType() == DatapointValue::T_FLOAT_ARRAY;
+		}
+	} catch (exception&) {
+		for (size_t n = 0; n < values->size(); n++)
+		{
+			delete (*values)[n];
+		}
+		delete values;
+		throw;
+	}
+
+	if (arrays)
+	{
+		vector<vector<double> *> *rows = new vector<vector<double> *>;
+		for (size_t n = 0; n < values->size(); n++)
+		{
+			rows->push_back(new vector<double>(*(*values)[n]->getData().getDpArr()));
+			delete (*values)[n];
+		}
+		delete values;
+		DatapointValue data(rows);
+		return new Datapoint(name, data);
+	}
+	DatapointValue data(values, false);
+	return new Datapoint(name, data);
+}
+
+/**
+ * Parse a timestamp as set by the filter, "YYYY-MM-DD HH:MM:SS.ffffff" UTC
+ */
+static bool parseTimestamp(const string& str, struct timeval& tv)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	const char *end = strptime(str.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+	if (!end)
+	{
+		return false;
+	}
+	tv.tv_sec = timegm(&tm);
+	tv.tv_usec = 0;
+	if (*end == '.')
+	{
+		long scale = 100000;
+		for (end++; *end >= '0' && *end <= '9'; end++)
+		{
+			tv.tv_usec += (*end - '0') * scale;
+			scale /= 10;
+		}
+	}
+	return true;
+}
+
+/**
+ * Create a reading from a row returned by a worker: position of the
+ * dict passed to the script or -1, asset code, id, timestamp, user
+ * timestamp and datapoints
+ *
+ * @param reader	The result of the worker
+ * @param origin	Set to the position of the dict passed to the script
+ * @throw		runtime_error for badly formed readings
+ */
+static Reading *readingFromMarshal(MarshalReader& reader, long& origin)
+{
+	if (reader.readSequence() != 6)
+	{
+		throw runtime_error("Badly formed result from the Python worker");
+	}
+	char type = reader.type();
+	if (!MarshalReader::isInteger(type))
+	{
+		throw runtime_error("Badly formed result from the Python worker");
+	}
+	origin = reader.readInt(type);
+
+	type = reader.type();
+	if (!MarshalReader::isString(type))
+	{
+		throw runtime_error("Unable to parse the asset code value. Asset codes should be a string.");
+	}
+	string asset = reader.readString(type);
+
+	bool hasId = MarshalReader::isInteger(reader.peek());
+	unsigned long id = hasId ? (unsigned long)reader.readInt(reader.type()) : 0;
+	if (!hasId)
+	{
+		reader.skip();
+	}
+
+	string timestamps[2];
+	bool hasTimestamp[2];
+	for (int i = 0; i < 2; i++)
+	{
+		hasTimestamp[i] = MarshalReader::isString(reader.peek());
+		if (hasTimestamp[i])
+		{
+			timestamps[i] = reader.readString(reader.type());
+		}
+		else
+		{
+			reader.skip();
+		}
+	}
+
+	if (reader.type() != MARSHAL_DICT)
+	{
+		throw runtime_error("The reading of each element must be a Python DICT");
+	}
+	vector<Datapoint *> datapoints;
+	try {
+		reader.readDict(datapoints);
+	} catch (exception&) {
+		for (size_t i = 0; i < datapoints.size(); i++)
+		{
+			delete datapoints[i];
+		}
+		throw;
+	}
+	Reading *reading = new Reading(asset, datapoints);
+
+	if (hasId)
+	{
+		reading->setId(id);
+	}
+	struct timeval tv;
+	if (hasTimestamp[0] && parseTimestamp(timestamps[0], tv))
+	{
+		reading->setTimestamp(tv);
+	}
+	if (hasTimestamp[1] && parseTimestamp(timestamps[1], tv))
+	{
+		reading->setUserTimestamp(tv);
+	}
+
+	return reading;
+}
+
+/**
+ * Copy the datapoints that were not sent to the worker from a reading
+ * to the reading the script returned for it, unless the script has
+ * added a datapoint of the same name
+ */
+static void copyHidden(Reading *from, Reading *to)
+{
+	const vector<Datapoint *>& points = from->getReadingData();
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const string& name = points[i]->getName();
+		if (isHidden(points[i]->getData()) && !to->getDatapoint(name))
+		{
+			to->addDatapoint(new Datapoint(name, points[i]->getData()));
+		}
+	}
+}
+
+PythonWorkerPool::PythonWorkerPool() : m_capacity(0),
+				       m_timeout(0),
+				       m_encodeNames(true),
+				       m_running(false),
+				       m_supervisor(NULL)
+{
+	m_logger = Logger::getLogger();
+}
+
+PythonWorkerPool::~PythonWorkerPool()
+{
+	stop();
+}
+
+/**
+ * Start the worker processes
+ *
+ * @param name		The filter name
+ * @param python	The Python executable, as the interpreter of the service
+ * @param count		Number of workers
+ * @param bufferSize	Size in bytes of each ring buffer
+ * @param timeout	Time in milliseconds a worker may take to
+ *			process a set of readings, 0 for no limit
+ * @param scriptPath	Directory of the filter scripts
+ * @param module	The script module
+ * @param method	The filter function in the module
+ * @param config	The filter 'config' item passed to set_filter_config
+ * @param encodeNames	Use bytes objects for datapoint names
+ * @return		True if all the workers are running
+ */
+bool PythonWorkerPool::start(const string& name,
+			     const string& python,
+			     int count,
+			     size_t bufferSize,
+			     unsigned long timeout,
+			     const string& scriptPath,
+			     const string& module,
+			     const string& method,
+			     const string& config,
+			     bool encodeNames)
+{
+	stop();
+
+	lock_guard<mutex> guard(m_mutex);
+	m_name = name;
+	m_python = python;
+	m_capacity = bufferSize;
+	m_timeout = timeout;
+	m_scriptPath = scriptPath;
+	m_module = module;
+	m_method = method;
+	m_config = config;
+	m_encodeNames = encodeNames;
+
+	for (int i = 0; i < count; i++)
+	{
+		Worker worker;
+		worker.state = IDLE;
+		worker.pid = -1;
+		worker.shm = NULL;
+		worker.bell = -1;
+		worker.starts = 0;
+		if (!spawn(worker) || !configureWorker(worker))
+		{
+			terminate(worker);
+			for (size_t n = 0; n < m_workers.size(); n++)
+			{
+				terminate(m_workers[n]);
+			}
+			m_workers.clear();
+			return false;
+		}
+		m_workers.push_back(worker);
+	}
+
+	m_running = true;
+	m_supervisor = new thread(&PythonWorkerPool::supervise, this);
+
+	m_logger->info("Filter %s started %d Python worker processes", m_name.c_str(), count);
+	return true;
+}
+
+/**
+ * Stop all the worker processes, once the batches they
+ * are processing are complete
+ */
+void PythonWorkerPool::stop()
+{
+	thread *supervisor = NULL;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_running = false;
+		supervisor = m_supervisor;
+		m_supervisor = NULL;
+		m_cv.notify_all();
+	}
+	if (supervisor)
+	{
+		supervisor->join();
+		delete supervisor;
+	}
+
+	unique_lock<mutex> guard(m_mutex);
+	bool busy = true;
+	while (busy)
+	{
+		busy = false;
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			busy = busy || m_workers[i].state == BUSY;
+		}
+		if (busy)
+		{
+			m_cv.wait(guard);
+		}
+	}
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		terminate(m_workers[i]);
+	}
+	m_workers.clear();
+}
+
+/**
+ * Return true if the script runs in the worker processes,
+ * that is if a worker is running or being started again
+ */
+bool PythonWorkerPool::isRunning()
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		if (m_workers[i].state != DEAD)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Take the idle workers for a batch, waiting if they are all busy
+ * or being started again
+ *
+ * @param readings	The number of readings of the batch, the
+ *			maximum number of workers taken
+ * @return		The indexes of the workers taken, none if
+ *			no worker is running
+ */
+vector<size_t> PythonWorkerPool::claim(size_t readings)
+{
+	vector<size_t> claimed;
+	unique_lock<mutex> guard(m_mutex);
+	while (m_running)
+	{
+		bool alive = false;
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			if (m_workers[i].state == IDLE && claimed.size() < readings)
+			{
+				m_workers[i].state = BUSY;
+				claimed.push_back(i);
+			}
+			alive = alive || m_workers[i].state != DEAD;
+		}
+		if (!claimed.empty() || !alive)
+		{
+			break;
+		}
+		m_cv.wait(guard);
+	}
+	return claimed;
+}
+
+/**
+ * Return the workers taken by claim(), those that failed are
+ * started again by the supervisor thread
+ *
+ * @param workers	The indexes of the workers
+ * @param failed	Whether each worker has failed
+ */
+void PythonWorkerPool::release(const vector<size_t>& workers, const vector<bool>& failed)
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		m_workers[workers[i]].state = failed[i] ? RESTART : IDLE;
+	}
+	m_cv.notify_all();
+}
+
+/**
+ * Supervisor thread: start the failed workers again, so that
+ * the batches do not wait for a new Python process
+ */
+void PythonWorkerPool::supervise()
+{
+	unique_lock<mutex> guard(m_mutex);
+	while (m_running)
+	{
+		Worker *worker = NULL;
+		for (size_t i = 0; i < m_workers.size() && !worker; i++)
+		{
+			if (m_workers[i].state == RESTART)
+			{
+				worker = &m_workers[i];
+			}
+		}
+		if (!worker)
+		{
+			m_cv.wait(guard);
+			continue;
+		}
+
+		// The worker is not used by the batches until its state changes
+		guard.unlock();
+		m_logger->error("Filter %s Python worker process %d has failed, starting a new one",
+				m_name.c_str(), worker->pid);
+		terminate(*worker);
+		bool started = spawn(*worker) && configureWorker(*worker);
+		if (!started)
+		{
+			m_logger->error("Filter %s unable to restart a Python worker process", m_name.c_str());
+			terminate(*worker);
+		}
+		guard.lock();
+
+		worker->state = started ? IDLE : DEAD;
+		bool alive = false;
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			alive = alive || m_workers[i].state != DEAD;
+		}
+		if (!alive)
+		{
+			m_logger->warn("Filter %s has no Python worker process left, "
+					"the script will run in the service", m_name.c_str());
+		}
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Start a worker process and create its shared memory
+ */
+bool PythonWorkerPool::spawn(Worker& worker)
+{
+	static atomic<unsigned long> segments(0);
+
+	worker.shmName = "/fledge-python35-" + to_string(getpid()) + "-" + to_string(segments++);
+	size_t size = 2 * (sizeof(RingHeader) + m_capacity);
+	int fd = shm_open(worker.shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+	{
+		m_logger->error("Filter %s unable to create shared memory %s: %s",
+				m_name.c_str(), worker.shmName.c_str(), strerror(errno));
+		return false;
+	}
+	if (ftruncate(fd, size) < 0 ||
+	    (worker.shm = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		m_logger->error("Filter %s unable to map shared memory: %s", m_name.c_str(), strerror(errno));
+		worker.shm = NULL;
+		close(fd);
+		return false;
+	}
+	close(fd);
+
+	int bells[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, bells) < 0)
+	{
+		m_logger->error("Filter %s unable to create worker socket: %s", m_name.c_str(), strerror(errno));
+		return false;
+	}
+	worker.bell = bells[0];
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, bells[1], WORKER_BELL_FD);
+
+	// POSIX shared memory objects are files of /dev/shm on Linux
+	string shmPath = "/dev/shm" + worker.shmName;
+	string capacity = to_string(m_capacity);
+	char python[32];
+	snprintf(python, sizeof(python), "python%d.%d", PY_MAJOR_VERSION, PY_MINOR_VERSION);
+	const char *argv[] = {
+		m_python.c_str(), "-c", workerProgram,
+		shmPath.c_str(), capacity.c_str(), m_scriptPath.c_str(),
+		m_module.c_str(), m_method.c_str(),
+		NULL
+	};
+
+	int ret = posix_spawn(&worker.pid, argv[0], &actions, NULL, (char * const *)argv, environ);
+	if (ret == ENOENT)
+	{
+		// Search the path for the same version
+		argv[0] = python;
+		ret = posix_spawnp(&worker.pid, argv[0], &actions, NULL, (char * const *)argv, environ);
+	}
+	if (ret == ENOENT)
+	{
+		argv[0] = "python3";
+		ret = posix_spawnp(&worker.pid, argv[0], &actions, NULL, (char * const *)argv, environ);
+	}
+	posix_spawn_file_actions_destroy(&actions);
+	close(bells[1]);
+
+	if (ret != 0)
+	{
+		m_logger->error("Filter %s unable to start a Python worker process: %s",
+				m_name.c_str(), strerror(ret));
+		worker.pid = -1;
+		return false;
+	}
+	worker.starts++;
+
+	return true;
+}
+
+/**
+ * Pass the filter configuration to a new worker and wait
+ * for the script to be loaded
+ */
+bool PythonWorkerPool::configureWorker(Worker& worker)
+{
+	string message;
+	message += MARSHAL_DICT;
+	marshalString(message, "config", false);
+	marshalString(message, m_config, false);
+	message += MARSHAL_NULL;
+
+	// Importing the script may take longer than processing readings
+	unsigned long timeout = m_timeout;
+	if (timeout && timeout < WORKER_START_TIMEOUT)
+	{
+		timeout = WORKER_START_TIMEOUT;
+	}
+
+	string response;
+	if (!send(worker, message) || !receive(worker, response, timeout))
+	{
+		m_logger->error("Filter %s Python worker process %d failed to start", m_name.c_str(), worker.pid);
+		return false;
+	}
+
+	string error;
+	try {
+		MarshalReader reader(response);
+		if (reader.readSequence() != 2)
+		{
+			throw runtime_error("Badly formed result from the Python worker");
+		}
+		char status = reader.type();
+		if (!MarshalReader::isInteger(status))
+		{
+			throw runtime_error("Badly formed result from the Python worker");
+		}
+		if (reader.readInt(status))
+		{
+			char type = reader.type();
+			error = MarshalReader::isString(type) ? reader.readString(type) : "Unknown error";
+		}
+	} catch (exception& e) {
+		error = e.what();
+	}
+	if (!error.empty())
+	{
+		m_logger->error("Filter %s Python worker process failed to load the script: %s",
+				m_name.c_str(), error.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Stop a worker process and release its shared memory
+ */
+void PythonWorkerPool::terminate(Worker& worker)
+{
+	if (worker.bell >= 0)
+	{
+		// The worker exits when the socket is closed
+		close(worker.bell);
+		worker.bell = -1;
+	}
+	if (worker.pid > 0)
+	{
+		int status;
+		int waited = 0;
+		while (waitpid(worker.pid, &status, WNOHANG) == 0)
+		{
+			if (waited++ == 100)
+			{
+				kill(worker.pid, SIGKILL);
+				waitpid(worker.pid, &status, 0);
+				break;
+			}
+			usleep(10000);
+		}
+		worker.pid = -1;
+	}
+	if (worker.shm)
+	{
+		munmap(worker.shm, 2 * (sizeof(RingHeader) + m_capacity));
+		worker.shm = NULL;
+		shm_unlink(worker.shmName.c_str());
+	}
+}
+
+/**
+ * Copy data into a ring buffer at a given position
+ */
+void PythonWorkerPool::ringWrite(RingHeader *ring, uint64_t pos, const void *data, size_t len)
+{
+	uint8_t *base = (uint8_t *)(ring + 1);
+	size_t offset = pos % m_capacity;
+	size_t first = len < m_capacity - offset ? len : m_capacity - offset;
+	memcpy(base + offset, data, first);
+	memcpy(base, (const uint8_t *)data + first, len - first);
+}
+
+/**
+ * Copy data from a ring buffer at a given position
+ */
+void PythonWorkerPool::ringRead(RingHeader *ring, uint64_t pos, void *data, size_t len)
+{
+	uint8_t *base = (uint8_t *)(ring + 1);
+	size_t offset = pos % m_capacity;
+	size_t first = len < m_capacity - offset ? len : m_capacity - offset;
+	memcpy(data, base + offset, first);
+	memcpy((uint8_t *)data + first, base, len - first);
+}
+
+/**
+ * Send a message to a worker
+ *
+ * @return	False if the message does not fit or the worker has exited
+ */
+bool PythonWorkerPool::send(Worker& worker, const string& message)
+{
+	RingHeader *ring = requestRing(worker);
+	uint64_t head = ring->head;
+	uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t len = message.length();
+	if (len + sizeof(len) > m_capacity - (head - tail))
+	{
+		return false;
+	}
+
+	ringWrite(ring, head, &len, sizeof(len));
+	ringWrite(ring, head + sizeof(len), message.c_str(), len);
+	__atomic_store_n(&ring->head, head + sizeof(len) + len, __ATOMIC_RELEASE);
+
+	char bell = '.';
+	return ::send(worker.bell, &bell, 1, MSG_NOSIGNAL) == 1;
+}
+
+/**
+ * Wait for the next message from a worker
+ *
+ * A worker that does not respond in time is killed, the supervisor
+ * thread then starts a new one as for a worker that has exited.
+ *
+ * @param worker	The worker
+ * @param message	The message received
+ * @param timeout	Time to wait in milliseconds, 0 for no limit
+ * @return		False if the worker has exited or was killed
+ */
+bool PythonWorkerPool::receive(Worker& worker, string& message, unsigned long timeout)
+{
+	// Wait for the doorbell, sent once the message is in the ring
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() +
+							chrono::milliseconds(timeout);
+	struct pollfd bellFd;
+	bellFd.fd = worker.bell;
+	bellFd.events = POLLIN;
+	int ready;
+	do {
+		int wait = -1;
+		if (timeout)
+		{
+			long remaining = chrono::duration_cast<chrono::milliseconds>(deadline -
+							chrono::steady_clock::now()).count();
+			wait = remaining > 0 ? remaining : 0;
+		}
+		ready = poll(&bellFd, 1, wait);
+	} while (ready < 0 && errno == EINTR);
+	if (ready == 0)
+	{
+		m_logger->error("Filter %s Python worker process %d has not responded within %lu ms "
+				"and is stopped, the readings it was processing are discarded",
+				m_name.c_str(), worker.pid, timeout);
+		if (worker.pid > 0)
+		{
+			kill(worker.pid, SIGKILL);
+		}
+		return false;
+	}
+	if (ready < 0)
+	{
+		return false;
+	}
+
+	char bell;
+	ssize_t n;
+	while ((n = recv(worker.bell, &bell, 1, 0)) < 0 && errno == EINTR)
+		;
+	if (n != 1)
+	{
+		return false;
+	}
+
+	RingHeader *ring = responseRing(worker);
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = ring->tail;
+	uint32_t len;
+	if (head - tail < sizeof(len))
+	{
+		return false;
+	}
+	ringRead(ring, tail, &len, sizeof(len));
+	if (len + sizeof(len) > head - tail)
+	{
+		return false;
+	}
+	message.resize(len);
+	ringRead(ring, tail + sizeof(len), &message[0], len);
+	__atomic_store_n(&ring->tail, tail + sizeof(len) + len, __ATOMIC_RELEASE);
+	return true;
+}
+
+/**
+ * Run the script on a set of readings in the worker processes
+ *
+ * The readings of a message that a worker fails to process, and of
+ * the following messages of that worker, are dropped, the results
+ * of the other messages are kept in order.
+ *
+ * @param readings	The readings to filter, unchanged
+ * @param results	Returns the new readings
+ * @return		PROCESSED, FAILED if the readings can not be sent
+ *			to the workers or UNAVAILABLE if no worker is running
+ */
+PythonWorkerPool::Status PythonWorkerPool::process(const vector<Reading *>& readings,
+						   vector<Reading *>& results)
+{
+	if (readings.empty())
+	{
+		return PROCESSED;
+	}
+
+	vector<size_t> workers = claim(readings.size());
+	size_t count = workers.size();
+	if (!count)
+	{
+		return UNAVAILABLE;
+	}
+
+	// Split the readings in one message per worker, or more
+	// if they do not fit in the ring buffers
+	vector<string> messages;
+	// The first reading of each message
+	vector<size_t> firsts;
+	size_t perWorker = (readings.size() + count - 1) / count;
+	size_t limit = m_capacity - sizeof(uint32_t);
+	// A list and its number of items
+	size_t header = 1 + sizeof(uint32_t);
+	string message;
+	string record;
+	size_t inMessage = 0;
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		record.clear();
+		marshalReading(record, readings[i], m_encodeNames);
+		if (record.length() + header > limit)
+		{
+			m_logger->error("Filter %s, a reading of asset %s is larger than the worker buffer size",
+					m_name.c_str(), readings[i]->getAssetName().c_str());
+			release(workers, vector<bool>(count, false));
+			return FAILED;
+		}
+		if (inMessage && (inMessage >= perWorker || message.length() + record.length() > limit))
+		{
+			marshalCount(message, 0, inMessage);
+			messages.push_back(message);
+			inMessage = 0;
+		}
+		if (!inMessage)
+		{
+			message.clear();
+			message += MARSHAL_LIST;
+			marshalUInt32(message, 0);
+			firsts.push_back(i);
+		}
+		message += record;
+		inMessage++;
+	}
+	marshalCount(message, 0, inMessage);
+	messages.push_back(message);
+	firsts.push_back(readings.size());
+
+	results.reserve(results.size() + readings.size());
+	vector<bool> busy(count, false);
+	vector<bool> failedWorker(count, false);
+	size_t dropped = 0;
+
+	// Message i is processed by worker i % count, one at a time
+	for (size_t i = 0; i < messages.size() && i < count; i++)
+	{
+		if (send(m_workers[workers[i]], messages[i]))
+		{
+			busy[i] = true;
+		}
+		else
+		{
+			failedWorker[i] = true;
+		}
+	}
+
+	vector<Reading *> chunk;
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		size_t w = i % count;
+		size_t first = firsts[i];
+		size_t sent = firsts[i + 1] - first;
+		if (!busy[w])
+		{
+			// The worker has failed on a previous message
+			dropped += sent;
+			continue;
+		}
+		busy[w] = false;
+
+		string response;
+		if (!receive(m_workers[workers[w]], response, m_timeout))
+		{
+			failedWorker[w] = true;
+			dropped += sent;
+			continue;
+		}
+
+		bool failed = false;
+		chunk.clear();
+		try {
+			MarshalReader reader(response);
+			if (reader.readSequence() != 2)
+			{
+				throw runtime_error("Badly formed result from the Python worker");
+			}
+			char status = reader.type();
+			if (!MarshalReader::isInteger(status))
+			{
+				throw runtime_error("Badly formed result from the Python worker");
+			}
+			if (reader.readInt(status))
+			{
+				char type = reader.type();
+				m_logger->error("Python error in worker process of filter %s: %s",
+						m_name.c_str(),
+						MarshalReader::isString(type) ? reader.readString(type).c_str() : "");
+				failed = true;
+			}
+			else
+			{
+				size_t rows = reader.readSequence();
+				for (size_t r = 0; r < rows; r++)
+				{
+					long origin;
+					Reading *reading = readingFromMarshal(reader, origin);
+					chunk.push_back(reading);
+					if (origin >= 0 && (size_t)origin < sent)
+					{
+						copyHidden(readings[first + origin], reading);
+					}
+				}
+			}
+		} catch (exception &e) {
+			m_logger->error("Badly formed reading in list returned by the Python script: %s", e.what());
+			failed = true;
+		}
+
+		if (failed)
+		{
+			for (size_t r = 0; r < chunk.size(); r++)
+			{
+				delete chunk[r];
+			}
+			dropped += sent;
+		}
+		else
+		{
+			results.insert(results.end(), chunk.begin(), chunk.end());
+		}
+
+		// Next message for this worker
+		if (i + count < messages.size())
+		{
+			if (send(m_workers[workers[w]], messages[i + count]))
+			{
+				busy[w] = true;
+			}
+			else
+			{
+				failedWorker[w] = true;
+			}
+		}
+	}
+
+	// The workers that have exited are replaced by the supervisor thread
+	release(workers, failedWorker);
+
+	if (dropped)
+	{
+		m_logger->warn("Filter %s discards %lu of %lu readings that its Python worker processes failed to process",
+				m_name.c_str(), (unsigned long)dropped, (unsigned long)readings.size());
+	}
+	return PROCESSED;
+}
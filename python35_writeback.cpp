@@ -0,0 +1,375 @@
+/*
+ * Fledge "Python 3.5" filter copy-on-write of readings.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+
+#include <string>
+#include <stdexcept>
+#include <pythonreading.h>
+#include <python35_writeback.h>
+#include <python35_buffers.h>
+
+// Keys of the reading dict, as set by PythonReading::toPython(true, ...)
+#define READING_KEY	"reading"
+#define ASSET_CODE_KEY	"asset_code"
+
+using namespace std;
+
+/**
+ * Return the datapoint name of a key of the reading dict
+ */
+static bool keyName(PyObject *key, string& name)
+{
+	if (PyBytes_Check(key))
+	{
+		name.assign(PyBytes_AS_STRING(key), PyBytes_GET_SIZE(key));
+		return true;
+	}
+	Py_ssize_t len;
+	const char *str = PyUnicode_Check(key) ? PyUnicode_AsUTF8AndSize(key, &len) : NULL;
+	if (!str)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	name.assign(str, len);
+	return true;
+}
+
+/**
+ * Return true for values the script can not modify in place
+ */
+bool PythonWriteBack::isImmutable(PyObject *value)
+{
+	return PyLong_CheckExact(value) ||
+		PyFloat_CheckExact(value) ||
+		PyUnicode_CheckExact(value) ||
+		PyBytes_CheckExact(value) ||
+		PyBool_Check(value) ||
+		value == Py_None;
+}
+
+/**
+ * Keep the items of a dict passed to the script
+ *
+ * @param reading	The input reading
+ * @param dict		The dict created for the reading
+ */
+void PythonWriteBack::track(Reading *reading, PyObject *dict)
+{
+	PyObject *items = PyDict_Copy(dict);
+	PyObject *datapoints = items ? PyDict_GetItemString(items, READING_KEY) : NULL;
+	PyObject *copy = datapoints && PyDict_Check(datapoints) ? PyDict_Copy(datapoints) : NULL;
+	if (!copy)
+	{
+		// The reading will not be reused
+		Py_XDECREF(items);
+		PyErr_Clear();
+		return;
+	}
+
+	Py_INCREF(dict);
+	Snapshot snapshot = { reading, dict, items, copy };
+	m_dicts[dict] = m_snapshots.size();
+	m_snapshots.push_back(snapshot);
+}
+
+/**
+ * Return the input reading of a dict returned by the script,
+ * updated with the changes made by the script
+ *
+ * @param dict	A dict returned by the script
+ * @return	The input reading or NULL if a new reading
+ *		must be created from the dict
+ * @throw	exception for badly formed datapoints
+ */
+Reading *PythonWriteBack::reuse(PyObject *dict)
+{
+	unordered_map<PyObject *, size_t>::const_iterator it = m_dicts.find(dict);
+	if (it == m_dicts.end())
+	{
+		return NULL;
+	}
+	Snapshot& snapshot = m_snapshots[it->second];
+	if (m_reused.count(snapshot.reading) || !update(snapshot))
+	{
+		return NULL;
+	}
+	m_reused.insert(snapshot.reading);
+	return snapshot.reading;
+}
+
+/**
+ * Return the input reading a dict was created for
+ *
+ * @param dict	A dict returned by the script
+ * @return	The input reading or NULL for other objects
+ */
+Reading *PythonWriteBack::getReading(PyObject *dict) const
+{
+	unordered_map<PyObject *, size_t>::const_iterator it = m_dicts.find(dict);
+	return it == m_dicts.end() ? NULL : m_snapshots[it->second].reading;
+}
+
+/**
+ * Apply the changes made by the script to the dict of a reading
+ *
+ * @return	False if items other than the asset code or the
+ *		datapoints have changed, the reading is not updated
+ */
+bool PythonWriteBack::update(Snapshot& snapshot)
+{
+	if (PyDict_Size(snapshot.dict) != PyDict_Size(snapshot.items))
+	{
+		return false;
+	}
+
+	PyObject *datapoints = NULL;
+	PyObject *asset = NULL;
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(snapshot.dict, &pos, &key, &value))
+	{
+		PyObject *original = PyDict_GetItem(snapshot.items, key);
+		if (!original)
+		{
+			return false;
+		}
+		if (PyUnicode_Check(key) && PyUnicode_CompareWithASCIIString(key, READING_KEY) == 0)
+		{
+			datapoints = value;
+		}
+		if (value == original)
+		{
+			continue;
+		}
+		if (PyUnicode_Check(key) && PyUnicode_CompareWithASCIIString(key, ASSET_CODE_KEY) == 0)
+		{
+			asset = value;
+		}
+		else
+		{
+			// Timestamps, the reading dict itself...
+			return false;
+		}
+	}
+	if (!datapoints || !PyDict_Check(datapoints) || (asset && !PyUnicode_Check(asset)))
+	{
+		return false;
+	}
+
+	// Datapoints removed by the script
+	vector<string> removed;
+	pos = 0;
+	while (PyDict_Next(snapshot.datapoints, &pos, &key, &value))
+	{
+		if (PyDict_Contains(datapoints, key) == 0)
+		{
+			string name;
+			if (!keyName(key, name))
+			{
+				return false;
+			}
+			removed.push_back(name);
+		}
+	}
+
+	// Datapoints assigned, added or possibly modified in place
+	PyObject *changed = PyDict_New();
+	if (!changed)
+	{
+		PyErr_Clear();
+		return false;
+	}
+	pos = 0;
+	while (PyDict_Next(datapoints, &pos, &key, &value))
+	{
+		if (PyDict_GetItem(snapshot.datapoints, key) != value || !isImmutable(value))
+		{
+			PyDict_SetItem(changed, key, value);
+		}
+	}
+
+	const char *assetName = asset ? PyUnicode_AsUTF8(asset) : NULL;
+	if (asset && !assetName)
+	{
+		PyErr_Clear();
+		Py_DECREF(changed);
+		return false;
+	}
+
+	try {
+		applyDatapoints(snapshot.reading, changed, &m_removed);
+	} catch (...) {
+		Py_DECREF(changed);
+		throw;
+	}
+	Py_DECREF(changed);
+
+	// Deleted with the input set, views of their buffers may still exist
+	for (size_t i = 0; i < removed.size(); i++)
+	{
+		Datapoint *dp = snapshot.reading->removeDatapoint(removed[i]);
+		if (dp)
+		{
+			m_removed.push_back(dp);
+		}
+	}
+	if (assetName)
+	{
+		snapshot.reading->setAssetName(assetName);
+	}
+	return true;
+}
+
+/**
+ * Convert datapoints from Python and set them in a reading
+ *
+ * The values are converted as for a new reading, the reading is
+ * unchanged if any value can not be converted. Views of the buffers
+ * of the datapoints, which the script modifies in place, are skipped.
+ *
+ * @param reading	The reading to update
+ * @param changed	Dict of datapoint names and values
+ * @param removed	If not NULL the datapoints replaced in the
+ *			reading are added to it rather than deleted
+ * @throw		exception for badly formed datapoints
+ */
+void PythonWriteBack::applyDatapoints(Reading *reading,
+				      PyObject *changed,
+				      vector<Datapoint *> *removed)
+{
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	vector<PyObject *> views;
+	while (PyDict_Next(changed, &pos, &key, &value))
+	{
+		string name;
+		if (PyMemoryView_Check(value) && keyName(key, name) &&
+		    PythonBuffers::isView(value, reading->getDatapoint(name)))
+		{
+			views.push_back(key);
+		}
+	}
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		PyDict_DelItem(changed, views[i]);
+	}
+
+	if (PyDict_Size(changed) == 0)
+	{
+		return;
+	}
+
+	PyObject *dict = PyDict_New();
+	if (!dict)
+	{
+		throw runtime_error("Unable to allocate the changed datapoints");
+	}
+	PyObject *asset = PyUnicode_FromString(reading->getAssetName().c_str());
+	PyDict_SetItemString(dict, ASSET_CODE_KEY, asset);
+	PyDict_SetItemString(dict, READING_KEY, changed);
+	Py_XDECREF(asset);
+
+	Reading *converted;
+	try {
+		converted = PythonBuffers::toReading(dict);
+	} catch (...) {
+		Py_DECREF(dict);
+		throw;
+	}
+	Py_DECREF(dict);
+
+	vector<Datapoint *> points = converted->getReadingData();
+	for (vector<Datapoint *>::const_iterator it = points.begin();
+						 it != points.end();
+						 ++it)
+	{
+		Datapoint *dp = converted->removeDatapoint((*it)->getName());
+		if (!dp)
+		{
+			continue;
+		}
+		vector<Datapoint *>& existing = reading->getReadingData();
+		size_t i = 0;
+		while (i < existing.size() && existing[i]->getName() != dp->getName())
+		{
+			i++;
+		}
+		if (i == existing.size())
+		{
+			reading->addDatapoint(dp);
+		}
+		else if (removed)
+		{
+			// The replaced datapoint is deleted later
+			removed->push_back(existing[i]);
+			existing[i] = dp;
+		}
+		else
+		{
+			delete existing[i];
+			existing[i] = dp;
+		}
+	}
+	delete converted;
+}
+
+/**
+ * Delete the readings created for a batch that is not passed on
+ *
+ * The input readings among them are deleted with the input set.
+ *
+ * @param readings	The readings, the vector is emptied
+ */
+void PythonWriteBack::discard(vector<Reading *> *readings)
+{
+	for (size_t i = 0; i < readings->size(); i++)
+	{
+		if (!m_reused.erase((*readings)[i]))
+		{
+			delete (*readings)[i];
+		}
+	}
+	readings->clear();
+}
+
+/**
+ * Delete the input readings that have not been reused and
+ * the input set, the kept dict items are released
+ *
+ * @param readingSet	The input readings
+ */
+void PythonWriteBack::release(ReadingSet *readingSet)
+{
+	const vector<Reading *>& readings = readingSet->getAllReadings();
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		if (!m_reused.count(readings[i]))
+		{
+			delete readings[i];
+		}
+	}
+	// The remaining readings belong to the output set
+	readingSet->clear();
+	delete readingSet;
+	m_reused.clear();
+
+	for (size_t i = 0; i < m_removed.size(); i++)
+	{
+		delete m_removed[i];
+	}
+	m_removed.clear();
+
+	for (size_t i = 0; i < m_snapshots.size(); i++)
+	{
+		Py_DECREF(m_snapshots[i].dict);
+		Py_DECREF(m_snapshots[i].items);
+		Py_DECREF(m_snapshots[i].datapoints);
+	}
+	m_snapshots.clear();
+	m_dicts.clear();
+}
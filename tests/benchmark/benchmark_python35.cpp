@@ -0,0 +1,482 @@
+/*
+ * Fledge "Python 3.5" filter ingest benchmarks.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ */
+#include <benchmark/benchmark.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <filter.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <atomic>
+#include <new>
+#include <reading.h>
+#include <reading_set.h>
+
+using namespace std;
+
+// Number of allocations made with operator new by all the threads
+static atomic<unsigned long> allocations(0);
+
+void *operator new(size_t size)
+{
+	allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory)
+	{
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+	free(memory);
+}
+
+extern "C" {
+	PLUGIN_INFORMATION *plugin_info();
+	void plugin_ingest(void *handle,
+                   READINGSET *readingSet);
+	PLUGIN_HANDLE plugin_init(ConfigCategory* config,
+			  OUTPUT_HANDLE *outHandle,
+			  OUTPUT_STREAM output);
+	void plugin_shutdown(PLUGIN_HANDLE handle);
+	void plugin_reconfigure(PLUGIN_HANDLE handle, const string& newConfig);
+
+	void Handler(void *handle, READINGSET *readings)
+	{
+		*(READINGSET **)handle = readings;
+	}
+};
+
+namespace {
+
+// Returns the readings unchanged
+const char *identity_script = R"(
+def identity(readings):
+    return readings
+)";
+
+// Reads every datapoint of every reading
+const char *iterate_script = R"(
+def iterate(readings):
+    count = 0
+    for elem in readings:
+        for key, value in elem['reading'].items():
+            count += 1
+    return readings
+)";
+
+// Returns a new reading for each reading
+const char *copy_script = R"(
+def copy(readings):
+    return [{'asset_code': elem['asset_code'], 'reading': dict(elem['reading'])}
+            for elem in readings]
+)";
+
+// Does some arithmetic on each datapoint, keeping no state across readings
+const char *stateless_script = R"(
+filter_stateless = True
+
+def stateless(readings):
+    for elem in readings:
+        reading = elem['reading']
+        for key in list(reading):
+            value = reading[key]
+            for i in range(20):
+                value = value * 0.5 + 1.0
+            reading[key] = value
+    return readings
+)";
+
+/**
+ * The types of the datapoints of the benchmark readings
+ */
+enum DatapointType { INTEGER, FLOAT, STRING, DICT, ARRAY };
+
+const char *typeNames[] = { "int", "float", "string", "dict", "array" };
+
+// Number of elements of array datapoints and of items of dict datapoints
+#define ARRAY_SIZE	16
+#define DICT_SIZE	4
+
+/**
+ * Create a datapoint of the given type
+ */
+Datapoint *createDatapoint(const string& name, DatapointType type, long value, long arraySize = ARRAY_SIZE)
+{
+	switch (type)
+	{
+		case INTEGER:
+		{
+			DatapointValue dpv(value);
+			return new Datapoint(name, dpv);
+		}
+		case FLOAT:
+		{
+			DatapointValue dpv((double)value + 0.5);
+			return new Datapoint(name, dpv);
+		}
+		case STRING:
+		{
+			DatapointValue dpv(string("value ") + to_string(value));
+			return new Datapoint(name, dpv);
+		}
+		case DICT:
+		{
+			vector<Datapoint *> *items = new vector<Datapoint *>;
+			for (long i = 0; i < DICT_SIZE; i++)
+			{
+				DatapointValue item(value + i);
+				items->push_back(new Datapoint(string("item") + to_string(i), item));
+			}
+			DatapointValue dpv(items, true);
+			return new Datapoint(name, dpv);
+		}
+		case ARRAY:
+		default:
+		{
+			vector<double> values;
+			for (long i = 0; i < arraySize; i++)
+			{
+				values.push_back((double)(value + i));
+			}
+			DatapointValue dpv(values);
+			return new Datapoint(name, dpv);
+		}
+	}
+}
+
+/**
+ * Create a set of readings
+ *
+ * @param count		The number of readings
+ * @param datapoints	The number of datapoints of each reading
+ * @param type		The type of the datapoints
+ * @param arraySize	The number of values of array datapoints
+ */
+ReadingSet *createReadings(long count, long datapoints, DatapointType type, long arraySize = ARRAY_SIZE)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (long i = 0; i < count; i++)
+	{
+		vector<Datapoint *> points;
+		for (long j = 0; j < datapoints; j++)
+		{
+			points.push_back(createDatapoint(string("dp") + to_string(j), type, i + j, arraySize));
+		}
+		readings->push_back(new Reading("benchmark", points));
+	}
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	return readingSet;
+}
+
+/**
+ * Load an example script
+ */
+string loadExample(const string& name)
+{
+	ifstream file(string(EXAMPLES_DIR) + "/" + name + ".py");
+	stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+/**
+ * Run the ingest path of the filter with a script
+ *
+ * The arguments of the benchmark are the number of readings per
+ * set, the number of datapoints per reading, the type of the
+ * datapoints and the value of encode_attribute_names.
+ *
+ * @param state		The benchmark state
+ * @param method	The name of the script function
+ * @param source	The source of the script
+ * @param items	Values of configuration items other than the defaults
+ */
+void runIngest(benchmark::State& state, const string& method, const string& source,
+	       const map<string, string>& items = map<string, string>())
+{
+	long count = state.range(0);
+	long datapoints = state.range(1);
+	DatapointType type = (DatapointType)state.range(2);
+	bool encode = state.range(3) != 0;
+
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+	string script = "/tmp/scripts/benchmark_" + method + "_script_" + method + ".py";
+	ofstream file(script);
+	file << source;
+	file.close();
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("benchmark", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("script", source);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("encode_attribute_names", encode ? "true" : "false");
+	for (map<string, string>::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		config->setValue(it->first, it->second);
+	}
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	if (!handle)
+	{
+		delete config;
+		state.SkipWithError("The filter failed to load the script");
+		return;
+	}
+
+	unsigned long ingestAllocations = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		ReadingSet *readingSet = createReadings(count, datapoints, type);
+		unsigned long before = allocations;
+		state.ResumeTiming();
+
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		state.PauseTiming();
+		ingestAllocations += allocations - before;
+		delete outReadings;
+		outReadings = NULL;
+		state.ResumeTiming();
+	}
+
+	state.SetItemsProcessed(state.iterations() * count);
+	// Shown as the time per datapoint, e.g. 250ns
+	state.counters["per_datapoint"] = benchmark::Counter(
+			(double)state.iterations() * count * datapoints,
+			benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	// Heap allocations of the ingest path, Python objects are not counted
+	state.counters["allocs_per_reading"] = (double)ingestAllocations /
+			(state.iterations() * count);
+	state.SetLabel(string(typeNames[type]) + (encode ? ", encoded" : ""));
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+/**
+ * Reconfigure the filter with a new configuration of the script
+ *
+ * The argument of the benchmark is whether the script is also
+ * changed, in which case its module is compiled and executed again.
+ *
+ * @param state		The benchmark state
+ */
+void BM_Reconfigure(benchmark::State& state)
+{
+	bool changeScript = state.range(0) != 0;
+
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+	string source = iterate_script;
+	string script = "/tmp/scripts/benchmark_reconfigure_script_iterate.py";
+	ofstream file(script);
+	file << source;
+	file.close();
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("benchmark", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("script", source);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	if (!handle)
+	{
+		delete config;
+		state.SkipWithError("The filter failed to load the script");
+		return;
+	}
+
+	long count = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		config->setValue("config", "{\"count\": " + to_string(count) + "}");
+		if (changeScript)
+		{
+			ofstream changed(script);
+			changed << source << "# " << count << "\n";
+			changed.close();
+		}
+		string newConfig = config->itemsToJSON();
+		count++;
+		state.ResumeTiming();
+
+		plugin_reconfigure(handle, newConfig);
+	}
+
+	state.SetLabel(changeScript ? "script changed" : "configuration only");
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+/**
+ * Pass readings with a large array datapoint to a script that returns
+ * them unchanged, with the arrays converted to lists or passed as views
+ *
+ * The arguments of the benchmark are the number of values of the
+ * arrays and whether the arrays are passed as views.
+ *
+ * @param state		The benchmark state
+ */
+void BM_BufferViews(benchmark::State& state)
+{
+	long arraySize = state.range(0);
+	bool views = state.range(1) != 0;
+	long count = 10;
+
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+	string source = identity_script;
+	string script = "/tmp/scripts/benchmark_buffers_script_identity.py";
+	ofstream file(script);
+	file << source;
+	file.close();
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("benchmark", info->config);
+	config->setItemsValueFromDefault();
+	config->setValue("script", source);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("buffer_views", views ? "true" : "false");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	if (!handle)
+	{
+		delete config;
+		state.SkipWithError("The filter failed to load the script");
+		return;
+	}
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		ReadingSet *readingSet = createReadings(count, 1, ARRAY, arraySize);
+		state.ResumeTiming();
+
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		state.PauseTiming();
+		delete outReadings;
+		outReadings = NULL;
+		state.ResumeTiming();
+	}
+
+	state.SetItemsProcessed(state.iterations() * count);
+	state.SetLabel(views ? "views" : "lists");
+
+	plugin_shutdown(handle);
+	delete config;
+}
+
+void BM_Identity(benchmark::State& state)
+{
+	runIngest(state, "identity", identity_script);
+}
+
+void BM_Iterate(benchmark::State& state)
+{
+	runIngest(state, "iterate", iterate_script);
+}
+
+void BM_Copy(benchmark::State& state)
+{
+	runIngest(state, "copy", copy_script);
+}
+
+/**
+ * The scale35 example, with its debug logging of each reading
+ * to syslog disabled so that the script itself is measured
+ */
+void BM_Scale35(benchmark::State& state)
+{
+	runIngest(state, "scale35", loadExample("scale35") + "\nlogger.setLevel(logging.WARNING)\n");
+}
+
+/**
+ * A CPU bound stateless script, with the readings split between the
+ * number of parallel interpreters given by the fifth argument
+ */
+void BM_Parallel(benchmark::State& state)
+{
+	runIngest(state, "stateless", stateless_script,
+		  {{"parallel_interpreters", to_string(state.range(4))}});
+}
+
+/**
+ * The same operation as the scale35 example, applied
+ * by native transforms that do not call the script
+ */
+void BM_Transforms(benchmark::State& state)
+{
+	runIngest(state, "identity", identity_script,
+		  {{"config", "{\"transforms\": [{\"asset\": \"benchmark\", \"scale\": 2, \"offset\": 5}]}"}});
+}
+
+}
+
+BENCHMARK(BM_Identity)
+	->ArgNames({"readings", "datapoints", "type", "encode"})
+	->ArgsProduct({{1, 100, 10000}, {1, 10, 50}, {INTEGER, FLOAT, STRING, DICT, ARRAY}, {0, 1}})
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Iterate)
+	->ArgNames({"readings", "datapoints", "type", "encode"})
+	->ArgsProduct({{100, 10000}, {10}, {INTEGER, FLOAT, STRING, DICT, ARRAY}, {0, 1}})
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Copy)
+	->ArgNames({"readings", "datapoints", "type", "encode"})
+	->ArgsProduct({{100, 10000}, {1, 10}, {INTEGER, FLOAT, STRING}, {1}})
+	->Unit(benchmark::kMicrosecond);
+
+// The scale35 example only handles numeric datapoints
+BENCHMARK(BM_Scale35)
+	->ArgNames({"readings", "datapoints", "type", "encode"})
+	->ArgsProduct({{100, 10000}, {1, 10}, {INTEGER, FLOAT}, {0, 1}})
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Transforms)
+	->ArgNames({"readings", "datapoints", "type", "encode"})
+	->ArgsProduct({{100, 10000}, {1, 10}, {INTEGER, FLOAT, ARRAY}, {0}})
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_BufferViews)
+	->ArgNames({"values", "views"})
+	->ArgsProduct({{16, 4096, 65536}, {0, 1}})
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Parallel)
+	->ArgNames({"readings", "datapoints", "type", "encode", "interpreters"})
+	->ArgsProduct({{10000}, {10}, {FLOAT}, {0}, {0, 2, 4}})
+	->UseRealTime()
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_Reconfigure)
+	->ArgNames({"script"})
+	->Arg(0)
+	->Arg(1)
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
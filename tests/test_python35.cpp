@@ -5,11 +5,22 @@
 #include <filter.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <dirent.h>
 #include <string>
+#include <set>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include <rapidjson/document.h>
 #include <reading.h>
 #include <reading_set.h>
 #include <python35.h>
+#include <python35_latency.h>
+#include <python35_proxy.h>
+#include <asset_tracking.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -24,6 +35,267 @@ def script(readings):
     return readings
 )";
 
+const char *thread_local_script = R"(
+import threading
+
+calls = threading.local()
+
+def script(readings):
+    calls.count = getattr(calls, 'count', 0) + 1
+    for elem in readings:
+        elem['reading'][b'calls'] = calls.count
+    return readings
+)";
+
+const char *lazy_script = R"(
+kept = []
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        reading[b'sum'] = reading[b'a'] + reading[b'b']
+        del reading[b'b']
+        elem['asset_code'] = elem['asset_code'] + '_sum'
+        kept.append(reading)
+    if len(kept) > 1:
+        assert len(kept[0]) == 4 and kept[0][b'c'] == b'text'
+        assert kept[0][b'd'] == {'x': 1, 'y': b'z'}
+    return readings
+)";
+
+const char *columnar_script = R"(
+def script(batch):
+    if batch['asset_code'] == 'drop':
+        return None
+    reading = batch['reading']
+    reading[b'a'] = reading[b'a'] * 2 + 1
+    reading[b'half'] = reading[b'a'] * 0.5
+    del reading[b'b']
+    return batch
+)";
+
+const char *slow_script = R"(
+import time
+
+def script(readings):
+    time.sleep(0.02)
+    return readings
+)";
+
+const char *profile_script = R"(
+import time
+
+def busy():
+    end = time.time() + 0.01
+    while time.time() < end:
+        pass
+
+def script(readings):
+    busy()
+    return readings
+)";
+
+const char *assets_script = R"(
+filter_assets = ['pump*']
+
+def script(readings):
+    for elem in readings:
+        elem['reading'][b'seen'] = 1
+    return readings
+)";
+
+const char *transforms_script = R"(
+calls = 0
+
+def script(readings):
+    global calls
+    calls += 1
+    for elem in readings:
+        reading = elem['reading']
+        reading[b'seen'] = 1
+        reading[b'calls'] = calls
+    return readings
+)";
+
+const char *projection_script = R"(
+filter_datapoints = ['a', 'sum']
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        assert set(reading.keys()) == {b'a'}
+        reading[b'a'] = reading[b'a'] * 2
+        reading[b'sum'] = reading[b'a'] + 1
+    return readings
+)";
+
+const char *worker_script = R"(
+import os
+import time
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        if reading[b'a'] == -2:
+            # A worker that hangs, killed on its timeout
+            time.sleep(60)
+        if reading[b'a'] < 0:
+            os._exit(1)
+        reading[b'sum'] = reading[b'a'] + reading[b'b']
+        reading[b'pid'] = os.getpid()
+    return readings
+)";
+
+const char *parallel_script = R"(
+import threading
+
+filter_stateless = True
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        reading[b'sum'] = reading[b'a'] + reading[b'b']
+        reading[b'thread'] = threading.get_ident()
+    return readings
+)";
+
+const char *writeback_script = R"(
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        if reading[b'a'] % 2:
+            reading[b'a'] = reading[b'a'] * 10
+            del reading[b'b']
+    readings.append({'asset_code': 'new', 'reading': {b'a': 1}})
+    return readings
+)";
+
+const char *gc_script = R"(
+import gc
+
+def script(readings):
+    enabled = 1 if gc.isenabled() else 0
+    frozen = gc.get_freeze_count()
+    collections = sum(generation['collections'] for generation in gc.get_stats())
+    for elem in readings:
+        # A reference cycle, only released by the garbage collector
+        cycle = {}
+        cycle['self'] = cycle
+        reading = elem['reading']
+        reading[b'enabled'] = enabled
+        reading[b'frozen'] = frozen
+        reading[b'collections'] = collections
+    return readings
+)";
+
+const char *budget_script = R"(
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        if b'loop' in reading:
+            # A runaway script, only stopped by the time budget
+            while True:
+                pass
+        reading[b'b'] = reading[b'a'] * 2
+    return readings
+)";
+
+const char *buffers_script = R"(
+import array
+
+held = None
+released = None
+
+def script(readings):
+    global held, released
+    for elem in readings:
+        reading = elem['reading']
+        if held is not None:
+            reading[b'previous'] = held[0]
+            try:
+                released[0]
+                reading[b'released'] = 0
+            except ValueError:
+                reading[b'released'] = 1
+        values = reading[b'arr']
+        reading[b'view'] = 1 if isinstance(values, memoryview) else 0
+        values[0] = values[0] * 10
+        reading[b'image'].cast('B')[5] = 255
+        reading[b'buffer'] = array.array('h', [1, -2, 3])
+        reading[b'rows'] = [array.array('d', [1.0, 2.0]), memoryview(array.array('d', [3.0]))]
+        held = reading[b'held'][1:]
+        released = values
+    readings.append({'asset_code': 'new', 'reading': {b'arr': array.array('d', [1.5])}})
+    return readings
+)";
+
+const char *names_script = R"(
+import json
+
+encoded = True
+
+def set_filter_config(configuration):
+    global encoded
+    encoded = json.loads(configuration['config'])['encoded']
+    return True
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        for key in reading:
+            assert isinstance(key, bytes if encoded else str)
+        assert isinstance(reading[b'c' if encoded else 'c'], bytes if encoded else str)
+        assert sorted(elem) == ['asset_code', 'id', 'reading', 'timestamp', 'user_timestamp']
+        assert isinstance(elem['id'], int) and isinstance(elem['user_timestamp'], str)
+        reading['type'] = type(elem['asset_code']).__name__
+    return readings
+)";
+
+const char *cache_script = R"(
+import json
+
+calls = 0
+offset = 0
+# 1 unless the module is executed again in the same namespace
+loads = globals().get('loads', 0) + 1
+
+def set_filter_config(configuration):
+    global offset
+    offset = json.loads(configuration['config']).get('offset', 0)
+    return True
+
+def script(readings):
+    global calls
+    calls += 1
+    for elem in readings:
+        elem['reading'][b'calls'] = calls
+        elem['reading'][b'offset'] = offset
+        elem['reading'][b'loads'] = loads
+    return readings
+)";
+
+const char *concurrent_script = R"(
+import time
+
+def script(readings):
+    for elem in readings:
+        reading = elem['reading']
+        # Let the other threads run in the middle of the call
+        time.sleep(0)
+        reading[b'double'] = reading[b'a'] * 2
+    return readings
+)";
+
+const char *stream_script = R"(
+def script(readings):
+    assert not isinstance(readings, list)
+    for elem in readings:
+        reading = elem['reading']
+        if reading[b'a'] % 2 == 0:
+            reading[b'half'] = reading[b'a'] // 2
+            yield elem
+)";
+
 const char *none_script = R"(
 def script(readings):
     return None
@@ -63,6 +335,10 @@ def script(readings):
     return readings
 )";
 
+// The readings passed on to each ingest thread
+mutex resultsMutex;
+map<thread::id, ReadingSet *> threadResults;
+
 extern "C" {
 	PLUGIN_INFORMATION *plugin_info();
 	void plugin_ingest(void *handle,
@@ -79,6 +355,17 @@ extern "C" {
 		called++;
 		*(READINGSET **)handle = readings;
 	}
+
+	void CollectHandler(void *handle, READINGSET *readings)
+	{
+		((vector<ReadingSet *> *)handle)->push_back((ReadingSet *)readings);
+	}
+
+	void ThreadHandler(void *handle, READINGSET *readings)
+	{
+		lock_guard<mutex> guard(resultsMutex);
+		threadResults[this_thread::get_id()] = (ReadingSet *)readings;
+	}
 };
 
 TEST(PYTHON35, Addition)
@@ -156,6 +443,1885 @@ TEST(PYTHON35, Addition)
 	plugin_shutdown(handle);
 }
 
+TEST(PYTHON35, IsolatedAddition)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_isolated_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", addition_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", addition_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	// Falls back to the shared interpreter before Python 3.12
+	ASSERT_EQ(config->itemExists("isolated_interpreter"), true);
+	config->setValue("isolated_interpreter", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+	ASSERT_TRUE(((Python35Filter *)handle)->initSuccess());
+	vector<Reading *> *readings = new vector<Reading *>;
+
+	vector<Datapoint *> datapoints;
+	long a = 1000;
+	DatapointValue dpv(a);
+	datapoints.push_back(new Datapoint("a", dpv));
+	long b = 50;
+	DatapointValue dpv1(b);
+	datapoints.push_back(new Datapoint("b", dpv1));
+	readings->push_back(new Reading("test", datapoints));
+
+
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+
+	vector<Reading *>results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	Reading *out = results[0];
+	ASSERT_STREQ(out->getAssetName().c_str(), "test");
+	ASSERT_EQ(out->getDatapointCount(), 3);
+	Datapoint *sum = out->getDatapoint("sum");
+	ASSERT_NE(sum, (Datapoint *)NULL);
+	ASSERT_EQ(sum->getData().getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(sum->getData().toInt(), 1050);
+
+	// Cleanup
+	delete config;
+	delete outReadings;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, IsolatedThreadState)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_thread_local_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", thread_local_script);
+	fclose(fp);
+	config->setValue("script", thread_local_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("isolated_interpreter", "true");
+	void *handle = plugin_init(config, NULL, ThreadHandler);
+	ASSERT_NE(handle, (void *)NULL);
+	ASSERT_TRUE(((Python35Filter *)handle)->initSuccess());
+
+	// The values of threading.local are kept from one call of a thread to the next
+	for (long n = 1; n <= 3; n++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		DatapointValue dpv(n);
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		lock_guard<mutex> guard(resultsMutex);
+		ReadingSet *out = threadResults[this_thread::get_id()];
+		ASSERT_EQ(out->getCount(), 1);
+		ASSERT_EQ(out->getAllReadings()[0]->getDatapoint("calls")->getData().toInt(), n);
+		delete out;
+		threadResults.erase(this_thread::get_id());
+	}
+
+	// Another thread has values of its own, its thread state is deleted when it exits
+	thread other([handle]() {
+		vector<Reading *> *readings = new vector<Reading *>;
+		DatapointValue dpv(1L);
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	});
+	thread::id otherId = other.get_id();
+	other.join();
+	{
+		lock_guard<mutex> guard(resultsMutex);
+		ReadingSet *out = threadResults[otherId];
+		ASSERT_EQ(out->getCount(), 1);
+		ASSERT_EQ(out->getAllReadings()[0]->getDatapoint("calls")->getData().toInt(), 1);
+		delete out;
+		threadResults.erase(otherId);
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, LazyAddition)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_lazy_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", lazy_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", lazy_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("lazy_conversion"), true);
+	config->setValue("lazy_conversion", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+	ASSERT_TRUE(((Python35Filter *)handle)->initSuccess());
+
+	for (int i = 0; i < 2; i++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		vector<Datapoint *> datapoints;
+		long a = 1000;
+		DatapointValue dpv(a);
+		datapoints.push_back(new Datapoint("a", dpv));
+		long b = 50;
+		DatapointValue dpv1(b);
+		datapoints.push_back(new Datapoint("b", dpv1));
+		DatapointValue dpv2(string("text"));
+		datapoints.push_back(new Datapoint("c", dpv2));
+		vector<Datapoint *> *nested = new vector<Datapoint *>;
+		DatapointValue x(1L);
+		nested->push_back(new Datapoint("x", x));
+		DatapointValue y(string("z"));
+		nested->push_back(new Datapoint("y", y));
+		DatapointValue dpv3(nested, true);
+		datapoints.push_back(new Datapoint("d", dpv3));
+		readings->push_back(new Reading("test", datapoints));
+
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		ASSERT_NE(outReadings, (ReadingSet *)NULL);
+		vector<Reading *>results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 1);
+		Reading *out = results[0];
+		ASSERT_STREQ(out->getAssetName().c_str(), "test_sum");
+		ASSERT_EQ(out->getDatapointCount(), 4);
+		ASSERT_EQ(out->getDatapoint("b"), (Datapoint *)NULL);
+		Datapoint *sum = out->getDatapoint("sum");
+		ASSERT_NE(sum, (Datapoint *)NULL);
+		ASSERT_EQ(sum->getData().getType(), DatapointValue::T_INTEGER);
+		ASSERT_EQ(sum->getData().toInt(), 1050);
+		// Not accessed by the script, copied from the input reading
+		Datapoint *c = out->getDatapoint("c");
+		ASSERT_NE(c, (Datapoint *)NULL);
+		ASSERT_STREQ(c->getData().toStringValue().c_str(), "text");
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// A proxy the script has not kept is released without converting its
+	// datapoints, the filter holds one reference besides that of the list
+	PyGILState_STATE state = PyGILState_Ensure();
+	PythonReadingProxy proxies;
+	ASSERT_TRUE(proxies.init());
+	DatapointValue value(1L);
+	Reading *reading = new Reading("test", new Datapoint("a", value));
+	PyObject *proxy = proxies.create(reading, true);
+	ASSERT_NE(proxy, (PyObject *)NULL);
+	Py_INCREF(proxy);
+	ASSERT_FALSE(PythonReadingProxy::detach(proxy, false, 1));
+	Py_DECREF(proxy);
+	Py_DECREF(proxy);
+
+	// A proxy the script has kept is converted
+	proxy = proxies.create(reading, true);
+	ASSERT_NE(proxy, (PyObject *)NULL);
+	PyObject *kept = proxy;
+	Py_INCREF(kept);
+	Py_INCREF(proxy);
+	ASSERT_TRUE(PythonReadingProxy::detach(proxy, false, 1));
+	Py_DECREF(proxy);
+	Py_DECREF(proxy);
+	Py_DECREF(kept);
+	delete reading;
+	proxies.clear();
+	PyGILState_Release(state);
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, Columnar)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_columnar_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", columnar_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", columnar_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("columnar"), true);
+	config->setValue("columnar", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyObject *numpy = PyImport_ImportModule("numpy");
+	PyErr_Clear();
+	Py_XDECREF(numpy);
+	PyGILState_Release(state);
+	if (!numpy)
+	{
+		// The script is not run rather than passing the readings on unfiltered
+		ASSERT_FALSE(((Python35Filter *)handle)->initSuccess());
+		delete config;
+		plugin_shutdown(handle);
+		GTEST_SKIP() << "numpy is not available";
+	}
+	ASSERT_TRUE(((Python35Filter *)handle)->initSuccess());
+
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (long i = 0; i < 3; i++)
+	{
+		vector<Datapoint *> datapoints;
+		DatapointValue dpv(i);
+		datapoints.push_back(new Datapoint("a", dpv));
+		DatapointValue dpv1(1.5);
+		datapoints.push_back(new Datapoint("b", dpv1));
+		DatapointValue dpv2(string("text"));
+		datapoints.push_back(new Datapoint("c", dpv2));
+		readings->push_back(new Reading("test", datapoints));
+		readings->push_back(new Reading("drop", new Datapoint("a", dpv)));
+	}
+
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	ASSERT_NE(outReadings, (ReadingSet *)NULL);
+	vector<Reading *>results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3);
+	for (long i = 0; i < 3; i++)
+	{
+		Reading *out = results[i];
+		ASSERT_STREQ(out->getAssetName().c_str(), "test");
+		ASSERT_EQ(out->getDatapointCount(), 3);
+		ASSERT_EQ(out->getDatapoint("b"), (Datapoint *)NULL);
+		Datapoint *a = out->getDatapoint("a");
+		ASSERT_NE(a, (Datapoint *)NULL);
+		ASSERT_EQ(a->getData().getType(), DatapointValue::T_INTEGER);
+		ASSERT_EQ(a->getData().toInt(), i * 2 + 1);
+		Datapoint *half = out->getDatapoint("half");
+		ASSERT_NE(half, (Datapoint *)NULL);
+		ASSERT_EQ(half->getData().getType(), DatapointValue::T_FLOAT);
+		ASSERT_DOUBLE_EQ(half->getData().toDouble(), (i * 2 + 1) * 0.5);
+		// Not numeric, passed through unchanged
+		ASSERT_NE(out->getDatapoint("c"), (Datapoint *)NULL);
+	}
+
+	// Cleanup
+	delete config;
+	delete outReadings;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, LatencyBuckets)
+{
+	// Values below the sub-buckets have a bucket each
+	for (uint64_t value = 0; value < LATENCY_SUB_BUCKETS; value++)
+	{
+		ASSERT_EQ(PythonLatency::bucket(value), value);
+		ASSERT_EQ(PythonLatency::bucketValue(value), value);
+	}
+
+	// Other values are in the bucket whose highest value is the
+	// first one not below them, within 1/LATENCY_SUB_BUCKETS
+	size_t previous = 0;
+	for (uint64_t value = LATENCY_SUB_BUCKETS; value < ((uint64_t)1 << LATENCY_MAX_BITS); value += value / 7 + 1)
+	{
+		size_t index = PythonLatency::bucket(value);
+		ASSERT_LT(index, LATENCY_BUCKETS);
+		ASSERT_GE(index, previous);
+		previous = index;
+		uint64_t highest = PythonLatency::bucketValue(index);
+		ASSERT_GE(highest, value);
+		ASSERT_LT(PythonLatency::bucketValue(index - 1), value);
+		ASSERT_LE(highest - value, value / LATENCY_SUB_BUCKETS);
+		ASSERT_EQ(PythonLatency::bucket(highest), index);
+		ASSERT_EQ(PythonLatency::bucket(highest + 1), index + 1);
+	}
+	ASSERT_EQ(PythonLatency::bucket((uint64_t)1 << LATENCY_MAX_BITS), LATENCY_BUCKETS - 1);
+	ASSERT_EQ(PythonLatency::bucket(UINT64_MAX), LATENCY_BUCKETS - 1);
+
+	// 1us to 1ms, one value per microsecond
+	uint64_t counts[LATENCY_BUCKETS] = { 0 };
+	for (uint64_t us = 1; us <= 1000; us++)
+	{
+		counts[PythonLatency::bucket(us * 1000)]++;
+	}
+	uint64_t p50 = PythonLatency::percentile(counts, 1000, 0.50);
+	uint64_t p99 = PythonLatency::percentile(counts, 1000, 0.99);
+	ASSERT_EQ(p50, PythonLatency::bucketValue(PythonLatency::bucket(500000)));
+	ASSERT_EQ(p99, PythonLatency::bucketValue(PythonLatency::bucket(990000)));
+	ASSERT_GE(p50, 500000);
+	ASSERT_LE(p50, 500000 + 500000 / LATENCY_SUB_BUCKETS);
+	ASSERT_GE(p99, 990000);
+	ASSERT_LE(p99, 990000 + 990000 / LATENCY_SUB_BUCKETS);
+	ASSERT_EQ(PythonLatency::percentile(counts, 1000, 1.0), PythonLatency::bucketValue(PythonLatency::bucket(1000000)));
+}
+
+TEST(PYTHON35, Accumulate)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_accumulate_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", addition_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", addition_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("accumulate"), true);
+	config->setValue("accumulate", "true");
+	config->setValue("accumulate_count", "3");
+	config->setValue("accumulate_latency", "50");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+	ASSERT_TRUE(((Python35Filter *)handle)->initSuccess());
+
+	for (int i = 0; i < 5; i++)
+	{
+		vector<Datapoint *> datapoints;
+		long a = i;
+		DatapointValue dpv(a);
+		datapoints.push_back(new Datapoint("a", dpv));
+		long b = 50;
+		DatapointValue dpv1(b);
+		datapoints.push_back(new Datapoint("b", dpv1));
+		vector<Reading *> *readings = new vector<Reading *>;
+		readings->push_back(new Reading("test", datapoints));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		if (i < 2)
+		{
+			// Held until the count is reached
+			ASSERT_EQ(outReadings, (ReadingSet *)NULL);
+		}
+		else if (i == 2)
+		{
+			ASSERT_NE(outReadings, (ReadingSet *)NULL);
+			vector<Reading *>results = outReadings->getAllReadings();
+			ASSERT_EQ(results.size(), 3);
+			for (long n = 0; n < 3; n++)
+			{
+				ASSERT_EQ(results[n]->getDatapoint("sum")->getData().toInt(), n + 50);
+			}
+			delete outReadings;
+			outReadings = NULL;
+		}
+	}
+
+	// The latency timer passes on the last two readings
+	for (int wait = 0; wait < 100 && !outReadings; wait++)
+	{
+		usleep(10000);
+	}
+	ASSERT_NE(outReadings, (ReadingSet *)NULL);
+	ASSERT_EQ(outReadings->getAllReadings().size(), 2);
+	delete outReadings;
+	outReadings = NULL;
+
+	// Readings still held are passed on at shutdown
+	vector<Datapoint *> datapoints;
+	long a = 1;
+	DatapointValue dpv(a);
+	datapoints.push_back(new Datapoint("a", dpv));
+	datapoints.push_back(new Datapoint("b", dpv));
+	vector<Reading *> *readings = new vector<Reading *>;
+	readings->push_back(new Reading("test", datapoints));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	ASSERT_EQ(outReadings, (ReadingSet *)NULL);
+
+	plugin_shutdown(handle);
+	ASSERT_NE(outReadings, (ReadingSet *)NULL);
+	ASSERT_EQ(outReadings->getAllReadings().size(), 1);
+
+	// Cleanup
+	delete config;
+	delete outReadings;
+}
+
+TEST(PYTHON35, Async)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_async_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", slow_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", slow_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("async"), true);
+	config->setValue("async", "true");
+	config->setValue("queue_size", "2");
+	config->setValue("queue_full", "Reject");
+	vector<ReadingSet *> outSets;
+	void *handle = plugin_init(config, &outSets, CollectHandler);
+	ASSERT_NE(handle, (void *)NULL);
+	Python35Filter *filter = (Python35Filter *)handle;
+	ASSERT_TRUE(filter->initSuccess());
+
+	for (long i = 0; i < 10; i++)
+	{
+		DatapointValue dpv(i);
+		vector<Reading *> *readings = new vector<Reading *>;
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		// Returns without waiting for the script
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	}
+	ASSERT_LE(filter->getQueuePeak(), 2);
+	unsigned long rejected = filter->getQueueRejected();
+	ASSERT_GT(rejected, 0);
+
+	// Readings received while the queue drains follow the queued readings
+	config->setValue("async", "false");
+	string newConfig = config->itemsToJSON();
+	thread reconfigure([handle, &newConfig]() { plugin_reconfigure(handle, newConfig); });
+	this_thread::sleep_for(chrono::milliseconds(5));
+	DatapointValue dpv(10L);
+	vector<Reading *> *readings = new vector<Reading *>;
+	readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	reconfigure.join();
+
+	// Queued readings are processed at shutdown
+	plugin_shutdown(handle);
+	ASSERT_EQ(outSets.size() + rejected, 11);
+	long last = -1;
+	for (size_t i = 0; i < outSets.size(); i++)
+	{
+		ASSERT_EQ(outSets[i]->getAllReadings().size(), 1);
+		long value = outSets[i]->getAllReadings()[0]->getDatapoint("a")->getData().toInt();
+		// In arrival order
+		ASSERT_GT(value, last);
+		last = value;
+		delete outSets[i];
+	}
+
+	// Cleanup
+	delete config;
+}
+
+TEST(PYTHON35, Workers)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_worker_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", worker_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", worker_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("worker_processes"), true);
+	config->setValue("worker_processes", "2");
+	config->setValue("worker_timeout", "200");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	for (int batch = 0; batch < 4; batch++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 10; i++)
+		{
+			vector<Datapoint *> datapoints;
+			// The second batch makes a worker exit, the third a worker hang
+			DatapointValue dpv((batch == 1 || batch == 2) && i == 9 ? (long)-batch : i);
+			datapoints.push_back(new Datapoint("a", dpv));
+			double b = 0.5;
+			DatapointValue dpv1(b);
+			datapoints.push_back(new Datapoint("b", dpv1));
+			DatapointValue dpv2(nan(""));
+			datapoints.push_back(new Datapoint("n", dpv2));
+			DatapointValue big(-(1L << 40) - i);
+			datapoints.push_back(new Datapoint("big", big));
+			vector<Datapoint *> *nested = new vector<Datapoint *>;
+			DatapointValue text(string("text"));
+			nested->push_back(new Datapoint("text", text));
+			DatapointValue values(vector<double>({1.5, 2.5}));
+			nested->push_back(new Datapoint("values", values));
+			DatapointValue dict(nested, true);
+			datapoints.push_back(new Datapoint("dict", dict));
+			DataBuffer *buffer = new DataBuffer(2, 3);
+			((short *)buffer->getData())[1] = i;
+			DatapointValue dpv3(buffer);
+			datapoints.push_back(new Datapoint("buffer", dpv3));
+			Reading *reading = new Reading("test", datapoints);
+			reading->setId(100 + i);
+			readings->push_back(reading);
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		ASSERT_NE(outReadings, (ReadingSet *)NULL);
+		vector<Reading *> results = outReadings->getAllReadings();
+		if (batch == 1 || batch == 2)
+		{
+			// The readings of the worker that exited or was killed are discarded,
+			// the results of the other worker are kept in order
+			if (batch == 1)
+			{
+				ASSERT_EQ(results.size(), 5);
+			}
+			ASSERT_LT(results.size(), 10);
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				ASSERT_EQ(results[i]->getId(), 100 + (long)i);
+				ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), (long)i);
+				ASSERT_NE(results[i]->getDatapoint("buffer"), (Datapoint *)NULL);
+			}
+			delete outReadings;
+			outReadings = NULL;
+			continue;
+		}
+		ASSERT_EQ(results.size(), 10);
+		set<long> pids;
+		for (long i = 0; i < 10; i++)
+		{
+			ASSERT_STREQ(results[i]->getAssetName().c_str(), "test");
+			ASSERT_EQ(results[i]->getId(), 100 + i);
+			// In the original order
+			ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i);
+			ASSERT_EQ(results[i]->getDatapoint("sum")->getData().getType(), DatapointValue::T_FLOAT);
+			ASSERT_EQ(results[i]->getDatapoint("sum")->getData().toDouble(), i + 0.5);
+			ASSERT_TRUE(isnan(results[i]->getDatapoint("n")->getData().toDouble()));
+			ASSERT_EQ(results[i]->getDatapoint("big")->getData().toInt(), -(1L << 40) - i);
+			DatapointValue& dict = results[i]->getDatapoint("dict")->getData();
+			ASSERT_EQ(dict.getType(), DatapointValue::T_DP_DICT);
+			ASSERT_EQ(dict.getDpVec()->size(), 2);
+			ASSERT_STREQ((*dict.getDpVec())[0]->getData().toStringValue().c_str(), "text");
+			ASSERT_EQ((*dict.getDpVec())[1]->getData().getType(), DatapointValue::T_FLOAT_ARRAY);
+			ASSERT_EQ((*dict.getDpVec())[1]->getData().getDpArr()->size(), 2);
+			// Not sent to the workers, copied from the input reading
+			Datapoint *buffer = results[i]->getDatapoint("buffer");
+			ASSERT_NE(buffer, (Datapoint *)NULL);
+			ASSERT_EQ(buffer->getData().getType(), DatapointValue::T_DATABUFFER);
+			ASSERT_EQ(((short *)buffer->getData().getDataBuffer()->getData())[1], i);
+			pids.insert(results[i]->getDatapoint("pid")->getData().toInt());
+		}
+		if (batch == 0)
+		{
+			// The readings are split between the workers
+			ASSERT_EQ(pids.size(), 2);
+		}
+		ASSERT_EQ(pids.count(getpid()), 0);
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, Parallel)
+{
+	if (!PythonInterpreter::isolationSupported())
+	{
+		GTEST_SKIP() << "Parallel interpreters require Python 3.12 or later";
+	}
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_parallel_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", parallel_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", parallel_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ASSERT_EQ(config->itemExists("parallel_interpreters"), true);
+	config->setValue("parallel_interpreters", "2");
+	config->setValue("parallel_min_readings", "100");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	// Only the batches that are large enough are split
+	size_t sizes[] = { 200, 200, 10 };
+	set<long> laneThreads;
+	for (int n = 0; n < 3; n++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < (long)sizes[n]; i++)
+		{
+			vector<Datapoint *> datapoints;
+			DatapointValue dpv(i);
+			datapoints.push_back(new Datapoint("a", dpv));
+			double b = 0.5;
+			DatapointValue dpv1(b);
+			datapoints.push_back(new Datapoint("b", dpv1));
+			readings->push_back(new Reading("test", datapoints));
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		ASSERT_NE(outReadings, (ReadingSet *)NULL);
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), sizes[n]);
+		set<long> threads;
+		for (long i = 0; i < (long)sizes[n]; i++)
+		{
+			// In the original order
+			ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i);
+			ASSERT_EQ(results[i]->getDatapoint("sum")->getData().toDouble(), i + 0.5);
+			threads.insert(results[i]->getDatapoint("thread")->getData().toInt());
+		}
+		ASSERT_EQ(threads.size(), n < 2 ? 2 : 1);
+		if (n == 0)
+		{
+			laneThreads = threads;
+		}
+		else if (n == 1)
+		{
+			// The lanes keep their threads from one batch to the next
+			ASSERT_EQ(threads, laneThreads);
+		}
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, Profile)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	// Remove the reports of previous runs
+	DIR *dir = opendir("/tmp/scripts");
+	ASSERT_NE(dir, (DIR *)NULL);
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, "python35_profile_", 17) == 0)
+		{
+			unlink((string("/tmp/scripts/") + entry->d_name).c_str());
+		}
+	}
+	closedir(dir);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_profile_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", profile_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", profile_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("profile_duration", "60");
+	config->setValue("profile_calls", "5");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	for (int call = 0; call < 5; call++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		long a = call;
+		DatapointValue dpv(a);
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// The report is written once the profiler has stopped
+	delete config;
+	plugin_shutdown(handle);
+
+	string report;
+	dir = opendir("/tmp/scripts");
+	ASSERT_NE(dir, (DIR *)NULL);
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, "python35_profile_", 17) == 0)
+		{
+			report = string("/tmp/scripts/") + entry->d_name;
+		}
+	}
+	closedir(dir);
+	ASSERT_FALSE(report.empty());
+
+	fp = fopen(report.c_str(), "r");
+	ASSERT_NE(fp, (FILE *)0);
+	string content;
+	char buffer[1024];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		content.append(buffer, n);
+	}
+	fclose(fp);
+	unlink(report.c_str());
+
+	ASSERT_NE(content.find("Profile of the script of filter"), string::npos);
+	ASSERT_NE(content.find("5 calls of the script"), string::npos);
+	size_t pos = content.find(" samples at 10 ms intervals");
+	ASSERT_NE(pos, string::npos);
+	// The sampler may not get the interpreter lock while the script runs
+	size_t line = content.rfind('\n', pos);
+	unsigned long samples = strtoul(content.c_str() + line + 1, NULL, 10);
+	pos = content.find(", ", pos);
+	ASSERT_NE(pos, string::npos);
+	unsigned long native = strtoul(content.c_str() + pos + 2, NULL, 10);
+	ASSERT_LE(native, samples);
+	ASSERT_EQ(content.find("Functions by cumulative samples") != string::npos, samples != 0);
+	if (samples > native)
+	{
+		ASSERT_NE(content.find("script (/tmp/scripts/test_profile_script_script.py"), string::npos);
+	}
+}
+
+TEST(PYTHON35, Assets)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_assets_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", assets_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", assets_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	const char *assets[] = { "pump1", "motor", "motor", "pump2", "motor" };
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (long i = 0; i < 5; i++)
+	{
+		DatapointValue dpv(i);
+		readings->push_back(new Reading(assets[i], new Datapoint("a", dpv)));
+	}
+	vector<Reading *> inputs = *readings;
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	// The readings of other assets are the input readings, in their original place
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 5);
+	for (long i = 0; i < 5; i++)
+	{
+		ASSERT_STREQ(results[i]->getAssetName().c_str(), assets[i]);
+		ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i);
+		if (assets[i][0] == 'm')
+		{
+			ASSERT_EQ(results[i], inputs[i]);
+			ASSERT_EQ(results[i]->getDatapoint("seen"), (Datapoint *)NULL);
+		}
+		else
+		{
+			ASSERT_EQ(results[i]->getDatapoint("seen")->getData().toInt(), 1);
+		}
+	}
+	delete outReadings;
+	outReadings = NULL;
+
+	// The assets item takes precedence over the script
+	config->setValue("assets", "motor");
+	plugin_reconfigure(handle, config->itemsToJSON());
+	readings = new vector<Reading *>;
+	DatapointValue dpv(1L);
+	readings->push_back(new Reading("motor", new Datapoint("a", dpv)));
+	readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getDatapoint("seen")->getData().toInt(), 1);
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, AssetTracking)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_asset_tracking_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", assets_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", assets_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	vector<ReadingSet *> outSets;
+	void *handle = plugin_init(config, &outSets, CollectHandler);
+	ASSERT_NE(handle, (void *)NULL);
+	Python35Filter *filter = (Python35Filter *)handle;
+	if (!AssetTracker::getAssetTracker())
+	{
+		plugin_shutdown(handle);
+		delete config;
+		GTEST_SKIP() << "No asset tracker in this process";
+	}
+
+	// The tracker is called once per distinct asset, whatever the number of batches
+	const char *assets[] = { "pump1", "motor", "motor", "pump2", "motor", "pump1" };
+	for (int batch = 0; batch < 3; batch++)
+	{
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 6; i++)
+		{
+			DatapointValue dpv(i);
+			readings->push_back(new Reading(assets[(i + batch) % 6], new Datapoint("a", dpv)));
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	}
+	ASSERT_EQ(outSets.size(), 3);
+	ASSERT_EQ(filter->getTrackedCalls(), 3);
+
+	// The assets are registered again once the filter is reconfigured
+	plugin_reconfigure(handle, config->itemsToJSON());
+	vector<Reading *> *readings = new vector<Reading *>;
+	DatapointValue dpv(1L);
+	readings->push_back(new Reading("motor", new Datapoint("a", dpv)));
+	readings->push_back(new Reading("motor", new Datapoint("a", dpv)));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	ASSERT_EQ(outSets.size(), 4);
+	ASSERT_EQ(filter->getTrackedCalls(), 4);
+
+	// Cleanup
+	for (size_t i = 0; i < outSets.size(); i++)
+	{
+		delete outSets[i];
+	}
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, Transforms)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_transforms_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", transforms_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", transforms_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("config", "{\"transforms\": ["
+			"{\"asset\": \"pump*\", \"datapoint\": \"temp\", \"scale\": 2, \"offset\": 1},"
+			"{\"asset\": \"pump*\", \"datapoint\": \"flow\", \"scale\": 0.5, \"max\": 10, \"rename\": \"flow_half\"},"
+			"{\"asset\": \"pump*\", \"datapoint\": \"arr\", \"scale\": 2, \"offset\": -1, \"min\": 2}]}");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	vector<Reading *> *readings = new vector<Reading *>;
+	vector<Datapoint *> datapoints;
+	DatapointValue temp(5L);
+	datapoints.push_back(new Datapoint("temp", temp));
+	DatapointValue flow(30L);
+	datapoints.push_back(new Datapoint("flow", flow));
+	vector<double> values = { 1.0, 2.0, 3.0 };
+	DatapointValue arr(values);
+	datapoints.push_back(new Datapoint("arr", arr));
+	readings->push_back(new Reading("pump1", datapoints));
+	DatapointValue a(1L);
+	readings->push_back(new Reading("motor", new Datapoint("a", a)));
+	DatapointValue temp2(2.5);
+	readings->push_back(new Reading("pump2", new Datapoint("temp", temp2)));
+	vector<Reading *> inputs = *readings;
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	// The readings of the pumps are transformed in place and do not enter Python
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3);
+	ASSERT_EQ(results[0], inputs[0]);
+	ASSERT_EQ(results[0]->getDatapoint("seen"), (Datapoint *)NULL);
+	ASSERT_EQ(results[0]->getDatapoint("temp")->getData().getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(results[0]->getDatapoint("temp")->getData().toInt(), 11);
+	ASSERT_EQ(results[0]->getDatapoint("flow"), (Datapoint *)NULL);
+	ASSERT_EQ(results[0]->getDatapoint("flow_half")->getData().getType(), DatapointValue::T_FLOAT);
+	ASSERT_EQ(results[0]->getDatapoint("flow_half")->getData().toDouble(), 10.0);
+	vector<double> *transformed = results[0]->getDatapoint("arr")->getData().getDpArr();
+	ASSERT_NE(transformed, (vector<double> *)NULL);
+	ASSERT_EQ(*transformed, vector<double>({ 2.0, 3.0, 5.0 }));
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "motor");
+	ASSERT_EQ(results[1]->getDatapoint("seen")->getData().toInt(), 1);
+	ASSERT_EQ(results[1]->getDatapoint("calls")->getData().toInt(), 1);
+	ASSERT_EQ(results[2], inputs[2]);
+	ASSERT_EQ(results[2]->getDatapoint("seen"), (Datapoint *)NULL);
+	ASSERT_EQ(results[2]->getDatapoint("temp")->getData().toDouble(), 6.0);
+	delete outReadings;
+	outReadings = NULL;
+
+	// A set of readings that are all transformed is passed on without calling the script
+	readings = new vector<Reading *>;
+	Reading *pump = new Reading("pump1", new Datapoint("temp", temp));
+	readings->push_back(pump);
+	readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0], pump);
+	ASSERT_EQ(results[0]->getDatapoint("seen"), (Datapoint *)NULL);
+	ASSERT_EQ(results[0]->getDatapoint("temp")->getData().toInt(), 11);
+	delete outReadings;
+	outReadings = NULL;
+
+	readings = new vector<Reading *>;
+	readings->push_back(new Reading("motor", new Datapoint("a", a)));
+	readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getDatapoint("calls")->getData().toInt(), 2);
+	delete outReadings;
+	outReadings = NULL;
+
+	// A transform without an asset applies to all the readings, which are passed to the script
+	config->setValue("config", "{\"transforms\": [{\"datapoint\": \"a\", \"scale\": 3}]}");
+	plugin_reconfigure(handle, config->itemsToJSON());
+	readings = new vector<Reading *>;
+	readings->push_back(new Reading("motor", new Datapoint("a", a)));
+	readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getDatapoint("a")->getData().toInt(), 3);
+	ASSERT_EQ(results[0]->getDatapoint("seen")->getData().toInt(), 1);
+	delete outReadings;
+	outReadings = NULL;
+
+	// Transforms that are not valid are ignored, the script is passed all the readings
+	config->setValue("config", "{\"transforms\": [{\"scael\": 2}]}");
+	plugin_reconfigure(handle, config->itemsToJSON());
+	readings = new vector<Reading *>;
+	readings->push_back(new Reading("pump1", new Datapoint("temp", temp)));
+	readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getDatapoint("temp")->getData().toInt(), 5);
+	ASSERT_EQ(results[0]->getDatapoint("seen")->getData().toInt(), 1);
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, Projection)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_projection_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", projection_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", projection_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (long i = 0; i < 3; i++)
+	{
+		vector<Datapoint *> datapoints;
+		DatapointValue a(i);
+		datapoints.push_back(new Datapoint("a", a));
+		DatapointValue b(string("text"));
+		datapoints.push_back(new Datapoint("b", b));
+		vector<double> values = { 1.0, 2.0, 3.0 };
+		DatapointValue c(values);
+		datapoints.push_back(new Datapoint("c", c));
+		readings->push_back(new Reading("test", datapoints));
+	}
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	// The datapoints not passed to the script are unchanged
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3);
+	for (long i = 0; i < 3; i++)
+	{
+		ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i * 2);
+		ASSERT_EQ(results[i]->getDatapoint("sum")->getData().toInt(), i * 2 + 1);
+		ASSERT_STREQ(results[i]->getDatapoint("b")->getData().toStringValue().c_str(), "text");
+		ASSERT_EQ(results[i]->getDatapoint("c")->getData().getType(), DatapointValue::T_FLOAT_ARRAY);
+	}
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, WriteBack)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_writeback_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", writeback_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", writeback_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	for (int lazy = 0; lazy < 2; lazy++)
+	{
+		if (lazy)
+		{
+			config->setValue("lazy_conversion", "true");
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 4; i++)
+		{
+			vector<Datapoint *> datapoints;
+			DatapointValue dpv(i);
+			datapoints.push_back(new Datapoint("a", dpv));
+			DatapointValue dpv1(i);
+			datapoints.push_back(new Datapoint("b", dpv1));
+			readings->push_back(new Reading("test", datapoints));
+		}
+		vector<Reading *> inputs = *readings;
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 5);
+		for (long i = 0; i < 4; i++)
+		{
+			// The input readings are passed on
+			ASSERT_EQ(results[i], inputs[i]);
+			ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i % 2 ? i * 10 : i);
+			ASSERT_EQ(results[i]->getDatapointCount(), i % 2 ? 1 : 2);
+		}
+		ASSERT_STREQ(results[4]->getAssetName().c_str(), "new");
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, GarbageCollection)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_gc_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", gc_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", gc_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("gc_mode", "Between batches");
+	config->setValue("gc_freeze", "true");
+	// The objects are only frozen in an interpreter of the filter's own
+	config->setValue("isolated_interpreter", "true");
+	// The collections are measured and reported
+	config->setValue("latency_report_interval", "1");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	long first = 0;
+	for (int n = 0; n < 4; n++)
+	{
+		if (n == 3)
+		{
+			config->setValue("gc_mode", "Automatic");
+			config->setValue("gc_freeze", "false");
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 1000; i++)
+		{
+			DatapointValue dpv(i);
+			readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 1000);
+		long enabled = results[0]->getDatapoint("enabled")->getData().toInt();
+		long frozen = results[0]->getDatapoint("frozen")->getData().toInt();
+		long collections = results[0]->getDatapoint("collections")->getData().toInt();
+		if (n < 3)
+		{
+			// No collection while the script runs, the module is frozen
+			// if the filter has an interpreter of its own
+			ASSERT_EQ(enabled, 0);
+#if PY_VERSION_HEX >= 0x030C0000
+			ASSERT_GT(frozen, 0);
+#else
+			ASSERT_EQ(frozen, 0);
+#endif
+		}
+		else
+		{
+			ASSERT_EQ(enabled, 1);
+			ASSERT_EQ(frozen, 0);
+		}
+		if (n == 0)
+		{
+			first = collections;
+		}
+		else if (n == 2)
+		{
+			// The cycles created by the script are collected between batches
+			ASSERT_GT(collections, first);
+		}
+		delete outReadings;
+		outReadings = NULL;
+	}
+	plugin_shutdown(handle);
+
+	// In the shared interpreter the objects are not frozen and automatic
+	// collection is only turned off while the script runs
+	config->setValue("gc_mode", "Between batches");
+	config->setValue("gc_freeze", "true");
+	config->setValue("isolated_interpreter", "false");
+	handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+	vector<Reading *> *readings = new vector<Reading *>;
+	DatapointValue dpv(1L);
+	readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getDatapoint("enabled")->getData().toInt(), 0);
+	ASSERT_EQ(results[0]->getDatapoint("frozen")->getData().toInt(), 0);
+
+	PyGILState_STATE gil = PyGILState_Ensure();
+	PyObject *gc = PyImport_ImportModule("gc");
+	ASSERT_NE(gc, (PyObject *)NULL);
+	PyObject *enabled = PyObject_CallMethod(gc, "isenabled", NULL);
+	bool collecting = enabled && PyObject_IsTrue(enabled) == 1;
+	Py_XDECREF(enabled);
+	Py_DECREF(gc);
+	PyGILState_Release(gil);
+	ASSERT_TRUE(collecting);
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, TimeBudget)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_budget_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", budget_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", budget_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("time_budget", "5");
+	config->setValue("time_budget_policy", "Pass through");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	const char *policies[] = { "Pass through", "Drop", "Retry in smaller sets" };
+	for (int n = 0; n < 3; n++)
+	{
+		if (n > 0)
+		{
+			config->setValue("time_budget_policy", policies[n]);
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		// The last reading makes the script loop
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 4; i++)
+		{
+			DatapointValue dpv(i);
+			Reading *reading = new Reading("test", new Datapoint("a", dpv));
+			if (i == 3)
+			{
+				DatapointValue loop(1L);
+				reading->addDatapoint(new Datapoint("loop", loop));
+			}
+			readings->push_back(reading);
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		ASSERT_NE(outReadings, (ReadingSet *)NULL);
+		vector<Reading *> results = outReadings->getAllReadings();
+		if (n == 0)
+		{
+			// The readings are passed on as they were received
+			ASSERT_EQ(results.size(), 4);
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				ASSERT_EQ(results[i]->getDatapoint("b"), (Datapoint *)NULL);
+			}
+		}
+		else if (n == 1)
+		{
+			ASSERT_EQ(results.size(), 0);
+		}
+		else
+		{
+			// The half without the runaway reading is filtered
+			ASSERT_EQ(results.size(), 2);
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				ASSERT_EQ(results[i]->getDatapoint("b")->getData().toInt(), (long)i * 2);
+			}
+		}
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Readings given to the script as buffer views are not passed through
+	config->setValue("time_budget_policy", "Pass through");
+	config->setValue("buffer_views", "true");
+	plugin_reconfigure(handle, config->itemsToJSON());
+	{
+		vector<Datapoint *> datapoints;
+		DatapointValue arr(vector<double>({ 1.0, 2.0 }));
+		datapoints.push_back(new Datapoint("arr", arr));
+		DatapointValue loop(1L);
+		datapoints.push_back(new Datapoint("loop", loop));
+		vector<Reading *> *readings = new vector<Reading *>;
+		readings->push_back(new Reading("test", datapoints));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+		ASSERT_NE(outReadings, (ReadingSet *)NULL);
+		ASSERT_EQ(outReadings->getCount(), 0);
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// The script is not interrupted within its budget
+	vector<Reading *> *readings = new vector<Reading *>;
+	DatapointValue dpv(21L);
+	readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	ASSERT_EQ(outReadings->getCount(), 1);
+	ASSERT_EQ(outReadings->getAllReadings()[0]->getDatapoint("b")->getData().toInt(), 42);
+	delete outReadings;
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, BufferViews)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_buffers_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", buffers_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", buffers_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("buffer_views", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	for (int lazy = 0; lazy < 2; lazy++)
+	{
+		if (lazy)
+		{
+			config->setValue("lazy_conversion", "true");
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		vector<Datapoint *> datapoints;
+		DatapointValue arr(vector<double>({ 1.0, 2.0, 3.0 }));
+		datapoints.push_back(new Datapoint("arr", arr));
+		unsigned char pixels[6] = { 0, 1, 2, 3, 4, 5 };
+		DatapointValue image(new DPImage(3, 2, 8, pixels));
+		datapoints.push_back(new Datapoint("image", image));
+		DatapointValue held(vector<double>({ 5.0, 6.0, 7.0 }));
+		datapoints.push_back(new Datapoint("held", held));
+		vector<Reading *> *readings = new vector<Reading *>;
+		readings->push_back(new Reading("arrays", datapoints));
+		vector<Reading *> inputs = *readings;
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 2);
+		ASSERT_EQ(results[0], inputs[0]);
+		ASSERT_EQ(results[0]->getDatapoint("view")->getData().toInt(), 1);
+		// Changed in place through the views
+		ASSERT_EQ(*results[0]->getDatapoint("arr")->getData().getDpArr(),
+			  vector<double>({ 10.0, 2.0, 3.0 }));
+		unsigned char *data = (unsigned char *)results[0]->getDatapoint("image")->getData().getImage()->getData();
+		ASSERT_EQ(data[4], 4);
+		ASSERT_EQ(data[5], 255);
+		// Buffers returned by the script
+		DatapointValue& buffer = results[0]->getDatapoint("buffer")->getData();
+		ASSERT_EQ(buffer.getType(), DatapointValue::T_DATABUFFER);
+		ASSERT_EQ(buffer.getDataBuffer()->getItemSize(), 2);
+		ASSERT_EQ(buffer.getDataBuffer()->getItemCount(), 3);
+		ASSERT_EQ(((short *)buffer.getDataBuffer()->getData())[1], -2);
+		DatapointValue& rows = results[0]->getDatapoint("rows")->getData();
+		ASSERT_EQ(rows.getType(), DatapointValue::T_2D_FLOAT_ARRAY);
+		ASSERT_EQ(rows.getDp2DArr()->size(), 2);
+		ASSERT_EQ(*(*rows.getDp2DArr())[1], vector<double>({ 3.0 }));
+		// The datapoint the script still uses is passed on as a copy
+		ASSERT_EQ(*results[0]->getDatapoint("held")->getData().getDpArr(),
+			  vector<double>({ 5.0, 6.0, 7.0 }));
+		if (lazy)
+		{
+			// A slice kept from the previous call is still valid, a view is not
+			ASSERT_EQ(results[0]->getDatapoint("previous")->getData().toDouble(), 6.0);
+			ASSERT_EQ(results[0]->getDatapoint("released")->getData().toInt(), 1);
+		}
+		ASSERT_EQ(*results[1]->getDatapoint("arr")->getData().getDpArr(), vector<double>({ 1.5 }));
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, NameCache)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_names_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", names_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", names_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	config->setValue("config", "{\"encoded\": true}");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	// The names must follow a change of encode_attribute_names
+	for (int call = 0; call < 4; call++)
+	{
+		if (call == 2)
+		{
+			config->setValue("encode_attribute_names", "false");
+			config->setValue("config", "{\"encoded\": false}");
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (long i = 0; i < 3; i++)
+		{
+			vector<Datapoint *> datapoints;
+			DatapointValue dpv(i);
+			datapoints.push_back(new Datapoint("a", dpv));
+			double b = 1.5;
+			DatapointValue dpv1(b);
+			datapoints.push_back(new Datapoint("b", dpv1));
+			DatapointValue dpv2(string("text"));
+			datapoints.push_back(new Datapoint("c", dpv2));
+			readings->push_back(new Reading("test", datapoints));
+		}
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 3);
+		for (long i = 0; i < 3; i++)
+		{
+			ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i);
+			ASSERT_EQ(results[i]->getDatapoint("b")->getData().toDouble(), 1.5);
+			ASSERT_STREQ(results[i]->getDatapoint("c")->getData().toStringValue().c_str(), "text");
+			ASSERT_STREQ(results[i]->getDatapoint("type")->getData().toStringValue().c_str(), "str");
+		}
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, ScriptCache)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_cache_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", cache_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", cache_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	// The module is kept while the script is unchanged and
+	// executed again in a new module once it changes
+	long expected[] = { 1, 2, 3, 1 };
+	for (int call = 0; call < 4; call++)
+	{
+		if (call == 2)
+		{
+			config->setValue("config", "{\"offset\": 10}");
+		}
+		if (call == 3)
+		{
+			fp = fopen(script, "w");
+			ASSERT_NE(fp, (FILE *)0);
+			fprintf(fp, "%s# changed\n", cache_script);
+			fclose(fp);
+		}
+		if (call >= 2)
+		{
+			plugin_reconfigure(handle, config->itemsToJSON());
+		}
+
+		vector<Reading *> *readings = new vector<Reading *>;
+		DatapointValue dpv(1L);
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+		ReadingSet *readingSet = new ReadingSet(readings);
+		delete readings;
+		plugin_ingest(handle, (READINGSET *)readingSet);
+
+		vector<Reading *> results = outReadings->getAllReadings();
+		ASSERT_EQ(results.size(), 1);
+		ASSERT_EQ(results[0]->getDatapoint("calls")->getData().toInt(), expected[call]);
+		ASSERT_EQ(results[0]->getDatapoint("offset")->getData().toInt(), call >= 2 ? 10 : 0);
+		ASSERT_EQ(results[0]->getDatapoint("loads")->getData().toInt(), 1);
+		delete outReadings;
+		outReadings = NULL;
+	}
+
+	// Only the compiled code of the current content is kept
+	string suffix = ".cpython-" + to_string(PY_MAJOR_VERSION) + to_string(PY_MINOR_VERSION) + ".code";
+	int cached = 0;
+	DIR *dir = opendir("/tmp/scripts/__pycache__");
+	ASSERT_NE(dir, (DIR *)NULL);
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		string name = entry->d_name;
+		if (name.compare(0, 25, "test_cache_script_script.") == 0 &&
+		    name.length() > suffix.length() &&
+		    name.compare(name.length() - suffix.length(), suffix.length(), suffix) == 0)
+		{
+			cached++;
+		}
+	}
+	closedir(dir);
+	ASSERT_EQ(cached, 1);
+
+	// Cleanup
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, ConcurrentReconfigure)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_concurrent_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", cache_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", cache_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	// Each set of readings is processed by the script or passed on, whatever the reconfigurations
+	int processed = 0;
+	int passed = 0;
+	thread ingest([&]() {
+		for (long i = 0; i < 40; i++)
+		{
+			vector<Reading *> *readings = new vector<Reading *>;
+			DatapointValue dpv(i);
+			readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+			ReadingSet *readingSet = new ReadingSet(readings);
+			delete readings;
+			plugin_ingest(handle, (READINGSET *)readingSet);
+			if (outReadings && outReadings->getAllReadings().size() == 1)
+			{
+				Reading *out = outReadings->getAllReadings()[0];
+				if (out->getDatapoint("calls"))
+				{
+					processed++;
+				}
+				else
+				{
+					passed++;
+				}
+			}
+			delete outReadings;
+			outReadings = NULL;
+		}
+	});
+	for (int i = 0; i < 10; i++)
+	{
+		config->setValue("enable", i % 3 == 1 ? "false" : "true");
+		config->setValue("config", "{\"offset\": " + to_string(i) + "}");
+		plugin_reconfigure(handle, config->itemsToJSON());
+	}
+	ingest.join();
+	ASSERT_EQ(processed + passed, 40);
+
+	// The module has been kept by the reconfigurations
+	vector<Reading *> *readings = new vector<Reading *>;
+	DatapointValue dpv(1L);
+	readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	ASSERT_EQ(outReadings->getAllReadings().size(), 1);
+	ASSERT_EQ(outReadings->getAllReadings()[0]->getDatapoint("calls")->getData().toInt(), processed + 1);
+	ASSERT_EQ(outReadings->getAllReadings()[0]->getDatapoint("offset")->getData().toInt(), 9);
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
+TEST(PYTHON35, ConcurrentIngest)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_threads_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", concurrent_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", concurrent_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+
+	// Several pipeline threads call the same filter, with dicts and lazy readings
+	for (int lazy = 0; lazy < 2; lazy++)
+	{
+		config->setValue("lazy_conversion", lazy ? "true" : "false");
+		void *handle = plugin_init(config, NULL, ThreadHandler);
+		ASSERT_NE(handle, (void *)NULL);
+
+		atomic<int> errors(0);
+		vector<thread> threads;
+		for (long t = 0; t < 8; t++)
+		{
+			threads.push_back(thread([handle, t, &errors]() {
+				string asset = "thread" + to_string(t);
+				for (int n = 0; n < 10; n++)
+				{
+					vector<Reading *> *readings = new vector<Reading *>;
+					for (long i = 0; i < 20; i++)
+					{
+						DatapointValue dpv(t * 1000 + i);
+						readings->push_back(new Reading(asset, new Datapoint("a", dpv)));
+					}
+					ReadingSet *readingSet = new ReadingSet(readings);
+					delete readings;
+					plugin_ingest(handle, (READINGSET *)readingSet);
+
+					ReadingSet *out;
+					{
+						lock_guard<mutex> guard(resultsMutex);
+						out = threadResults[this_thread::get_id()];
+						threadResults.erase(this_thread::get_id());
+					}
+					if (!out || out->getAllReadings().size() != 20)
+					{
+						errors++;
+						delete out;
+						continue;
+					}
+					// Each thread gets back its own readings, in order
+					for (long i = 0; i < 20; i++)
+					{
+						Reading *reading = out->getAllReadings()[i];
+						Datapoint *twice = reading->getDatapoint("double");
+						if (reading->getAssetName() != asset ||
+						    reading->getDatapoint("a")->getData().toInt() != t * 1000 + i ||
+						    !twice || twice->getData().toInt() != (t * 1000 + i) * 2)
+						{
+							errors++;
+						}
+					}
+					delete out;
+				}
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); t++)
+		{
+			threads[t].join();
+		}
+		ASSERT_EQ(errors, 0);
+
+		plugin_shutdown(handle);
+	}
+
+	// Cleanup
+	delete config;
+}
+
+TEST(PYTHON35, Stream)
+{
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	mkdir("/tmp/scripts", 0777);
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("script", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	const char *script = "/tmp/scripts/test_stream_script_script.py";
+	FILE *fp = fopen(script, "w");
+	ASSERT_NE(fp, (FILE *)0);
+	fprintf(fp, "%s", stream_script);
+	fclose(fp);
+	ASSERT_EQ(config->itemExists("script"), true);
+	config->setValue("script", stream_script);
+	config->setItemAttribute("script", ConfigCategory::FILE_ATTR, script);
+	config->setValue("enable", "true");
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ASSERT_NE(handle, (void *)NULL);
+
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (long i = 0; i < 10; i++)
+	{
+		DatapointValue dpv(i);
+		readings->push_back(new Reading("test", new Datapoint("a", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(readings);
+	delete readings;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 5);
+	for (long i = 0; i < 5; i++)
+	{
+		ASSERT_EQ(results[i]->getDatapoint("a")->getData().toInt(), i * 2);
+		ASSERT_EQ(results[i]->getDatapoint("half")->getData().toInt(), i);
+	}
+
+	// Cleanup
+	delete outReadings;
+	delete config;
+	plugin_shutdown(handle);
+}
+
 TEST(PYTHON35, None)
 {
 	setenv("FLEDGE_DATA", "/tmp", 1);